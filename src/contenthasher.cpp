@@ -0,0 +1,481 @@
+#include "contenthasher.h"
+#include "filenamecodec.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtEndian>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files are mapped in large windows so huge files never need a single giant mapping
+constexpr qint64 MapWindowSize = 64 * 1024 * 1024;
+constexpr qint64 ReadBlockSize = 4 * 1024 * 1024;
+
+constexpr quint32 CacheMagic = 0x52524843;  // "RRHC"
+constexpr quint32 CacheVersion = 1;
+
+#ifdef Q_OS_UNIX
+// Fill the file identity fields of a cache key from stat() or fstat()
+template <typename Key>
+void setKeyFromStat(const struct stat &info, Key &key)
+{
+    key.device = quint64(info.st_dev);
+    key.inode = quint64(info.st_ino);
+    key.size = qint64(info.st_size);
+#if defined(Q_OS_DARWIN)
+    key.mtime = qint64(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    key.mtime = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+#endif
+
+// XXH64 streaming implementation (reference algorithm by Yann Collet)
+class Xxh64
+{
+public:
+    Xxh64()
+    {
+        m_acc[0] = Prime1 + Prime2;
+        m_acc[1] = Prime2;
+        m_acc[2] = 0;
+        m_acc[3] = 0 - Prime1;
+    }
+    
+    void addData(const char *data, qint64 length)
+    {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+        const uchar *end = p + length;
+        m_totalLength += quint64(length);
+        
+        // Complete a previously buffered partial stripe first
+        if (m_bufferSize > 0) {
+            const qint64 fill = qMin(qint64(32 - m_bufferSize), length);
+            memcpy(m_buffer + m_bufferSize, p, size_t(fill));
+            m_bufferSize += int(fill);
+            p += fill;
+            if (m_bufferSize < 32) {
+                return;
+            }
+            consumeStripe(m_buffer);
+            m_bufferSize = 0;
+        }
+        
+        while (end - p >= 32) {
+            consumeStripe(p);
+            p += 32;
+        }
+        
+        if (p < end) {
+            memcpy(m_buffer, p, size_t(end - p));
+            m_bufferSize = int(end - p);
+        }
+    }
+    
+    quint64 digest() const
+    {
+        quint64 h;
+        if (m_totalLength >= 32) {
+            h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+            for (quint64 acc : m_acc) {
+                h ^= round(0, acc);
+                h = h * Prime1 + Prime4;
+            }
+        } else {
+            h = Prime5;
+        }
+        h += m_totalLength;
+        
+        const uchar *p = m_buffer;
+        const uchar *end = m_buffer + m_bufferSize;
+        while (end - p >= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * Prime1 + Prime4;
+            p += 8;
+        }
+        if (end - p >= 4) {
+            h ^= quint64(read32(p)) * Prime1;
+            h = rotl(h, 23) * Prime2 + Prime3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= quint64(*p) * Prime5;
+            h = rotl(h, 11) * Prime1;
+            ++p;
+        }
+        
+        h ^= h >> 33;
+        h *= Prime2;
+        h ^= h >> 29;
+        h *= Prime3;
+        h ^= h >> 32;
+        return h;
+    }
+    
+private:
+    static constexpr quint64 Prime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr quint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr quint64 Prime3 = 0x165667B19E3779F9ULL;
+    static constexpr quint64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr quint64 Prime5 = 0x27D4EB2F165667C5ULL;
+    
+    static quint64 rotl(quint64 value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+    static quint64 read64(const uchar *p) { return qFromLittleEndian<quint64>(p); }
+    static quint32 read32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+    static quint64 round(quint64 acc, quint64 input)
+    {
+        acc += input * Prime2;
+        return rotl(acc, 31) * Prime1;
+    }
+    
+    void consumeStripe(const uchar *p)
+    {
+        for (int i = 0; i < 4; ++i) {
+            m_acc[i] = round(m_acc[i], read64(p + i * 8));
+        }
+    }
+    
+    quint64 m_acc[4];
+    quint64 m_totalLength = 0;
+    uchar m_buffer[32];
+    int m_bufferSize = 0;
+};
+
+// Feed the whole file to addData using mapped windows, falling back to buffered reads
+template <typename AddData>
+bool readSequential(QFile &file, AddData addData)
+{
+    const qint64 size = file.size();
+    qint64 offset = 0;
+    
+    while (offset < size) {
+        const qint64 length = qMin(MapWindowSize, size - offset);
+        uchar *data = file.map(offset, length);
+        if (!data) {
+            break;
+        }
+#ifdef Q_OS_UNIX
+        // Window offsets are multiples of MapWindowSize, so the mapping is page aligned
+        madvise(data, size_t(length), MADV_SEQUENTIAL);
+#endif
+        addData(reinterpret_cast<const char *>(data), length);
+        file.unmap(data);
+        offset += length;
+    }
+    
+    if (offset < size || size == 0) {
+        // Mapping not possible (e.g. special or virtual files) - read the rest in large blocks
+        if (!file.seek(offset)) {
+            return false;
+        }
+        QByteArray buffer(ReadBlockSize, Qt::Uninitialized);
+        while (true) {
+            const qint64 bytesRead = file.read(buffer.data(), buffer.size());
+            if (bytesRead < 0) {
+                return false;
+            }
+            if (bytesRead == 0) {
+                break;
+            }
+            addData(buffer.constData(), bytesRead);
+        }
+    }
+    return true;
+}
+
+const QHash<QString, QCryptographicHash::Algorithm> &cryptographicAlgorithms()
+{
+    static const QHash<QString, QCryptographicHash::Algorithm> algorithms = {
+        {"md5", QCryptographicHash::Md5},
+        {"sha1", QCryptographicHash::Sha1},
+        {"sha256", QCryptographicHash::Sha256},
+        {"sha512", QCryptographicHash::Sha512},
+    };
+    return algorithms;
+}
+
+} // namespace
+
+ContentHasher::ContentHasher(QObject *parent)
+    : QObject(parent)
+{
+    // Hashing is I/O bound on spinning disks and CPU bound on SSDs;
+    // one thread per core is a reasonable middle ground
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+ContentHasher::~ContentHasher()
+{
+    cancelAll();
+    pool.waitForDone();
+    saveCache();
+}
+
+bool ContentHasher::isSupportedAlgorithm(const QString &algorithm)
+{
+    return algorithm == "xxh64" || cryptographicAlgorithms().contains(algorithm);
+}
+
+void ContentHasher::request(const QString &filePath, const QString &algorithm)
+{
+    const QString key = algorithm + '|' + filePath;
+    if (inFlight.contains(key)) {
+        return;
+    }
+    inFlight.insert(key);
+    
+    const int requestGeneration = generation.loadRelaxed();
+    pool.start([this, filePath, algorithm, requestGeneration]() {
+        hashFile(filePath, algorithm, requestGeneration);
+    });
+}
+
+void ContentHasher::cancelAll()
+{
+    generation.fetchAndAddRelaxed(1);
+    pool.clear();
+    inFlight.clear();
+}
+
+void ContentHasher::hashFile(const QString &filePath, const QString &algorithm, int requestGeneration)
+{
+    // Skip requests that were cancelled while waiting in the queue
+    if (requestGeneration != generation.loadRelaxed()) {
+        return;
+    }
+    
+    ContentHash result{filePath, algorithm, QString()};
+    
+    CacheKey key;
+    key.algorithm = algorithm;
+    const bool haveKey = statFile(filePath, key);
+    if (haveKey) {
+        QMutexLocker locker(&cacheMutex);
+        ensureCacheLoaded();
+        result.digest = cache.value(key);
+    }
+    
+    if (result.digest.isEmpty()) {
+        // The key was taken before reading; a file written or replaced in between is
+        // reported but not cached under it
+        bool unchanged = false;
+        result.digest = computeDigest(filePath, algorithm, haveKey ? &key : nullptr, &unchanged);
+        if (haveKey && unchanged && !result.digest.isEmpty()) {
+            QMutexLocker locker(&cacheMutex);
+            cache.insert(key, result.digest);
+            cacheDirty = true;
+        }
+    }
+    
+    finish(result);
+}
+
+void ContentHasher::finish(const ContentHash &result)
+{
+    bool scheduleFlush;
+    {
+        QMutexLocker locker(&finishedMutex);
+        scheduleFlush = finished.isEmpty();
+        finished.append(result);
+    }
+    
+    // Only the first result of a batch posts an event; later ones piggyback on it
+    if (scheduleFlush) {
+        QMetaObject::invokeMethod(this, &ContentHasher::flushFinished, Qt::QueuedConnection);
+    }
+}
+
+void ContentHasher::flushFinished()
+{
+    QList<ContentHash> results;
+    {
+        QMutexLocker locker(&finishedMutex);
+        results.swap(finished);
+    }
+    
+    for (const ContentHash &result : results) {
+        inFlight.remove(result.algorithm + '|' + result.filePath);
+    }
+    
+    emit hashesReady(results);
+    
+    // Persist the index once the queue has drained
+    if (inFlight.isEmpty()) {
+        saveCache();
+    }
+}
+
+bool ContentHasher::statFile(const QString &filePath, CacheKey &key)
+{
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (stat(FileNameCodec::encode(filePath).constData(), &info) != 0) {
+        return false;
+    }
+    setKeyFromStat(info, key);
+    return true;
+#else
+    // No inode numbers available - key on the path instead
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return false;
+    }
+    key.inode = qHash(fileInfo.absoluteFilePath());
+    key.size = fileInfo.size();
+    key.mtime = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+    return true;
+#endif
+}
+
+bool ContentHasher::keyUnchanged(const QFile &file, const QString &filePath, const CacheKey &key)
+{
+    CacheKey current;
+    current.algorithm = key.algorithm;
+#ifdef Q_OS_UNIX
+    // The open descriptor, so a file renamed over the path still counts as a change
+    Q_UNUSED(filePath);
+    struct stat info;
+    if (::fstat(file.handle(), &info) != 0) {
+        return false;
+    }
+    setKeyFromStat(info, current);
+#else
+    Q_UNUSED(file);
+    if (!statFile(filePath, current)) {
+        return false;
+    }
+#endif
+    return current == key;
+}
+
+QString ContentHasher::computeDigest(const QString &filePath, const QString &algorithm,
+                                     const CacheKey *expected, bool *unchanged)
+{
+    if (unchanged) {
+        *unchanged = false;
+    }
+    
+    QFile file;
+#ifdef Q_OS_UNIX
+    // Opened by its exact bytes; QFile would re-encode the name
+    const int fd = ::open(FileNameCodec::encode(filePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return QString();
+    }
+    if (!file.open(fd, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle)) {
+        ::close(fd);
+        return QString();
+    }
+#else
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+#endif
+
+    if (algorithm == "xxh64") {
+        Xxh64 hash;
+        if (!readSequential(file, [&hash](const char *data, qint64 length) { hash.addData(data, length); })) {
+            return QString();
+        }
+        if (expected && unchanged) {
+            *unchanged = keyUnchanged(file, filePath, *expected);
+        }
+        return QString("%1").arg(hash.digest(), 16, 16, QChar('0'));
+    }
+    
+    QCryptographicHash hash(cryptographicAlgorithms().value(algorithm, QCryptographicHash::Sha256));
+    if (!readSequential(file, [&hash](const char *data, qint64 length) {
+            hash.addData(QByteArrayView(data, length));
+        })) {
+        return QString();
+    }
+    if (expected && unchanged) {
+        *unchanged = keyUnchanged(file, filePath, *expected);
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString ContentHasher::cacheFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/content-hashes.dat";
+}
+
+void ContentHasher::ensureCacheLoaded()
+{
+    // Called with cacheMutex held
+    if (cacheLoaded) {
+        return;
+    }
+    cacheLoaded = true;
+    
+    QFile file(cacheFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion) {
+        return;
+    }
+    
+    // The count comes from disk; a damaged file must not make us reserve more entries
+    // than it can hold (four 64-bit fields and two string lengths at least)
+    constexpr qint64 MinRecordSize = 4 * 8 + 2 * 4;
+    const quint64 maxCount = quint64(qMax<qint64>(file.size() - file.pos(), 0) / MinRecordSize);
+    cache.reserve(qsizetype(qMin(count, maxCount)));
+    for (quint64 i = 0; i < count; ++i) {
+        CacheKey key;
+        QString digest;
+        in >> key.device >> key.inode >> key.size >> key.mtime >> key.algorithm >> digest;
+        if (in.status() != QDataStream::Ok) {
+            break;  // Truncated or damaged; keep the records read so far
+        }
+        cache.insert(key, digest);
+    }
+}
+
+void ContentHasher::saveCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    if (!cacheDirty) {
+        return;
+    }
+    
+    const QString path = cacheFilePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << quint64(cache.size());
+    for (auto it = cache.constBegin(); it != cache.constEnd(); ++it) {
+        out << it.key().device << it.key().inode << it.key().size << it.key().mtime
+            << it.key().algorithm << it.value();
+    }
+    
+    if (file.commit()) {
+        cacheDirty = false;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef CONTENTHASHER_H
+#define CONTENTHASHER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+class QFile;
+
+struct ContentHash {
+    QString filePath;
+    QString algorithm;
+    QString digest;  // Empty if the file could not be read
+};
+
+/**
+ * @brief Computes file content hashes in a background thread pool.
+ *
+ * Files are read through memory-mapped windows with sequential access hints.
+ * Digests are kept in a persistent on-disk index keyed by (device, inode, size, mtime),
+ * so reopening the same files does not hash them again. Finished results are
+ * delivered in batches on the thread that owns the hasher.
+ */
+class ContentHasher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ContentHasher(QObject *parent = nullptr);
+    ~ContentHasher() override;
+
+    static bool isSupportedAlgorithm(const QString &algorithm);
+
+    /**
+     * @brief Queue hashing of a file unless a request for it is already pending.
+     */
+    void request(const QString &filePath, const QString &algorithm);
+
+    /**
+     * @brief Drop all queued requests. Running computations finish but are not restarted.
+     */
+    void cancelAll();
+
+signals:
+    void hashesReady(const QList<ContentHash> &results);
+
+private:
+    struct CacheKey {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 size = 0;
+        qint64 mtime = 0;  // Nanoseconds since epoch
+        QString algorithm;
+
+        bool operator==(const CacheKey &other) const
+        {
+            return device == other.device && inode == other.inode && size == other.size
+                && mtime == other.mtime && algorithm == other.algorithm;
+        }
+
+        friend size_t qHash(const CacheKey &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.device, key.inode, key.size, key.mtime, key.algorithm);
+        }
+    };
+
+    void hashFile(const QString &filePath, const QString &algorithm, int requestGeneration);
+    void finish(const ContentHash &result);
+    void flushFinished();
+    void ensureCacheLoaded();
+    void saveCache();
+    static bool statFile(const QString &filePath, CacheKey &key);
+    static bool keyUnchanged(const QFile &file, const QString &filePath, const CacheKey &key);
+    // With expected set, *unchanged tells whether the file still had that key after reading
+    static QString computeDigest(const QString &filePath, const QString &algorithm,
+                                 const CacheKey *expected = nullptr, bool *unchanged = nullptr);
+    static QString cacheFilePath();
+
+    QThreadPool pool;
+    QAtomicInt generation;
+    QSet<QString> inFlight;  // "algorithm|path" keys, only touched on the owning thread
+
+    QMutex cacheMutex;
+    QHash<CacheKey, QString> cache;
+    bool cacheLoaded = false;
+    bool cacheDirty = false;
+
+    QMutex finishedMutex;
+    QList<ContentHash> finished;
+};
+
+#endif // CONTENTHASHER_H
@@ -0,0 +1,162 @@
+#include "directoryscanner.h"
+#include "filenamecodec.h"
+#include <QDir>
+#include <QObject>
+
+namespace {
+
+// One entry of the explicit walk stack
+struct PendingDirectory {
+    QString path;
+    QString relativePath;  // Relative to the root, ending in '/' (empty for the root)
+    int depth;
+};
+
+bool isHiddenName(const QString &name)
+{
+    return name.startsWith(QLatin1Char('.'));
+}
+
+} // namespace
+
+bool DirectoryScanner::Rule::matches(const QString &fileName, const QString &relativePath) const
+{
+    if (!name.pattern().isEmpty() && name.match(fileName).hasMatch()) {
+        return true;
+    }
+    return !path.pattern().isEmpty() && path.match(relativePath).hasMatch();
+}
+
+DirectoryScanner::DirectoryScanner(const ScanOptions &options)
+    : options(options)
+{
+    includeRule = compile(options.include);
+    excludeRule = compile(options.exclude);
+}
+
+DirectoryScanner::Rule DirectoryScanner::compile(const QStringList &patterns)
+{
+    // All patterns of a kind become one alternation, so every entry is matched once
+    QStringList namePatterns;
+    QStringList pathPatterns;
+    for (const QString &pattern : patterns) {
+        if (pattern.isEmpty()) {
+            continue;
+        }
+        
+        QString expression;
+        if (options.syntax == ScanOptions::Glob) {
+            expression = QRegularExpression::wildcardToRegularExpression(pattern);
+        } else {
+            const QRegularExpression check(pattern);
+            if (!check.isValid() && error.isEmpty()) {
+                error = QObject::tr("Invalid pattern '%1': %2").arg(pattern, check.errorString());
+            }
+            expression = pattern;
+        }
+        
+        const bool isPath = pattern.contains(QLatin1Char('/'));
+        (isPath ? pathPatterns : namePatterns).append(QStringLiteral("(?:%1)").arg(expression));
+    }
+    
+    const auto patternOptions = options.syntax == ScanOptions::Glob
+        ? QRegularExpression::CaseInsensitiveOption
+        : QRegularExpression::NoPatternOption;
+    Rule rule;
+    if (!namePatterns.isEmpty()) {
+        rule.name = QRegularExpression(namePatterns.join(QLatin1Char('|')), patternOptions);
+        rule.name.optimize();
+    }
+    if (!pathPatterns.isEmpty()) {
+        rule.path = QRegularExpression(pathPatterns.join(QLatin1Char('|')), patternOptions);
+        rule.path.optimize();
+    }
+    return rule;
+}
+
+bool DirectoryScanner::isValid(QString *errorMessage) const
+{
+    if (errorMessage) {
+        *errorMessage = error;
+    }
+    return error.isEmpty();
+}
+
+bool DirectoryScanner::isExcluded(const QString &name, const QString &relativePath) const
+{
+    return !excludeRule.isEmpty() && excludeRule.matches(name, relativePath);
+}
+
+bool DirectoryScanner::isIncluded(const QString &name, const QString &relativePath) const
+{
+    return includeRule.isEmpty() || includeRule.matches(name, relativePath);
+}
+
+QStringList DirectoryScanner::scan(const QString &root, QStringList *directories) const
+{
+    QStringList filePaths;
+    if (!isValid()) {
+        return filePaths;
+    }
+    
+    // Explicit stack instead of a recursive iterator, so pruned folders are never
+    // opened; names are read as bytes and decoded losslessly
+    QList<PendingDirectory> stack;
+    stack.append({root, QString(), 0});
+    while (!stack.isEmpty()) {
+        const PendingDirectory directory = stack.takeLast();
+        const bool descend = options.maxDepth < 0 || directory.depth < options.maxDepth;
+        
+        const QString prefix = directory.path.endsWith(QLatin1Char('/'))
+            ? directory.path : directory.path + QLatin1Char('/');
+        for (const FileNameCodec::DirectoryEntry &entry : FileNameCodec::list(directory.path)) {
+            const QString &name = entry.name;
+            const QString relativePath = directory.relativePath + name;
+            if ((!options.includeHidden && isHiddenName(name)) || isExcluded(name, relativePath)) {
+                continue;
+            }
+            
+            if (entry.type == FileMetadata::Directory) {
+                // Symbolic links to folders are not followed, as before
+                if (descend && !entry.isSymLink) {
+                    stack.append({prefix + name, relativePath + QLatin1Char('/'), directory.depth + 1});
+                    if (directories) {
+                        directories->append(prefix + name);
+                    }
+                }
+            } else if (entry.type == FileMetadata::RegularFile && isIncluded(name, relativePath)) {
+                filePaths.append(prefix + name);
+            }
+        }
+    }
+    return filePaths;
+}
+
+bool DirectoryScanner::accepts(const QString &root, const QString &filePath) const
+{
+    if (!isValid()) {
+        return false;
+    }
+    
+    const QString relativePath = QDir(root).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String(".."))) {
+        return false;
+    }
+    
+    // Apply the folder rules to every folder on the way, then the file rules
+    const QStringList parts = relativePath.split(QLatin1Char('/'));
+    const int depth = int(parts.size()) - 1;
+    if (options.maxDepth >= 0 && depth > options.maxDepth) {
+        return false;
+    }
+    
+    QString prefix;
+    for (const QString &part : parts) {
+        prefix += part;
+        if ((!options.includeHidden && isHiddenName(part)) || isExcluded(part, prefix)) {
+            return false;
+        }
+        prefix += QLatin1Char('/');
+    }
+    return isIncluded(parts.last(), relativePath);
+}
@@ -0,0 +1,86 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QRegularExpression>
+
+/**
+ * @brief Rules for which files are taken from a dropped folder.
+ *
+ * Patterns without a '/' are matched against the file or folder name, patterns
+ * with a '/' against the path relative to the dropped folder. Globs match the
+ * whole name (case-insensitive); regular expressions match anywhere.
+ */
+struct ScanOptions {
+    enum PatternSyntax {
+        Glob,
+        Regex
+    };
+    
+    PatternSyntax syntax = Glob;
+    QStringList include;         // Files must match one of these (empty = all files)
+    QStringList exclude;         // Matching files are skipped, matching folders are not entered
+    int maxDepth = -1;           // Folder levels below the dropped folder (-1 = unlimited)
+    bool includeHidden = false;  // Take hidden files and enter hidden folders
+    
+    bool isDefault() const
+    {
+        return include.isEmpty() && exclude.isEmpty() && maxDepth < 0 && !includeHidden;
+    }
+};
+
+/**
+ * @brief Collects the files below a folder according to ScanOptions.
+ *
+ * Rules are evaluated while walking, before any path is stored: excluded,
+ * hidden or too deep folders are pruned without listing their contents, and
+ * each directory entry costs one match per rule kind (all patterns of a kind
+ * are compiled into one expression).
+ */
+class DirectoryScanner
+{
+public:
+    explicit DirectoryScanner(const ScanOptions &options = ScanOptions());
+    
+    /**
+     * @brief Check whether all patterns compiled.
+     * @param errorMessage Receives the first invalid pattern and the reason
+     */
+    bool isValid(QString *errorMessage = nullptr) const;
+    
+    /**
+     * @brief List the accepted files below a folder.
+     * @param root The folder
+     * @param directories Receives the folders entered below root; may be null
+     * @return Paths of the accepted files, in directory order
+     */
+    QStringList scan(const QString &root, QStringList *directories = nullptr) const;
+    
+    /**
+     * @brief Check whether a scan of root would have taken a file (e.g. one added later).
+     * @param root The folder the file was found in
+     * @param filePath Path of a file below root
+     */
+    bool accepts(const QString &root, const QString &filePath) const;
+    
+private:
+    struct Rule {
+        QRegularExpression name;  // Patterns without '/'
+        QRegularExpression path;  // Patterns with '/'
+        
+        bool isEmpty() const { return name.pattern().isEmpty() && path.pattern().isEmpty(); }
+        bool matches(const QString &fileName, const QString &relativePath) const;
+    };
+    
+    Rule compile(const QStringList &patterns);
+    bool isExcluded(const QString &name, const QString &relativePath) const;
+    bool isIncluded(const QString &name, const QString &relativePath) const;
+    
+    ScanOptions options;
+    Rule includeRule;
+    Rule excludeRule;
+    QString error;
+};
+
+#endif // DIRECTORYSCANNER_H
@@ -0,0 +1,378 @@
+#include "directorywatcher.h"
+#include "filenamecodec.h"
+#include "directoryscanner.h"
+#include <QSocketNotifier>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QFile>
+#include <QDebug>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+constexpr int QuietIntervalMs = 200;  // Flush once no event arrived for this long
+constexpr int MaxLatencyMs = 1000;    // ...but at least this often during a storm
+
+#ifdef Q_OS_LINUX
+constexpr uint32_t WatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM
+                             | IN_MOVED_TO | IN_ONLYDIR | IN_EXCL_UNLINK;
+#endif
+
+// Files and subfolders of a folder that appeared in a recursive watch
+struct TreeScan {
+    QStringList files;
+    QStringList directories;
+};
+
+bool isBelow(const QString &path, const QString &directory)
+{
+    return path.size() > directory.size() && path.startsWith(directory)
+        && path.at(directory.size()) == QLatin1Char('/');
+}
+
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(QObject *parent)
+    : QObject(parent)
+{
+    quietTimer = new QTimer(this);
+    quietTimer->setSingleShot(true);
+    quietTimer->setInterval(QuietIntervalMs);
+    connect(quietTimer, &QTimer::timeout, this, &DirectoryWatcher::flush);
+    
+    maxLatencyTimer = new QTimer(this);
+    maxLatencyTimer->setSingleShot(true);
+    maxLatencyTimer->setInterval(MaxLatencyMs);
+    connect(maxLatencyTimer, &QTimer::timeout, this, &DirectoryWatcher::flush);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+bool DirectoryWatcher::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DirectoryWatcher::watchDirectory(const QString &path, bool recursive)
+{
+    if (recursive) {
+        addTree(path);
+    } else {
+        addWatch(path, false);
+    }
+}
+
+void DirectoryWatcher::clear()
+{
+#ifdef Q_OS_LINUX
+    // Closing the descriptor drops all watches and queued events at once
+    delete notifier;
+    notifier = nullptr;
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    watches.clear();
+    watchByPath.clear();
+    pendingMoves.clear();
+    pending = DirectoryChanges();
+    ++scanGeneration;
+    runningScans = 0;
+    closedDuringScans.clear();
+    quietTimer->stop();
+    maxLatencyTimer->stop();
+}
+
+void DirectoryWatcher::addWatch(const QString &path, bool recursive)
+{
+#ifdef Q_OS_LINUX
+    auto existing = watchByPath.constFind(path);
+    if (existing != watchByPath.constEnd()) {
+        Watch &watch = watches[existing.value()];
+        watch.recursive = watch.recursive || recursive;
+        return;
+    }
+    
+    if (fd < 0) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            qWarning() << "inotify_init1 failed:" << strerror(errno);
+            return;
+        }
+        notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+    }
+    
+    const int wd = inotify_add_watch(fd, FileNameCodec::encode(path).constData(), WatchMask);
+    if (wd < 0) {
+        // Typically ENOSPC when fs.inotify.max_user_watches is exhausted
+        qWarning() << "Cannot watch" << path << ":" << strerror(errno);
+        return;
+    }
+    
+    Watch &watch = watches[wd];
+    if (!watch.path.isEmpty()) {
+        // Same directory under another path (e.g. a symlink); keep the first
+        watch.recursive = watch.recursive || recursive;
+        return;
+    }
+    watch.path = path;
+    watch.recursive = recursive;
+    watchByPath.insert(path, wd);
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(recursive);
+#endif
+}
+
+void DirectoryWatcher::addTree(const QString &root)
+{
+    // The files of a dropped folder are already listed; only its folders are watched
+    addWatch(root, true);
+    QStringList directories{root};
+    while (!directories.isEmpty()) {
+        const QString directory = directories.takeLast();
+        for (const FileNameCodec::DirectoryEntry &entry : FileNameCodec::list(directory)) {
+            if (entry.type == FileMetadata::Directory && !entry.isSymLink) {
+                const QString path = directory + QLatin1Char('/') + entry.name;
+                addWatch(path, true);
+                directories.append(path);
+            }
+        }
+    }
+}
+
+void DirectoryWatcher::scanTree(const QString &root)
+{
+    // Watch first, then list on a worker, so files created in between are not missed.
+    // Files closed while a scan runs were reported by their own event and are skipped
+    // when its result arrives.
+    addWatch(root, true);
+    ++runningScans;
+    auto *watcher = new QFutureWatcher<TreeScan>(this);
+    const int generation = scanGeneration;
+    connect(watcher, &QFutureWatcher<TreeScan>::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation != scanGeneration) {
+            return; // clear() dropped the watches meanwhile
+        }
+        
+        const TreeScan scan = watcher->result();
+        for (const QString &directory : scan.directories) {
+            addWatch(directory, true);
+        }
+        for (const QString &file : scan.files) {
+            if (!closedDuringScans.contains(file)) {
+                append(DirectoryChange::FileAdded, file);
+            }
+        }
+        if (--runningScans == 0) {
+            closedDuringScans.clear();
+        }
+        scheduleFlush();
+    });
+    watcher->setFuture(QtConcurrent::run([root]() {
+        // Hidden files too; the receiver applies the rules of the folder they belong to
+        ScanOptions options;
+        options.includeHidden = true;
+        TreeScan scan;
+        scan.files = DirectoryScanner(options).scan(root, &scan.directories);
+        return scan;
+    }));
+}
+
+void DirectoryWatcher::scheduleFlush()
+{
+    if (!pending.isEmpty() || !pendingMoves.isEmpty()) {
+        quietTimer->start();
+        if (!maxLatencyTimer->isActive()) {
+            maxLatencyTimer->start();
+        }
+    }
+}
+
+void DirectoryWatcher::removeWatchesBelow(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    for (auto it = watches.begin(); it != watches.end();) {
+        if (it->path == path || isBelow(it->path, path)) {
+            inotify_rm_watch(fd, it.key());
+            watchByPath.remove(it->path);
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+void DirectoryWatcher::renameWatchesBelow(const QString &path, const QString &newPath)
+{
+    // Watch descriptors follow the directory, only the recorded paths change
+    for (auto it = watches.begin(); it != watches.end(); ++it) {
+        if (it->path == path || isBelow(it->path, path)) {
+            watchByPath.remove(it->path);
+            it->path = newPath + it->path.mid(path.size());
+            watchByPath.insert(it->path, it.key());
+        }
+    }
+}
+
+void DirectoryWatcher::append(DirectoryChange::Kind kind, const QString &path, const QString &newPath)
+{
+    pending.changes.append(DirectoryChange{kind, path, newPath});
+}
+
+void DirectoryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buffer[64 * 1024];
+    
+    for (;;) {
+        const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; // EAGAIN: queue drained
+        }
+        
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            
+            if (event->mask & IN_Q_OVERFLOW) {
+                pending.overflowed = true;
+                continue;
+            }
+            
+            auto watchIt = watches.constFind(event->wd);
+            if (watchIt == watches.constEnd()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // Directory deleted or unmounted; the kernel removed the watch
+                watchByPath.remove(watchIt->path);
+                watches.erase(watchIt);
+                continue;
+            }
+            if (event->len == 0) {
+                continue; // Event about the watched directory itself
+            }
+            
+            const Watch watch = *watchIt;
+            const QString path = watch.path + QLatin1Char('/') + FileNameCodec::decode(event->name, qsizetype(strlen(event->name)));
+            const bool isDirectory = event->mask & IN_ISDIR;
+            
+            if (event->mask & IN_CREATE) {
+                if (isDirectory && watch.recursive) {
+                    scanTree(path);
+                }
+            } else if (event->mask & IN_CLOSE_WRITE) {
+                if (watch.recursive) {
+                    append(DirectoryChange::FileAdded, path);
+                    if (runningScans > 0) {
+                        closedDuringScans.insert(path);
+                    }
+                }
+            } else if (event->mask & IN_DELETE) {
+                append(isDirectory ? DirectoryChange::DirectoryRemoved
+                                   : DirectoryChange::FileRemoved, path);
+            } else if (event->mask & IN_MOVED_FROM) {
+                pendingMoves.insert(event->cookie, PendingMove{path, isDirectory});
+            } else if (event->mask & IN_MOVED_TO) {
+                // A folder renamed within the watches keeps its watches and entries; only
+                // what comes from outside a recursive watch is new to it
+                bool known = false;
+                auto move = pendingMoves.find(event->cookie);
+                if (move != pendingMoves.end()) {
+                    if (move->isDirectory) {
+                        const auto moved = watchByPath.constFind(move->path);
+                        known = moved != watchByPath.constEnd() && watches.value(moved.value()).recursive;
+                        renameWatchesBelow(move->path, path);
+                        append(DirectoryChange::DirectoryRenamed, move->path, path);
+                    } else {
+                        append(DirectoryChange::FileRenamed, move->path, path);
+                    }
+                    pendingMoves.erase(move);
+                }
+                
+                if (watch.recursive) {
+                    if (!isDirectory) {
+                        append(DirectoryChange::FileAdded, path);
+                    } else if (!known) {
+                        scanTree(path);
+                    }
+                }
+            }
+        }
+    }
+    
+    scheduleFlush();
+#endif
+}
+
+void DirectoryWatcher::hold()
+{
+    held = true;
+}
+
+DirectoryChanges DirectoryWatcher::release()
+{
+    // Events of everything done so far are already queued; read them before resuming,
+    // so the caller gets them all
+    readEvents();
+    held = false;
+    return takePending();
+}
+
+void DirectoryWatcher::flush()
+{
+    if (held) {
+        return;
+    }
+    const DirectoryChanges changes = takePending();
+    if (!changes.isEmpty()) {
+        emit changesReady(changes);
+    }
+}
+
+DirectoryChanges DirectoryWatcher::takePending()
+{
+    quietTimer->stop();
+    maxLatencyTimer->stop();
+    
+    // Sources of moves without a target left the watched directories
+    for (const PendingMove &move : std::as_const(pendingMoves)) {
+        if (move.isDirectory) {
+            removeWatchesBelow(move.path);
+            append(DirectoryChange::DirectoryRemoved, move.path);
+        } else {
+            append(DirectoryChange::FileRemoved, move.path);
+        }
+    }
+    pendingMoves.clear();
+    
+    DirectoryChanges changes = std::move(pending);
+    pending = DirectoryChanges();
+    return changes;
+}
+    
\ No newline at end of file
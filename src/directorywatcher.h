@@ -0,0 +1,130 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+class QSocketNotifier;
+
+/**
+ * @brief One file system change reported by DirectoryWatcher.
+ */
+struct DirectoryChange {
+    enum Kind {
+        FileAdded,         // New file in a recursively watched folder
+        FileRemoved,
+        FileRenamed,       // path -> newPath
+        DirectoryRemoved,  // Everything below path is gone
+        DirectoryRenamed   // Everything below path moved below newPath
+    };
+    
+    Kind kind;
+    QString path;
+    QString newPath;
+};
+
+/**
+ * @brief Changes collected over one coalescing interval, in the order they happened.
+ */
+struct DirectoryChanges {
+    QList<DirectoryChange> changes;
+    bool overflowed = false; // Events were lost; the receiver should compare against the disk
+    
+    bool isEmpty() const { return changes.isEmpty() && !overflowed; }
+};
+
+/**
+ * @brief Watches directories for external changes using inotify.
+ *
+ * Events are read from a non-blocking inotify descriptor and collected until
+ * the file system has been quiet for a moment (or at most about a second), so
+ * a storm of events such as copying a large tree arrives as a few batches.
+ * Renames are reported as such by pairing IN_MOVED_FROM/IN_MOVED_TO cookies.
+ * Folders created in or moved into a recursive watch are listed on a worker
+ * thread; their files join a later batch.
+ * On platforms without inotify the watcher does nothing.
+ */
+class DirectoryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryWatcher(QObject *parent = nullptr);
+    ~DirectoryWatcher();
+    
+    /**
+     * @brief Check whether change notifications are available on this platform.
+     */
+    static bool isSupported();
+    
+    /**
+     * @brief Watch a directory.
+     * @param path The directory
+     * @param recursive Also watch all subdirectories (including new ones) and report new files;
+     *                  otherwise only removals and renames in the directory itself are reported
+     */
+    void watchDirectory(const QString &path, bool recursive);
+    
+    /**
+     * @brief Stop watching all directories and drop pending changes.
+     */
+    void clear();
+
+    /**
+     * @brief Collect changes without delivering them, e.g. while the application itself
+     * renames the watched files.
+     */
+    void hold();
+    
+    /**
+     * @brief Read the events the kernel has queued so far and return everything collected
+     * since hold(); later changes are delivered through changesReady() again.
+     */
+    DirectoryChanges release();
+
+signals:
+    void changesReady(const DirectoryChanges &changes);
+
+private slots:
+    void readEvents();
+    void flush();
+
+private:
+    struct Watch {
+        QString path;
+        bool recursive = false;
+    };
+    
+    struct PendingMove {
+        QString path;
+        bool isDirectory = false;
+    };
+    
+    void addWatch(const QString &path, bool recursive);
+    void addTree(const QString &root);
+    void scanTree(const QString &root);
+    void scheduleFlush();
+    void removeWatchesBelow(const QString &path);
+    void renameWatchesBelow(const QString &path, const QString &newPath);
+    void append(DirectoryChange::Kind kind, const QString &path, const QString &newPath = QString());
+    DirectoryChanges takePending();
+    
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QHash<int, Watch> watches;         // Watch descriptor -> directory
+    QHash<QString, int> watchByPath;
+    QHash<quint32, PendingMove> pendingMoves; // Move cookie -> source, until the target arrives
+    DirectoryChanges pending;
+    bool held = false;                 // hold() was called; flush() keeps collecting
+    int scanGeneration = 0;            // Bumped by clear(); older scans are dropped
+    int runningScans = 0;
+    QSet<QString> closedDuringScans;   // Files already reported while scans were running
+    QTimer *quietTimer;      // Restarted by every event
+    QTimer *maxLatencyTimer; // Started by the first event of a batch
+};
+
+#endif // DIRECTORYWATCHER_H
@@ -0,0 +1,577 @@
+#include "engineverifier.h"
+#include "operation.h"
+#include "operationfactory.h"
+#include "contenthasher.h"
+#include "replacementdictionary.h"
+#include "filelistwidget.h"
+#include "entrystore.h"
+#include "renameexecutor.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+constexpr int MaxReportedMismatches = 20;
+
+// Straightforward implementations the optimized engine must agree with
+namespace Reference {
+
+QString expandTags(const QString &text, const TagContext &context)
+{
+    QRegularExpression tagPattern(
+        R"(<(?:(0+)(?::(\d+))?(?::(dir|ext|dir\+ext))?|hash:([a-z0-9]+)(?::(\d+))?|mtime:([^<>]+))>)");
+    
+    QString result;
+    qsizetype literalStart = 0;
+    QRegularExpressionMatchIterator iter = tagPattern.globalMatch(text);
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        QString value;
+        if (!match.captured(1).isEmpty()) {
+            CounterScope scope = CounterScope::Global;
+            if (match.captured(3) == "dir") {
+                scope = CounterScope::Directory;
+            } else if (match.captured(3) == "ext") {
+                scope = CounterScope::Extension;
+            } else if (match.captured(3) == "dir+ext") {
+                scope = CounterScope::DirectoryExtension;
+            }
+            const int start = match.captured(2).isEmpty() ? 1 : match.captured(2).toInt();
+            value = QString("%1").arg(start + context.index(scope), match.capturedLength(1), 10, QChar('0'));
+        } else if (match.capturedStart(6) >= 0) {
+            if (context.modified >= 0) {
+                const QDateTime time = QDateTime::fromMSecsSinceEpoch(context.modified / 1000000);
+                value = time.toString(match.captured(6));
+            }
+        } else if (ContentHasher::isSupportedAlgorithm(match.captured(4))) {
+            value = context.contentHashes.value(match.captured(4));
+            const int length = match.captured(5).toInt();
+            if (length > 0) {
+                value = value.left(length);
+            }
+        } else {
+            continue; // Unknown algorithm: the tag stays as text
+        }
+        result += text.mid(literalStart, match.capturedStart(0) - literalStart);
+        result += value;
+        literalStart = match.capturedEnd(0);
+    }
+    result += text.mid(literalStart);
+    return result;
+}
+
+void splitName(const QString &fileName, QString &baseName, QString &extension)
+{
+    int dotIndex = fileName.lastIndexOf('.');
+    if (dotIndex > 0) {
+        baseName = fileName.left(dotIndex);
+        extension = fileName.mid(dotIndex);
+    } else {
+        baseName = fileName;
+        extension = "";
+    }
+}
+
+QString perform(const OperationSpec &spec, const QString &fileName, const TagContext &context)
+{
+    QString baseName;
+    QString extension;
+    splitName(fileName, baseName, extension);
+    
+    switch (spec.type) {
+        case OperationType::Replace: {
+            QRegularExpression regex(spec.value);
+            if (!regex.isValid()) {
+                return fileName;
+            }
+            baseName.replace(regex, expandTags(spec.replacement, context));
+            return baseName + extension;
+        }
+        case OperationType::Prefix:
+            return expandTags(spec.value, context) + fileName;
+        case OperationType::Suffix:
+            return baseName + expandTags(spec.value, context) + extension;
+        case OperationType::Insert: {
+            int pos = qBound(0, spec.value.toInt(), int(baseName.length()));
+            baseName.insert(pos, expandTags(spec.replacement, context));
+            return baseName + extension;
+        }
+        case OperationType::ChangeExtension: {
+            QString result = baseName;
+            if (!spec.value.isEmpty()) {
+                if (!spec.value.startsWith('.')) {
+                    result += '.';
+                }
+                result += spec.value;
+            }
+            return result;
+        }
+        case OperationType::ChangeCase:
+            if (spec.caseType == ChangeCaseOperation::Lowercase) {
+                baseName = baseName.toLower();
+            } else if (spec.caseType == ChangeCaseOperation::Uppercase) {
+                baseName = baseName.toUpper();
+            } else {
+                baseName = baseName.toLower();
+                bool capitalizeNext = true;
+                for (int i = 0; i < baseName.length(); ++i) {
+                    QChar c = baseName[i];
+                    if (c.isLetter()) {
+                        if (capitalizeNext) {
+                            baseName[i] = c.toUpper();
+                            capitalizeNext = false;
+                        }
+                    } else {
+                        capitalizeNext = true;
+                    }
+                }
+            }
+            return baseName + extension;
+        case OperationType::NewName:
+            return expandTags(spec.value, context) + extension;
+        case OperationType::DictionaryReplace:
+        case OperationType::MappingFile:
+            break; // Read a file; the dictionary automaton is checked with dictionaryReplace() below
+    }
+    return fileName;
+}
+
+// At every position the longest find starting there wins; replaced text is skipped
+QString dictionaryReplace(const QList<ReplacementDictionary::Pair> &pairs, const QString &text)
+{
+    QHash<QString, QString> dictionary;
+    for (const ReplacementDictionary::Pair &pair : pairs) {
+        if (!pair.first.isEmpty()) {
+            dictionary.insert(pair.first, pair.second);
+        }
+    }
+    
+    QString result;
+    int i = 0;
+    while (i < text.length()) {
+        QString longest;
+        for (auto it = dictionary.constBegin(); it != dictionary.constEnd(); ++it) {
+            if (it.key().length() > longest.length() && text.mid(i).startsWith(it.key())) {
+                longest = it.key();
+            }
+        }
+        if (longest.isEmpty()) {
+            result += text[i];
+            ++i;
+        } else {
+            result += dictionary.value(longest);
+            i += longest.length();
+        }
+    }
+    return result;
+}
+
+bool matches(const QString &condition, const QString &fileName)
+{
+    if (condition.startsWith("re:")) {
+        if (condition.size() == 3) {
+            return true;
+        }
+        QRegularExpression regex(condition.mid(3));
+        return regex.isValid() && regex.match(fileName).hasMatch();
+    }
+    
+    bool empty = true;
+    for (const QString &part : condition.split(';')) {
+        const QString term = part.trimmed();
+        if (term.isEmpty()) {
+            continue;
+        }
+        empty = false;
+        if (term.contains('*') || term.contains('?') || term.contains('[')) {
+            QRegularExpression glob(QRegularExpression::wildcardToRegularExpression(term),
+                                    QRegularExpression::CaseInsensitiveOption);
+            if (glob.isValid() && glob.match(fileName).hasMatch()) {
+                return true;
+            }
+        } else if (fileName.contains(term, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return empty;
+}
+
+} // namespace Reference
+
+// Building blocks for generated names and operation values, biased towards edge cases
+const QStringList NameParts = {
+    "a", "Z", "photo", "IMG", "_", "-", " ", "  ", "0", "42", "007", ".", "..",
+    "tar", "gz", "JPG", "Straße", "é", "é", "İ", "ǅ", "Ω", "ﬁ", "漢字", "😀", "🇩🇪",
+    "<0>", "<00:5>", "<hash:md5>", "\\1", "$1", "(", ")", "[x]", "+", "*"
+};
+
+const QStringList Patterns = {
+    "a", "photo", " ", "_", ".", "\\.", "\\d+", "[0-9]", "^", "$", "^IMG", "(a|Z)",
+    "(\\w+)", "\\s+", "é", "é", "😀", "ß", "[", "(", "*", "a{2}", "(?i)img", "",
+    "a*", "x*$", "\\b", "(?<=a).", "(a)|(Z)", "(*UCP)\\w+", "(?x) a # comment", "(*COMMIT)a"
+};
+
+const QStringList TagTexts = {
+    "", "x", "_", "<0>", "<00>", "<000:14>", "<00:0>", "<0:dir>", "<00:1:ext>", "<0:3:dir+ext>",
+    "<hash:md5>", "<hash:xxh64:8>", "<hash:sha1:0>", "<hash:nope>", "<hash:xxh64:99>",
+    "<0", "0>", "<>", "<abc>", "\\1", "\\0", "$1", "-\\2-", "é<0>ü", "😀<00>", "<0><0>",
+    "pre_<000:7>_post", "<hash:md5><0>", "<mtime:yyyy>/<mtime:MM>/", "<mtime:yyyy-MM-dd>_",
+    "<mtime:>", "<mtime:<0>>"
+};
+
+const QStringList Extensions = {"", ".txt", "txt", ".", ".tar.gz", "JPEG", ".é", "<0>"};
+
+const QStringList Conditions = {
+    "*.txt", "*.JPG;*.mp4", "*.tar.gz", "*.", "*.gz;*a*", "photo", "IMG; *.é", "*.Txt;;",
+    "?*.jpg", "[a-z]*", "*.ǅ", "re:^IMG", "re:\\d+", "re:photo", "re:[", "re:", ";", "re:^\\.",
+    "*.txt;re:x"
+};
+
+QString pick(QRandomGenerator &random, const QStringList &list)
+{
+    return list.at(random.bounded(int(list.size())));
+}
+
+QString randomName(QRandomGenerator &random)
+{
+    QString name;
+    // Dotfiles and names that are only dots exercise the extension rules
+    const int leadingDots = random.bounded(8) == 0 ? 1 + random.bounded(2) : 0;
+    name.fill('.', leadingDots);
+    const int parts = 1 + random.bounded(6);
+    for (int i = 0; i < parts; ++i) {
+        name += pick(random, NameParts);
+    }
+    if (random.bounded(3) != 0) {
+        name += '.' + pick(random, {"txt", "jpg", "JPG", "tar", "gz", "é", "", "MP4"});
+    }
+    return name;
+}
+
+OperationSpec randomSpec(QRandomGenerator &random)
+{
+    // Dictionary replace and mapping files need a file; the automaton is checked on its own
+    OperationSpec spec;
+    spec.type = OperationType(random.bounded(int(OperationType::NewName) + 1));
+    switch (spec.type) {
+        case OperationType::Replace:
+            spec.value = pick(random, Patterns);
+            spec.replacement = pick(random, TagTexts);
+            break;
+        case OperationType::Insert:
+            spec.value = pick(random, {"0", "1", "3", "-2", "100", "abc", ""});
+            spec.replacement = pick(random, TagTexts);
+            break;
+        case OperationType::ChangeExtension:
+            spec.value = pick(random, Extensions);
+            break;
+        case OperationType::ChangeCase:
+            spec.caseType = ChangeCaseOperation::CaseType(random.bounded(3));
+            break;
+        default:
+            spec.value = pick(random, TagTexts);
+            break;
+    }
+    if (random.bounded(3) == 0) {
+        spec.condition = pick(random, Conditions);
+    }
+    return spec;
+}
+
+TagContext randomContext(QRandomGenerator &random)
+{
+    TagContext context;
+    context.fileIndex = random.bounded(2000);
+    context.directoryIndex = random.bounded(50);
+    context.extensionIndex = random.bounded(50);
+    context.directoryExtensionIndex = random.bounded(10);
+    if (random.bounded(2) == 0) {
+        context.contentHashes.insert("md5", "d41d8cd98f00b204e9800998ecf8427e");
+    }
+    if (random.bounded(2) == 0) {
+        context.contentHashes.insert("xxh64", "ef46db3751d8e999");
+    }
+    if (random.bounded(2) == 0) {
+        context.modified = random.bounded(Q_INT64_C(2000000000)) * Q_INT64_C(1000000000);
+    }
+    return context;
+}
+
+QList<ReplacementDictionary::Pair> randomDictionary(QRandomGenerator &random)
+{
+    // Short finds from few parts, so they overlap, nest and repeat
+    QList<ReplacementDictionary::Pair> pairs;
+    const int count = random.bounded(10);
+    for (int i = 0; i < count; ++i) {
+        QString find;
+        const int parts = random.bounded(3);
+        for (int part = 0; part <= parts; ++part) {
+            find += pick(random, NameParts).left(1 + random.bounded(2));
+        }
+        pairs.append({find, pick(random, {"", "x", "_", "é", "😀", "<0>", find + find})});
+    }
+    return pairs;
+}
+
+QString describe(const QList<ReplacementDictionary::Pair> &pairs)
+{
+    QStringList texts;
+    for (const ReplacementDictionary::Pair &pair : pairs) {
+        texts.append(QString("\"%1\" -> \"%2\"").arg(pair.first, pair.second));
+    }
+    return QString("dictionary(%1)").arg(texts.join(", "));
+}
+
+QString describe(const OperationSpec &spec)
+{
+    return QString("%1(value=\"%2\", replacement=\"%3\", case=%4, condition=\"%5\")")
+        .arg(OperationFactory::typeId(spec.type), spec.value, spec.replacement,
+             OperationFactory::caseTypeId(spec.caseType), spec.condition);
+}
+
+// Per-entry struct of the former array-of-structs file list; the baseline of
+// benchmarkPreview()
+struct LegacyEntry {
+    QString filePath;
+    QString originalName;
+    QString newName;
+    QString directory;
+    QHash<QString, QString> contentHashes;
+    int previewState = 0;
+    FileMetadata metadata;
+    bool stale = false;
+};
+
+} // namespace
+
+int EngineVerifier::run(int iterations, quint32 seed, QTextStream &out)
+{
+    QRandomGenerator random(seed);
+    int mismatches = 0;
+    
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        const QString fileName = randomName(random);
+        const TagContext context = randomContext(random);
+        
+        QList<OperationSpec> specs;
+        const int chainLength = 1 + random.bounded(4);
+        for (int i = 0; i < chainLength; ++i) {
+            specs.append(randomSpec(random));
+        }
+        
+        // Compare after every step so a report names the operation that diverged
+        QString expected = fileName;
+        QString actual = fileName;
+        for (const OperationSpec &spec : specs) {
+            const QString input = expected;
+            expected = Reference::matches(spec.condition, input)
+                ? Reference::perform(spec, input, context) : input;
+            const std::shared_ptr<Operation> operation = OperationFactory::create(spec);
+            actual = operation->appliesTo(input) ? operation->perform(input, context) : input;
+            if (actual != expected) {
+                if (mismatches < MaxReportedMismatches) {
+                    out << "Mismatch in iteration " << iteration << ": " << describe(spec) << "\n"
+                        << "  input:     \"" << input << "\"\n"
+                        << "  reference: \"" << expected << "\"\n"
+                        << "  engine:    \"" << actual << "\"\n";
+                }
+                ++mismatches;
+                break;
+            }
+        }
+        
+        // The dictionary automaton against a plain longest-match scan
+        const QList<ReplacementDictionary::Pair> pairs = randomDictionary(random);
+        const QString expectedText = Reference::dictionaryReplace(pairs, fileName);
+        QString actualText = fileName;
+        ReplacementDictionary(pairs).replace(fileName, actualText);
+        if (actualText != expectedText) {
+            if (mismatches < MaxReportedMismatches) {
+                out << "Mismatch in iteration " << iteration << ": " << describe(pairs) << "\n"
+                    << "  input:     \"" << fileName << "\"\n"
+                    << "  reference: \"" << expectedText << "\"\n"
+                    << "  engine:    \"" << actualText << "\"\n";
+            }
+            ++mismatches;
+        }
+    }
+    
+    // Catastrophic backtracking stops at the match limits; the name is reported and
+    // kept rather than half replaced
+    const ReplaceOperation pathological(QStringLiteral("(a+)+$"), QStringLiteral("x"));
+    const QString longName = QString(40, QLatin1Char('a')) + QStringLiteral("!.txt");
+    bool limitExceeded = false;
+    if (pathological.performWithinLimits(longName, TagContext(), limitExceeded) != longName || !limitExceeded) {
+        out << "Mismatch: \"(a+)+$\" on \"" << longName << "\" was not stopped by the match limits\n";
+        ++mismatches;
+    }
+    
+    out << "Checked " << iterations << " operation chains (seed " << seed << "): "
+        << mismatches << " mismatch(es)\n";
+    out.flush();
+    return mismatches;
+}
+
+int EngineVerifier::benchmarkPreview(int count, QTextStream &out)
+{
+    count = qMax(count, 1);
+    const QList<std::shared_ptr<Operation>> operations{
+        OperationFactory::create({OperationType::Replace, QStringLiteral(" "), QStringLiteral("_")}),
+        OperationFactory::create({OperationType::Prefix, QStringLiteral("<000000:1>_")})};
+    const auto directoryOf = [](int i) {
+        return QStringLiteral("/benchmark/folder_%1").arg(i / 1000, 4, 10, QLatin1Char('0'));
+    };
+    const auto nameOf = [](int i) {
+        return QStringLiteral("IMG %1.jpg").arg(i, 7, 10, QLatin1Char('0'));
+    };
+    
+    QList<LegacyEntry> legacy(count);
+    EntryStore store;
+    store.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        LegacyEntry &entry = legacy[i];
+        entry.directory = directoryOf(i);
+        entry.originalName = nameOf(i);
+        entry.newName = entry.originalName;
+        entry.filePath = entry.directory + QLatin1Char('/') + entry.originalName;
+        store.append(entry.directory, entry.originalName);
+    }
+    QList<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    QList<int> chunks(store.newNameColumn().chunkCount());
+    std::iota(chunks.begin(), chunks.end(), 0);
+    
+    // Best of a few rounds, so both layouts run with warm caches and thread pool
+    constexpr int Rounds = 3;
+    qint64 legacyNs = std::numeric_limits<qint64>::max();
+    qint64 columnNs = std::numeric_limits<qint64>::max();
+    QElapsedTimer timer;
+    for (int round = 0; round < Rounds; ++round) {
+        // Former pass: one job per entry over the structs, then a store per entry
+        timer.start();
+        const QList<QString> names = QtConcurrent::blockingMapped<QList<QString>>(
+            indices, [&legacy, &operations](int i) {
+                const LegacyEntry &entry = legacy[i];
+                TagContext context;
+                context.fileIndex = i;
+                context.contentHashes = entry.contentHashes;
+                if (entry.metadata.isValid()) {
+                    context.modified = entry.metadata.modified;
+                }
+                return FileListWidget::applyOperations(entry.originalName, operations, context);
+            });
+        for (int i = 0; i < count; ++i) {
+            legacy[i].newName = names[i];
+            legacy[i].previewState = 0;
+        }
+        legacyNs = qMin(legacyNs, timer.nsecsElapsed());
+        
+        // Column pass: one job per chunk, installed chunk-wise with one flag byte per entry
+        timer.start();
+        PreviewInput input;
+        input.files = store;
+        input.operations = operations;
+        const QList<PreviewChunk> results = QtConcurrent::blockingMapped<QList<PreviewChunk>>(
+            chunks, [&input](int chunk) {
+                return FileListWidget::computePreview(input, chunk, QList<int>());
+            });
+        input.files.clear();
+        for (const PreviewChunk &preview : results) {
+            store.setNewNameChunk(preview.chunk, preview.names);
+            const int first = preview.chunk * StringColumn::ChunkSize;
+            for (int k = 0; k < preview.names->size(); ++k) {
+                store.setPreviewState(first + k, EntryStore::PreviewState(preview.states[k]));
+            }
+        }
+        columnNs = qMin(columnNs, timer.nsecsElapsed());
+    }
+    
+    int mismatches = 0;
+    for (int i = 0; i < count; ++i) {
+        mismatches += store.newNameColumn().at(i) != legacy[i].newName;
+    }
+    
+    const auto report = [&out, count](const char *layout, qint64 elapsedNs) {
+        elapsedNs = qMax<qint64>(elapsedNs, 1);
+        out << layout << ": " << count << " previews in " << QString::number(elapsedNs / 1e6, 'f', 1)
+            << " ms, " << QString::number(count * 1e9 / elapsedNs, 'f', 0) << " previews/s" << Qt::endl;
+    };
+    report("array of structs", legacyNs);
+    report("structure of arrays", columnNs);
+    out << "speedup: " << QString::number(double(legacyNs) / qMax<qint64>(columnNs, 1), 'f', 2) << "x";
+    if (mismatches > 0) {
+        out << ", " << mismatches << " names differ";
+    }
+    out << Qt::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int EngineVerifier::benchmarkRename(const QString &directory, int count, QTextStream &out)
+{
+    const QString scratch = QDir(directory).absoluteFilePath(
+        QStringLiteral("regex-rename-benchmark-%1").arg(QCoreApplication::applicationPid()));
+    if (!QDir().mkpath(scratch)) {
+        out << "Cannot create " << scratch << Qt::endl;
+        return 1;
+    }
+    
+    QList<RenameExecutor::Backend> backends{RenameExecutor::ThreadPoolBackend};
+    if (RenameExecutor::isIoUringAvailable()) {
+        backends.append(RenameExecutor::IoUringBackend);
+    } else {
+        out << "io_uring: not available, skipped" << Qt::endl;
+    }
+    
+    int failures = 0;
+    for (RenameExecutor::Backend backend : std::as_const(backends)) {
+        // Fresh files for every backend, so each one renames into an identical directory
+        QList<RenameTask> tasks;
+        tasks.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            const QString source = scratch + QStringLiteral("/file_%1").arg(i, 7, 10, QLatin1Char('0'));
+            QFile file(source);
+            if (!file.open(QIODevice::WriteOnly)) {
+                out << "Cannot create " << source << ": " << file.errorString() << Qt::endl;
+                QDir(scratch).removeRecursively();
+                return 1;
+            }
+            tasks.append({source, scratch + QStringLiteral("/renamed_%1").arg(i, 7, 10, QLatin1Char('0'))});
+        }
+        
+        RenameExecutor executor(backend);
+        QElapsedTimer timer;
+        timer.start();
+        const QList<int> results = executor.run(tasks);
+        const qint64 elapsedNs = qMax<qint64>(timer.nsecsElapsed(), 1);
+        
+        const int failed = int(std::count_if(results.begin(), results.end(),
+                                             [](int error) { return error != 0; }));
+        failures += failed;
+        out << RenameExecutor::backendName(backend) << ": " << count << " renames in "
+            << QString::number(elapsedNs / 1e6, 'f', 1) << " ms, "
+            << QString::number(count * 1e9 / elapsedNs, 'f', 0) << " renames/s";
+        if (failed > 0) {
+            out << ", " << failed << " failed (" << RenameExecutor::errorString(*std::find_if(
+                results.begin(), results.end(), [](int error) { return error != 0; })) << ")";
+        }
+        out << Qt::endl;
+        
+        QDir(scratch).removeRecursively();
+        QDir().mkpath(scratch);
+    }
+    
+    QDir(scratch).removeRecursively();
+    return failures == 0 ? 0 : 1;
+}
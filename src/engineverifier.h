@@ -0,0 +1,58 @@
+#ifndef ENGINEVERIFIER_H
+#define ENGINEVERIFIER_H
+
+#include <QtGlobal>
+
+class QString;
+class QTextStream;
+
+/**
+ * @brief Differential check of the operation engine against a reference implementation.
+ *
+ * The reference implementation is the straightforward version of every operation
+ * (regex compiled per call, tags parsed per call, Unicode case conversion, separate
+ * basename/extension strings). Random and edge-case file names are run through
+ * random operation chains in both engines and every difference is reported, so
+ * fast paths in Operation::perform() cannot silently change results. Random
+ * dictionaries are checked against a plain longest-match scan the same way, and a
+ * pattern with catastrophic backtracking has to stop at the match limits.
+ * Run with `regex-rename-verify [--seed N] [--iterations N]`, or through ctest.
+ *
+ * Also hosts the benchmarks: the preview pass against the former per-entry layout
+ * and the rename backends against each other. All of this is built into the
+ * regex-rename-verify test executable only, never into the shipped program.
+ */
+class EngineVerifier
+{
+public:
+    /**
+     * @brief Compare both engines on generated inputs.
+     * @param iterations Number of random file name / operation chain pairs
+     * @param seed Seed for the input generator; the same seed gives the same inputs
+     * @param out Receives a report of every mismatch (the first few in detail) and a summary
+     * @return Number of mismatches
+     */
+    static int run(int iterations, quint32 seed, QTextStream &out);
+    
+    /**
+     * @brief Measure preview throughput of the column layout against per-entry structs.
+     *
+     * Builds count synthetic entries, previews them with a replace and a numbering
+     * prefix in both layouts and checks that the new names agree. Run with
+     * `regex-rename-verify --benchmark-preview [--count N]`.
+     * @return 0 if both layouts produced the same names
+     */
+    static int benchmarkPreview(int count, QTextStream &out);
+    
+    /**
+     * @brief Measure renames per second of every available rename backend.
+     *
+     * Creates count empty files in a scratch folder below directory, renames them
+     * with each RenameExecutor backend and removes the folder again. Run with
+     * `regex-rename-verify --benchmark-rename <directory> [--count N]`.
+     * @return 0 if every rename succeeded
+     */
+    static int benchmarkRename(const QString &directory, int count, QTextStream &out);
+};
+
+#endif // ENGINEVERIFIER_H
@@ -0,0 +1,575 @@
+#include "entrystore.h"
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// A spill file is replaced once its dead regions (chunks rewritten since) exceed this
+constexpr qint64 SpillSlack = qint64(64) << 20;
+
+bool sameStrings(const StringChunk &a, const StringChunk &b)
+{
+    if (a.size() != b.size() || a.byteSize() != b.byteSize()) {
+        return false;
+    }
+    for (int k = 0; k < a.size(); ++k) {
+        if (a.at(k) != b.at(k)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Split an absolute path like QFileInfo does: "/a/b" -> "/a", "b"; "/b" -> "/", "b"
+void splitPath(const QString &path, QStringView &directory, QStringView &name)
+{
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    name = QStringView(path).mid(slash + 1);
+    directory = slash > 0 ? QStringView(path).left(slash) : QStringView(path).left(slash + 1);
+}
+
+QString joinPath(const QString &directory, QStringView name)
+{
+    QString path;
+    path.reserve(directory.size() + 1 + name.size());
+    path += directory;
+    if (!directory.endsWith(QLatin1Char('/'))) {
+        path += QLatin1Char('/');
+    }
+    path += name;
+    return path;
+}
+
+size_t pathKey(int directoryId, QStringView name)
+{
+    return qHashMulti(0, directoryId, name);
+}
+
+} // namespace
+
+/**
+ * @brief Append-only temporary file that cold chunks are copied into and mapped from.
+ */
+class SpillFile
+{
+public:
+    explicit SpillFile(const QString &directory)
+        : file(QDir(directory).filePath(QStringLiteral("regex-rename-spill-XXXXXX")))
+    {
+        QDir().mkpath(directory);
+        valid = file.open();
+    }
+    
+    bool isValid() const { return valid; }
+    
+    /**
+     * @brief Append two buffers as one region and map it.
+     * @return The mapping, or null on failure
+     */
+    uchar *write(const void *first, qint64 firstSize, const void *second, qint64 secondSize)
+    {
+        QMutexLocker locker(&mutex);
+        // Regions start 8-byte aligned, so the offset tables in them are aligned
+        const qint64 start = (end + 7) & ~qint64(7);
+        const qint64 size = firstSize + secondSize;
+        if (!file.seek(start)
+            || file.write(static_cast<const char *>(first), firstSize) != firstSize
+            || file.write(static_cast<const char *>(second), secondSize) != secondSize
+            || !file.flush()) {
+            return nullptr;
+        }
+        uchar *mapping = file.map(start, qMax<qint64>(size, 1));
+        if (!mapping) {
+            return nullptr;
+        }
+        end = start + size;
+        live += size;
+        sizes.insert(mapping, size);
+        return mapping;
+    }
+    
+    void release(uchar *mapping)
+    {
+        QMutexLocker locker(&mutex);
+        live -= sizes.take(mapping);
+        file.unmap(mapping);
+    }
+    
+    /**
+     * @brief Whether most of the file is dead space from rewritten chunks.
+     */
+    bool isWasteful()
+    {
+        QMutexLocker locker(&mutex);
+        return end > 2 * live + SpillSlack;
+    }
+    
+private:
+    QMutex mutex;
+    QTemporaryFile file;
+    bool valid = false;
+    qint64 end = 0;
+    qint64 live = 0;
+    QHash<uchar *, qint64> sizes;
+};
+
+StringChunk::StringChunk(QList<quint32> offsets, QList<char16_t> text)
+    : ownedOffsets(std::move(offsets)), ownedText(std::move(text))
+{
+    this->offsets = ownedOffsets.constData();
+    this->text = ownedText.constData();
+    count = int(ownedOffsets.size()) - 1;
+}
+
+StringChunk::~StringChunk()
+{
+    if (file && mapping) {
+        file->release(mapping);
+    }
+}
+
+qint64 StringChunk::byteSize() const
+{
+    return qint64(count + 1) * qint64(sizeof(quint32)) + qint64(offsets[count]) * qint64(sizeof(char16_t));
+}
+
+std::shared_ptr<const StringChunk> StringChunk::spill(const std::shared_ptr<SpillFile> &spillFile) const
+{
+    const qint64 offsetBytes = qint64(count + 1) * qint64(sizeof(quint32));
+    const qint64 textBytes = qint64(offsets[count]) * qint64(sizeof(char16_t));
+    uchar *spilled = spillFile->write(offsets, offsetBytes, text, textBytes);
+    if (!spilled) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<StringChunk> chunk(new StringChunk());
+    chunk->offsets = reinterpret_cast<const quint32 *>(spilled);
+    chunk->text = reinterpret_cast<const char16_t *>(spilled + offsetBytes);
+    chunk->count = count;
+    chunk->file = spillFile;
+    chunk->mapping = spilled;
+    return chunk;
+}
+
+void StringChunkBuilder::reserve(int count, qsizetype characters)
+{
+    offsets.reserve(count + 1);
+    text.reserve(characters);
+}
+
+void StringChunkBuilder::append(QStringView string)
+{
+    const qsizetype start = text.size();
+    text.resize(start + string.size());
+    std::copy(string.utf16(), string.utf16() + string.size(), text.data() + start);
+    offsets.append(quint32(text.size()));
+}
+
+QStringView StringChunkBuilder::at(int i) const
+{
+    return QStringView(text.constData() + offsets[i], qsizetype(offsets[i + 1] - offsets[i]));
+}
+
+qint64 StringChunkBuilder::byteSize() const
+{
+    return qint64(offsets.size()) * qint64(sizeof(quint32)) + qint64(text.size()) * qint64(sizeof(char16_t));
+}
+
+std::shared_ptr<const StringChunk> StringChunkBuilder::finish()
+{
+    auto chunk = std::make_shared<const StringChunk>(std::move(offsets), std::move(text));
+    offsets = QList<quint32>{0};
+    text = QList<char16_t>();
+    return chunk;
+}
+
+void StringColumn::append(QStringView text)
+{
+    tail.append(text);
+    if (tail.size() == ChunkSize) {
+        chunks.append(tail.finish());
+    }
+}
+
+void StringColumn::set(const QList<int> &indices, const QStringList &texts)
+{
+    // Chunks are immutable: group the changes by chunk and rebuild each chunk once
+    QList<int> order(indices.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&indices](int a, int b) {
+        return indices[a] < indices[b];
+    });
+    
+    qsizetype next = 0;
+    while (next < order.size()) {
+        const int chunk = indices[order[next]] / ChunkSize;
+        const bool sealed = chunk < chunks.size();
+        const int count = sealed ? chunks[chunk]->size() : tail.size();
+        const qsizetype first = qsizetype(chunk) * ChunkSize;
+        StringChunkBuilder builder;
+        builder.reserve(count, sealed ? chunks[chunk]->byteSize() / qsizetype(sizeof(char16_t)) : 0);
+        for (int k = 0; k < count; ++k) {
+            QStringView text = sealed ? chunks[chunk]->at(k) : tail.at(k);
+            while (next < order.size() && indices[order[next]] == first + k) {
+                text = texts[order[next]];
+                ++next;
+            }
+            builder.append(text);
+        }
+        if (sealed) {
+            chunks[chunk] = builder.finish();
+        } else {
+            tail = builder;
+        }
+    }
+}
+
+void StringColumn::clear()
+{
+    chunks.clear();
+    tail = StringChunkBuilder();
+}
+
+void StringColumn::remove(const QList<bool> &removed)
+{
+    // Chunks before the first removed string are kept as they are (and stay shared)
+    const qsizetype count = size();
+    const qsizetype first = std::find(removed.cbegin(), removed.cbegin() + count, true) - removed.cbegin();
+    if (first == count) {
+        return;
+    }
+    
+    StringColumn kept;
+    const int keptChunks = int(first / ChunkSize);
+    kept.chunks = chunks.mid(0, keptChunks);
+    for (qsizetype i = qsizetype(keptChunks) * ChunkSize; i < count; ++i) {
+        if (!removed[i]) {
+            kept.append(at(i));
+        }
+    }
+    *this = std::move(kept);
+}
+
+void StringColumn::replaceChunk(int chunk, const std::shared_ptr<const StringChunk> &replacement)
+{
+    if (chunk < chunks.size()) {
+        Q_ASSERT(replacement->size() == ChunkSize);
+        chunks[chunk] = replacement;
+        return;
+    }
+    Q_ASSERT(replacement->size() == tail.size());
+    StringChunkBuilder builder;
+    for (int k = 0; k < replacement->size(); ++k) {
+        builder.append(replacement->at(k));
+    }
+    tail = builder;
+}
+
+qint64 StringColumn::residentBytes() const
+{
+    qint64 bytes = 0;
+    for (const auto &chunk : chunks) {
+        if (!chunk->isSpilled()) {
+            bytes += chunk->byteSize();
+        }
+    }
+    return bytes + tail.byteSize();
+}
+
+EntryStore::EntryStore()
+    : budget(DefaultMemoryBudget),
+      spillPath(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+{
+}
+
+void EntryStore::clear()
+{
+    originalNames.clear();
+    newNames.clear();
+    directories.clear();
+    directoryIndex.clear();
+    directoryIds.clear();
+    pathIndex.clear();
+    flags.clear();
+    metadataColumn.clear();
+    hashColumn.clear();
+    outOfCore = false;
+    spillFile.reset();
+}
+
+void EntryStore::reserve(qsizetype count)
+{
+    directoryIds.reserve(count);
+    pathIndex.reserve(count);
+    flags.reserve(count);
+    metadataColumn.reserve(count);
+    hashColumn.reserve(count);
+}
+
+int EntryStore::directoryIdOf(const QString &directory)
+{
+    auto it = directoryIndex.constFind(directory);
+    if (it == directoryIndex.constEnd()) {
+        it = directoryIndex.insert(directory, int(directories.size()));
+        directories.append(directory);
+    }
+    return it.value();
+}
+
+void EntryStore::append(int directoryId, QStringView name, const FileMetadata &metadata)
+{
+    directoryIds.append(directoryId);
+    originalNames.append(name);
+    newNames.append(name);
+    flags.append(PreviewReady);
+    metadataColumn.append(metadata);
+    hashColumn.append(QHash<QString, QString>());
+    indexPath(flags.size() - 1);
+    
+    // Both columns just sealed a chunk; unchanged new names share the original's
+    const int sealed = originalNames.sealedChunkCount();
+    if (originalNames.size() % StringColumn::ChunkSize == 0 && sealed == newNames.sealedChunkCount()
+        && sameStrings(*originalNames.sealedChunk(sealed - 1), *newNames.sealedChunk(sealed - 1))) {
+        newNames.replaceChunk(sealed - 1, originalNames.sealedChunk(sealed - 1));
+    }
+}
+
+QString EntryStore::fullPath(qsizetype i) const
+{
+    return joinPath(directories[directoryIds[i]], originalNames.at(i));
+}
+
+QString EntryStore::newPath(qsizetype i) const
+{
+    return joinPath(directories[directoryIds[i]], newNames.at(i));
+}
+
+void EntryStore::appendPaths(const QStringList &paths, const QList<FileMetadata> &metadata)
+{
+    reserve(size() + paths.size());
+    
+    // Batches mostly come grouped by folder, so the directory table is only
+    // consulted when the folder changes
+    int directoryId = -1;
+    QStringView lastDirectory;
+    for (qsizetype k = 0; k < paths.size(); ++k) {
+        QStringView directory;
+        QStringView name;
+        splitPath(paths[k], directory, name);
+        if (directoryId < 0 || directory != lastDirectory) {
+            directoryId = directoryIdOf(directory.toString());
+            lastDirectory = directory;
+        }
+        append(directoryId, name, metadata[k]);
+    }
+}
+
+qsizetype EntryStore::indexOf(const QString &fullPath) const
+{
+    QStringView directory;
+    QStringView name;
+    splitPath(fullPath, directory, name);
+    const int directoryId = directoryIndex.value(directory.toString(), -1);
+    if (directoryId < 0) {
+        return -1;
+    }
+    for (auto it = pathIndex.constFind(pathKey(directoryId, name));
+         it != pathIndex.constEnd() && it.key() == pathKey(directoryId, name); ++it) {
+        if (directoryIds[it.value()] == directoryId && originalNames.at(it.value()) == name) {
+            return it.value();
+        }
+    }
+    return -1;
+}
+
+void EntryStore::indexPath(qsizetype i)
+{
+    pathIndex.insert(pathKey(directoryIds[i], originalNames.at(i)), int(i));
+}
+
+void EntryStore::unindexPath(qsizetype i)
+{
+    pathIndex.remove(pathKey(directoryIds[i], originalNames.at(i)), int(i));
+}
+
+void EntryStore::setNewNames(const QList<int> &indices, const QStringList &names)
+{
+    newNames.set(indices, names);
+}
+
+void EntryStore::setNewNameChunk(int chunk, const std::shared_ptr<const StringChunk> &names)
+{
+    // A chunk without changes shares the original names again
+    if (chunk < originalNames.sealedChunkCount() && sameStrings(*names, *originalNames.sealedChunk(chunk))) {
+        newNames.replaceChunk(chunk, originalNames.sealedChunk(chunk));
+        return;
+    }
+    newNames.replaceChunk(chunk, names);
+}
+
+void EntryStore::setLocations(const QList<int> &indices, const QStringList &directories,
+                              const QStringList &names)
+{
+    for (int i : indices) {
+        unindexPath(i);
+    }
+    for (qsizetype k = 0; k < indices.size(); ++k) {
+        directoryIds[indices[k]] = directoryIdOf(directories[k]);
+    }
+    originalNames.set(indices, names);
+    for (int i : indices) {
+        unindexPath(i); // No-op unless an index appears twice
+        indexPath(i);
+    }
+}
+
+void EntryStore::remove(const QList<bool> &removed)
+{
+    // One stable compaction pass per column; newIndex maps old to new positions
+    QList<int> newIndex(flags.size(), -1);
+    qsizetype kept = 0;
+    for (qsizetype i = 0; i < flags.size(); ++i) {
+        if (!removed[i]) {
+            if (kept != i) {
+                directoryIds[kept] = directoryIds[i];
+                flags[kept] = flags[i];
+                metadataColumn[kept] = metadataColumn[i];
+                hashColumn[kept] = std::move(hashColumn[i]);
+            }
+            newIndex[i] = int(kept);
+            ++kept;
+        }
+    }
+    if (kept == flags.size()) {
+        return;
+    }
+    directoryIds.resize(kept);
+    flags.resize(kept);
+    metadataColumn.resize(kept);
+    hashColumn.resize(kept);
+    originalNames.remove(removed);
+    newNames.remove(removed);
+    
+    // Rebuilt chunks of unchanged new names share the original names again
+    for (int chunk = 0; chunk < newNames.sealedChunkCount(); ++chunk) {
+        const auto &names = newNames.sealedChunk(chunk);
+        if (names != originalNames.sealedChunk(chunk) && sameStrings(*names, *originalNames.sealedChunk(chunk))) {
+            newNames.replaceChunk(chunk, originalNames.sealedChunk(chunk));
+        }
+    }
+    
+    // The path keys do not depend on positions, so the index is renumbered in place
+    // instead of hashing every name again
+    for (auto it = pathIndex.begin(); it != pathIndex.end();) {
+        if (newIndex[it.value()] < 0) {
+            it = pathIndex.erase(it);
+        } else {
+            it.value() = newIndex[it.value()];
+            ++it;
+        }
+    }
+}
+
+void EntryStore::setMemoryBudget(qint64 bytes)
+{
+    budget = bytes;
+    trimToBudget();
+}
+
+void EntryStore::setSpillDirectory(const QString &path)
+{
+    spillPath = path;
+}
+
+qint64 EntryStore::residentBytes() const
+{
+    // New names that are unchanged share the original's chunks; count those once
+    qint64 bytes = originalNames.residentBytes() + newNames.residentBytes();
+    for (int c = 0; c < newNames.sealedChunkCount(); ++c) {
+        const auto &chunk = newNames.sealedChunk(c);
+        if (chunk == originalNames.sealedChunk(c) && !chunk->isSpilled()) {
+            bytes -= chunk->byteSize();
+        }
+    }
+    return bytes;
+}
+
+std::shared_ptr<const StringChunk> EntryStore::place(const std::shared_ptr<const StringChunk> &chunk) const
+{
+    if (!outOfCore || !spillFile) {
+        return chunk;
+    }
+    std::shared_ptr<const StringChunk> spilled = chunk->spill(spillFile);
+    return spilled ? spilled : chunk;
+}
+
+void EntryStore::trimToBudget()
+{
+    qint64 resident = residentBytes();
+    qint64 total = resident;
+    qint64 originalBytes = originalNames.residentBytes();
+    for (int c = 0; c < originalNames.sealedChunkCount(); ++c) {
+        const auto &original = originalNames.sealedChunk(c);
+        const auto &renamed = newNames.sealedChunk(c);
+        if (original->isSpilled()) {
+            total += original->byteSize();
+            originalBytes += original->byteSize();
+        }
+        if (renamed != original && renamed->isSpilled()) {
+            total += renamed->byteSize();
+        }
+    }
+    outOfCore = total + originalBytes > budget;
+    const bool rotate = spillFile && spillFile->isWasteful();
+    if (resident <= budget && !outOfCore && !rotate) {
+        return;
+    }
+    
+    // Rewritten new names leave dead regions behind; move the live chunks to a fresh
+    // file once those dominate. The old file goes away with its last chunk.
+    if (!spillFile || rotate) {
+        auto file = std::make_shared<SpillFile>(spillPath);
+        if (!file->isValid()) {
+            return; // Keep everything in memory rather than fail
+        }
+        spillFile = file;
+    }
+    
+    auto spillChunk = [&](StringColumn &column, int c) {
+        const std::shared_ptr<const StringChunk> chunk = column.sealedChunk(c);
+        if (chunk->isSpilled() ? !rotate : resident <= budget) {
+            return true;
+        }
+        const std::shared_ptr<const StringChunk> spilled = chunk->spill(spillFile);
+        if (!spilled) {
+            return false;
+        }
+        if (!chunk->isSpilled()) {
+            resident -= chunk->byteSize();
+        }
+        column.replaceChunk(c, spilled);
+        return true;
+    };
+    
+    // Oldest chunks first; a chunk shared by both columns is spilled once
+    for (int c = 0; c < originalNames.sealedChunkCount(); ++c) {
+        if (resident <= budget && !rotate) {
+            break;
+        }
+        const bool shared = newNames.sealedChunk(c) == originalNames.sealedChunk(c);
+        if (!spillChunk(originalNames, c)) {
+            return;
+        }
+        if (shared) {
+            newNames.replaceChunk(c, originalNames.sealedChunk(c));
+        } else if (!spillChunk(newNames, c)) {
+            return;
+        }
+    }
+}
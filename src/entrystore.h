@@ -0,0 +1,371 @@
+#ifndef ENTRYSTORE_H
+#define ENTRYSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QList>
+#include <QHash>
+#include <memory>
+#include "filemetadata.h"
+
+class SpillFile;
+
+/**
+ * @brief Immutable block of consecutive strings of one column.
+ *
+ * The strings are one UTF-16 buffer plus an offset table. A resident chunk owns
+ * both; a spilled chunk points into a read-only mapping of the spill file, so the
+ * kernel can drop its pages under memory pressure and read them back on access.
+ * Chunks are shared between copies of a column and never modified.
+ */
+class StringChunk
+{
+public:
+    StringChunk(QList<quint32> offsets, QList<char16_t> text);
+    ~StringChunk();
+    
+    StringChunk(const StringChunk &) = delete;
+    StringChunk &operator=(const StringChunk &) = delete;
+    
+    int size() const { return count; }
+    
+    QStringView at(int i) const
+    {
+        return QStringView(text + offsets[i], qsizetype(offsets[i + 1] - offsets[i]));
+    }
+    
+    bool isSpilled() const { return file != nullptr; }
+    
+    /**
+     * @brief Size of the offsets and the text; resident unless spilled.
+     */
+    qint64 byteSize() const;
+    
+    /**
+     * @brief Copy the chunk into a spill file.
+     * @return The spilled copy, or null if the file could not be written
+     */
+    std::shared_ptr<const StringChunk> spill(const std::shared_ptr<SpillFile> &spillFile) const;
+    
+private:
+    StringChunk() = default;
+    
+    QList<quint32> ownedOffsets;
+    QList<char16_t> ownedText;
+    const quint32 *offsets = nullptr;
+    const char16_t *text = nullptr;
+    int count = 0;
+    std::shared_ptr<SpillFile> file; // Keeps the mapping alive while spilled
+    uchar *mapping = nullptr;
+};
+
+/**
+ * @brief Collects strings for a new StringChunk.
+ */
+class StringChunkBuilder
+{
+public:
+    void reserve(int count, qsizetype characters);
+    void append(QStringView text);
+    int size() const { return int(offsets.size()) - 1; }
+    QStringView at(int i) const;
+    qint64 byteSize() const;
+    
+    /**
+     * @brief Turn the collected strings into a chunk and start over.
+     */
+    std::shared_ptr<const StringChunk> finish();
+    
+private:
+    QList<quint32> offsets{0};
+    QList<char16_t> text;
+};
+
+/**
+ * @brief Column of strings stored in chunks of ChunkSize entries.
+ *
+ * Full chunks are immutable and shared between copies of the column, so a copy
+ * is a cheap snapshot for background work; changing a string rebuilds only its
+ * chunk. The last, partial chunk is kept open for appends.
+ */
+class StringColumn
+{
+public:
+    static constexpr int ChunkSize = 16384;
+    
+    qsizetype size() const { return qsizetype(chunks.size()) * ChunkSize + tail.size(); }
+    bool isEmpty() const { return size() == 0; }
+    
+    /**
+     * @brief The string at index i; valid until the column is changed.
+     */
+    QStringView at(qsizetype i) const
+    {
+        const qsizetype chunk = i / ChunkSize;
+        return chunk < chunks.size() ? chunks[chunk]->at(int(i % ChunkSize)) : tail.at(int(i % ChunkSize));
+    }
+    
+    void append(QStringView text);
+    void clear();
+    
+    /**
+     * @brief Replace strings; each affected chunk is rebuilt once.
+     * @param indices Positions to replace; if one appears twice, the later text wins
+     * @param texts New strings, one per index
+     */
+    void set(const QList<int> &indices, const QStringList &texts);
+    
+    /**
+     * @brief Keep only the strings whose flag is not set, in order.
+     */
+    void remove(const QList<bool> &removed);
+    
+    /**
+     * @brief Number of chunks including the partial last one.
+     */
+    int chunkCount() const { return int((size() + ChunkSize - 1) / ChunkSize); }
+    
+    /**
+     * @brief A full chunk; the partial last one is not available as a chunk.
+     */
+    const std::shared_ptr<const StringChunk> &sealedChunk(int chunk) const { return chunks[chunk]; }
+    int sealedChunkCount() const { return int(chunks.size()); }
+    
+    /**
+     * @brief Replace chunk c with one of the same size (also the partial last one).
+     */
+    void replaceChunk(int chunk, const std::shared_ptr<const StringChunk> &replacement);
+    
+    qint64 residentBytes() const;
+    
+private:
+    QList<std::shared_ptr<const StringChunk>> chunks;
+    StringChunkBuilder tail;
+};
+
+/**
+ * @brief The file list as a structure of arrays: one column per field.
+ *
+ * Original and new names are StringColumns; directories are interned and stored
+ * as one id per entry, and full paths are composed on demand. Preview state and
+ * the stale mark share one flag byte per entry, so passes over the whole list
+ * (previews, filters, conflict checks) read dense arrays instead of striding
+ * over mostly untouched per-entry structs. Once the resident
+ * name chunks exceed the memory budget, the oldest full chunks are moved to a
+ * memory-mapped spill file, so lists larger than RAM stay usable while peak RSS
+ * for the names stays near the budget. Copies share all chunks and can be handed
+ * to background threads as snapshots.
+ */
+class EntryStore
+{
+public:
+    static constexpr qint64 DefaultMemoryBudget = qint64(512) << 20;
+    
+    enum PreviewState : quint8 {
+        PreviewReady,
+        PreviewPending,    // Waiting for a content hash
+        PreviewUnreadable  // Content hash could not be computed
+    };
+    
+    /**
+     * @brief Bits of the per-entry flag byte.
+     */
+    enum Flag : quint8 {
+        PreviewStateMask = 0x03, // PreviewState
+        StaleFlag = 0x04,        // Missing or modified since the session it came from was saved
+        UnmatchedFlag = 0x08,    // Not in the mapping file of a Rename from Mapping operation
+        LimitFlag = 0x10,        // A pattern exceeded its match limits on the name
+        OutsideFolderFlag = 0x20 // The new name resolves outside the entry's folder
+    };
+    
+    EntryStore();
+    
+    qsizetype size() const { return flags.size(); }
+    bool isEmpty() const { return flags.isEmpty(); }
+    void clear();
+    void reserve(qsizetype count);
+    
+    /**
+     * @brief Id of a directory, which is added to the table if needed.
+     * @param directory Absolute directory, as returned by QFileInfo::absolutePath()
+     */
+    int directoryIdOf(const QString &directory);
+    
+    /**
+     * @brief Append an entry; the new name starts out as the original name.
+     */
+    void append(int directoryId, QStringView name, const FileMetadata &metadata = FileMetadata());
+    void append(const QString &directory, QStringView name, const FileMetadata &metadata = FileMetadata())
+    {
+        append(directoryIdOf(directory), name, metadata);
+    }
+    
+    /**
+     * @brief Append a batch of entries in one step.
+     * @param paths Absolute, clean paths that are not in the store yet
+     * @param metadata Metadata per path
+     */
+    void appendPaths(const QStringList &paths, const QList<FileMetadata> &metadata);
+    
+    /**
+     * @brief Index of the entry with this full path, or -1.
+     */
+    qsizetype indexOf(const QString &fullPath) const;
+    bool contains(const QString &fullPath) const { return indexOf(fullPath) >= 0; }
+    
+    const QString &directory(qsizetype i) const { return directories[directoryIds[i]]; }
+    int directoryId(qsizetype i) const { return directoryIds[i]; }
+    
+    /**
+     * @brief The interned directories, indexed by directory id.
+     */
+    const QStringList &directoryTable() const { return directories; }
+    QString originalName(qsizetype i) const { return originalNames.at(i).toString(); }
+    QString newName(qsizetype i) const { return newNames.at(i).toString(); }
+    QString fullPath(qsizetype i) const;
+    
+    /**
+     * @brief The path the entry would get with its new name (not cleaned).
+     */
+    QString newPath(qsizetype i) const;
+    
+    const StringColumn &originalNameColumn() const { return originalNames; }
+    const StringColumn &newNameColumn() const { return newNames; }
+    
+    PreviewState previewState(qsizetype i) const { return PreviewState(flags[i] & PreviewStateMask); }
+    void setPreviewState(qsizetype i, PreviewState state)
+    {
+        flags[i] = quint8((flags[i] & ~PreviewStateMask) | state);
+    }
+    
+    bool isStale(qsizetype i) const { return flags[i] & StaleFlag; }
+    void setStale(qsizetype i, bool stale)
+    {
+        flags[i] = quint8(stale ? flags[i] | StaleFlag : flags[i] & ~StaleFlag);
+    }
+    
+    /**
+     * @brief Whether the last preview found no row for the entry in a mapping file.
+     */
+    bool isUnmatched(qsizetype i) const { return flags[i] & UnmatchedFlag; }
+    void setUnmatched(qsizetype i, bool unmatched)
+    {
+        flags[i] = quint8(unmatched ? flags[i] | UnmatchedFlag : flags[i] & ~UnmatchedFlag);
+    }
+    
+    /**
+     * @brief Whether an operation gave up on the entry in the last preview because a
+     * pattern exceeded its match limits; the entry then keeps its name.
+     */
+    bool exceedsLimits(qsizetype i) const { return flags[i] & LimitFlag; }
+    void setExceedsLimits(qsizetype i, bool exceeds)
+    {
+        flags[i] = quint8(exceeds ? flags[i] | LimitFlag : flags[i] & ~LimitFlag);
+    }
+    
+    /**
+     * @brief Whether the last preview gave the entry a new name that resolves outside its
+     * folder (through ".." segments); the entry then keeps its name.
+     */
+    bool leavesFolder(qsizetype i) const { return flags[i] & OutsideFolderFlag; }
+    void setLeavesFolder(qsizetype i, bool leaves)
+    {
+        flags[i] = quint8(leaves ? flags[i] | OutsideFolderFlag : flags[i] & ~OutsideFolderFlag);
+    }
+    
+    /**
+     * @brief One flag byte per entry, for passes that scan the whole list.
+     */
+    const QList<quint8> &flagColumn() const { return flags; }
+    
+    /**
+     * @brief Metadata taken when the entry was added (or restored from a session).
+     */
+    const FileMetadata &metadata(qsizetype i) const { return metadataColumn[i]; }
+    void setMetadata(qsizetype i, const FileMetadata &metadata) { metadataColumn[i] = metadata; }
+    
+    /**
+     * @brief Algorithm -> digest; an empty digest means the file was unreadable.
+     */
+    const QHash<QString, QString> &contentHashes(qsizetype i) const { return hashColumn[i]; }
+    void setContentHash(qsizetype i, const QString &algorithm, const QString &digest)
+    {
+        hashColumn[i].insert(algorithm, digest);
+    }
+    
+    void setNewName(int i, const QString &name) { setNewNames({i}, {name}); }
+    void setNewNames(const QList<int> &indices, const QStringList &names);
+    
+    /**
+     * @brief Install a chunk of new names computed in the background.
+     */
+    void setNewNameChunk(int chunk, const std::shared_ptr<const StringChunk> &names);
+    
+    /**
+     * @brief Point entries at their new locations after renames or moves.
+     *
+     * The new names are not changed.
+     */
+    void setLocations(const QList<int> &indices, const QStringList &directories, const QStringList &names);
+    
+    /**
+     * @brief Remove the flagged entries, keeping the order of the rest.
+     */
+    void remove(const QList<bool> &removed);
+    
+    /**
+     * @brief Bytes of name data that may stay in memory before chunks are spilled.
+     */
+    qint64 memoryBudget() const { return budget; }
+    void setMemoryBudget(qint64 bytes);
+    
+    /**
+     * @brief Folder for spill files created from now on (the cache location by default).
+     */
+    const QString &spillDirectory() const { return spillPath; }
+    void setSpillDirectory(const QString &path);
+    
+    qint64 residentBytes() const;
+    
+    /**
+     * @brief Whether the names exceed the budget, so new chunks go to disk right away.
+     */
+    bool isOutOfCore() const { return outOfCore; }
+    
+    /**
+     * @brief Spill a freshly built chunk if the store is out of core.
+     *
+     * Safe to call from several threads on the same (unchanged) store.
+     */
+    std::shared_ptr<const StringChunk> place(const std::shared_ptr<const StringChunk> &chunk) const;
+    
+    /**
+     * @brief Spill full chunks, oldest first, until the resident names fit the budget.
+     *
+     * Call after bulk changes. Also decides whether the store is out of core, which
+     * is the case when the names would exceed the budget during the next preview
+     * pass (that builds a full column of new names next to the current one).
+     */
+    void trimToBudget();
+    
+private:
+    void indexPath(qsizetype i);
+    void unindexPath(qsizetype i);
+    
+    StringColumn originalNames;
+    StringColumn newNames;
+    QStringList directories;            // Interned directories
+    QHash<QString, int> directoryIndex; // Directory -> id
+    QList<int> directoryIds;            // Entry -> directory id
+    QMultiHash<size_t, int> pathIndex;  // Hash of the full path -> entry, for duplicate checks
+    QList<quint8> flags;                // PreviewState and the Flag bits per entry
+    QList<FileMetadata> metadataColumn;
+    QList<QHash<QString, QString>> hashColumn; // Empty (unallocated) until a hash arrives
+    qint64 budget;
+    bool outOfCore = false;
+    QString spillPath;
+    std::shared_ptr<SpillFile> spillFile; // Created when the budget is first exceeded
+};
+
+#endif // ENTRYSTORE_H
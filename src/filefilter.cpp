@@ -0,0 +1,252 @@
+#include "filefilter.h"
+#include "entrystore.h"
+#include <QStringMatcher>
+#include <QHash>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// One task per chunk of the store's name columns
+constexpr int ChunkSize = StringColumn::ChunkSize;
+
+// Run fn(chunk, begin, end) over [0, count) in parallel chunks of ChunkSize
+template <typename Fn>
+void forEachChunk(qsizetype count, Fn fn)
+{
+    QList<qsizetype> chunkStarts;
+    for (qsizetype begin = 0; begin < count; begin += ChunkSize) {
+        chunkStarts.append(begin);
+    }
+    QtConcurrent::blockingMap(chunkStarts, [count, &fn](const qsizetype &begin) {
+        fn(begin / ChunkSize, begin, qMin<qsizetype>(begin + ChunkSize, count));
+    });
+}
+
+// Per-code-unit case folding; the same function is applied to the query
+inline char16_t fold(char16_t c)
+{
+    if (c < 0x80) {
+        return c >= u'A' && c <= u'Z' ? char16_t(c + (u'a' - u'A')) : c;
+    }
+    return QChar(c).toCaseFolded().unicode();
+}
+
+QString foldText(const QString &text)
+{
+    QString folded(text.size(), Qt::Uninitialized);
+    QChar *out = folded.data();
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        out[i] = QChar(fold(text.at(i).unicode()));
+    }
+    return folded;
+}
+
+// Fold text into buffer, followed by a '\0' separator; buffer must have room for both
+void foldInto(QChar *buffer, QStringView text)
+{
+    const char16_t *source = text.utf16();
+    for (qsizetype k = 0; k < text.size(); ++k) {
+        buffer[k] = QChar(fold(source[k]));
+    }
+    buffer[text.size()] = QChar(0);
+}
+
+// Concatenate per-chunk results, which are each in ascending order
+QList<int> joinChunks(const QList<QList<int>> &chunks)
+{
+    qsizetype total = 0;
+    for (const QList<int> &chunk : chunks) {
+        total += chunk.size();
+    }
+    QList<int> result;
+    result.reserve(total);
+    for (const QList<int> &chunk : chunks) {
+        result.append(chunk);
+    }
+    return result;
+}
+
+} // namespace
+
+void FileFilter::invalidate()
+{
+    conflicts.clear();
+    conflictsValid = false;
+    lastValid = false;
+}
+
+void FileFilter::invalidateNewNames()
+{
+    conflicts.clear();
+    conflictsValid = false;
+    lastValid = false;
+}
+
+void FileFilter::buildConflicts(const EntryStore &files)
+{
+    // Unchanged entries target their own path, so renaming onto a listed file counts too.
+    // Only a hash per target path is kept for the whole list; the paths of entries whose
+    // hashes collide are composed again and compared
+    const qsizetype count = files.size();
+    QList<QPair<size_t, int>> keys(count);
+    QPair<size_t, int> *out = keys.data();
+    forEachChunk(count, [&](qsizetype, qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            out[i] = qMakePair(qHash(files.newPath(i)), int(i));
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+    
+    conflicts.fill(0, count);
+    for (qsizetype run = 0; run < count;) {
+        qsizetype runEnd = run + 1;
+        while (runEnd < count && keys[runEnd].first == keys[run].first) {
+            ++runEnd;
+        }
+        if (runEnd - run > 1) {
+            QList<QPair<QString, int>> paths;
+            paths.reserve(runEnd - run);
+            for (qsizetype k = run; k < runEnd; ++k) {
+                paths.append(qMakePair(files.newPath(keys[k].second), keys[k].second));
+            }
+            std::sort(paths.begin(), paths.end());
+            for (qsizetype k = 1; k < paths.size(); ++k) {
+                if (paths[k].first == paths[k - 1].first) {
+                    conflicts[paths[k].second] = 1;
+                    conflicts[paths[k - 1].second] = 1;
+                }
+            }
+        }
+        run = runEnd;
+    }
+    conflictsValid = true;
+}
+
+QList<int> FileFilter::apply(const EntryStore &files, Field field, const QString &text, Status status)
+{
+    const QString query = foldText(text);
+    if (status == ConflictsOnly && !conflictsValid) {
+        buildConflicts(files);
+    }
+    
+    const StringColumn &originalNames = files.originalNameColumn();
+    const StringColumn &newNames = files.newNameColumn();
+    const StringColumn &names = field == NewName ? newNames : originalNames;
+    const char *conflictFlags = conflicts.constData();
+    const quint8 *entryFlags = files.flagColumn().constData();
+    const QStringMatcher matcher(query, Qt::CaseSensitive);
+    
+    // Paths repeat per folder: each interned directory is matched once
+    QList<char> directoryMatches;
+    if (field == Path && !query.isEmpty()) {
+        const QStringList &directories = files.directoryTable();
+        directoryMatches.resize(directories.size());
+        char *out = directoryMatches.data();
+        forEachChunk(directories.size(), [&](qsizetype, qsizetype begin, qsizetype end) {
+            for (qsizetype d = begin; d < end; ++d) {
+                out[d] = matcher.indexIn(QStringView(foldText(directories.at(d)))) >= 0;
+            }
+        });
+    }
+    const char *directoryFlags = directoryMatches.constData();
+    
+    auto statusMatches = [&](qsizetype i) {
+        switch (status) {
+            case ChangedOnly:
+                return (entryFlags[i] & EntryStore::PreviewStateMask) == EntryStore::PreviewReady
+                    && newNames.at(i) != originalNames.at(i);
+            case ConflictsOnly:
+                return conflictFlags[i] != 0;
+            case UnmatchedOnly:
+                return (entryFlags[i] & EntryStore::UnmatchedFlag) != 0;
+            case LimitExceededOnly:
+                return (entryFlags[i] & EntryStore::LimitFlag) != 0;
+            case AllFiles:
+                break;
+        }
+        return true;
+    };
+    
+    // A longer query in the same field only needs to look at the previous matches
+    const bool narrowing = lastValid && !query.isEmpty() && field == lastField
+                        && status == lastStatus && query.contains(lastText);
+    
+    QList<int> result;
+    if (narrowing) {
+        const int *candidates = lastResult.constData();
+        QList<QList<int>> chunks((lastResult.size() + ChunkSize - 1) / ChunkSize);
+        forEachChunk(lastResult.size(), [&](qsizetype chunk, qsizetype begin, qsizetype end) {
+            QList<int> &matches = chunks[chunk];
+            QString folded;
+            for (qsizetype k = begin; k < end; ++k) {
+                const int i = candidates[k];
+                if (field == Path) {
+                    if (directoryFlags[files.directoryId(i)] != 0) {
+                        matches.append(i);
+                    }
+                    continue;
+                }
+                const QStringView name = names.at(i);
+                if (folded.size() < name.size() + 1) {
+                    folded.resize(name.size() + 1);
+                }
+                foldInto(folded.data(), name);
+                if (matcher.indexIn(QStringView(folded).first(name.size())) >= 0) {
+                    matches.append(i);
+                }
+            }
+        });
+        result = joinChunks(chunks);
+    } else {
+        QList<QList<int>> chunks((files.size() + ChunkSize - 1) / ChunkSize);
+        forEachChunk(files.size(), [&](qsizetype chunk, qsizetype begin, qsizetype end) {
+            QList<int> &matches = chunks[chunk];
+            if (query.isEmpty() || field == Path) {
+                for (qsizetype i = begin; i < end; ++i) {
+                    if ((query.isEmpty() || directoryFlags[files.directoryId(i)] != 0) && statusMatches(i)) {
+                        matches.append(int(i));
+                    }
+                }
+                return;
+            }
+            
+            // Fold this chunk's names into one buffer with '\0' between entries, so the
+            // chunk is a single scan; each hit is mapped to its entry, then the scan
+            // continues after that entry. The buffer is dropped with the task
+            QList<qsizetype> starts(end - begin + 1);
+            qsizetype offset = 0;
+            for (qsizetype i = begin; i < end; ++i) {
+                starts[i - begin] = offset;
+                offset += names.at(i).size() + 1;
+            }
+            starts[end - begin] = offset;
+            QString buffer(offset, Qt::Uninitialized);
+            for (qsizetype i = begin; i < end; ++i) {
+                foldInto(buffer.data() + starts[i - begin], names.at(i));
+            }
+            
+            qsizetype from = 0;
+            while (from < buffer.size()) {
+                const qsizetype hit = matcher.indexIn(QStringView(buffer), from);
+                if (hit < 0) {
+                    break;
+                }
+                const qsizetype entry = std::upper_bound(starts.cbegin(), starts.cend(), hit)
+                                      - starts.cbegin() - 1;
+                if (statusMatches(begin + entry)) {
+                    matches.append(int(begin + entry));
+                }
+                from = starts[entry + 1];
+            }
+        });
+        result = joinChunks(chunks);
+    }
+    
+    lastField = field;
+    lastStatus = status;
+    lastText = query;
+    lastResult = result;
+    lastValid = true;
+    return result;
+}
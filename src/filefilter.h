@@ -0,0 +1,72 @@
+#ifndef FILEFILTER_H
+#define FILEFILTER_H
+
+#include <QString>
+#include <QList>
+
+class EntryStore;
+
+/**
+ * @brief Substring and status filter over the file list.
+ *
+ * Names are read from the entry store one chunk per thread: the chunk is
+ * case-folded into a scratch buffer with '\0' between entries, so a query is a
+ * single QStringMatcher scan per chunk instead of one search per entry, and no
+ * folded copy of a whole column outlives the query. Paths are matched once per
+ * interned directory and mapped to the entries by directory id. A query that
+ * extends the previous one (same field and status) only re-checks the previous
+ * matches.
+ */
+class FileFilter
+{
+public:
+    enum Field {
+        OriginalName,
+        NewName,
+        Path,
+        FieldCount
+    };
+    
+    enum Status {
+        AllFiles,
+        ChangedOnly,      // New name differs from the original name
+        ConflictsOnly,    // Target path is also the target of another entry
+        UnmatchedOnly,    // Not in the mapping file of a Rename from Mapping operation
+        LimitExceededOnly // A pattern exceeded its match limits on the name
+    };
+    
+    /**
+     * @brief Drop all cached data after entries were added, removed or renamed.
+     */
+    void invalidate();
+    
+    /**
+     * @brief Drop data derived from new names after the previews changed.
+     */
+    void invalidateNewNames();
+    
+    /**
+     * @brief Find the entries matching a query.
+     * @param files The entries to filter
+     * @param field The field the text is searched in
+     * @param text Case-insensitive substring; empty matches every entry
+     * @param status Additional status condition
+     * @return Matching entry indices in ascending order
+     */
+    QList<int> apply(const EntryStore &files, Field field, const QString &text, Status status);
+
+private:
+    void buildConflicts(const EntryStore &files);
+    
+    QList<char> conflicts;  // Per entry, valid while conflictsValid
+    bool conflictsValid = false;
+    
+    // Previous query, its result is reused when the next query narrows it
+    Field lastField = OriginalName;
+    Status lastStatus = AllFiles;
+    QString lastText;
+    QList<int> lastResult;
+    bool lastValid = false;
+};
+
+#endif // FILEFILTER_H
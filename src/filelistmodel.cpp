@@ -0,0 +1,233 @@
+#include "filelistmodel.h"
+#include "filelistwidget.h"
+#include "filenamecodec.h"
+#include <QBrush>
+#include <QFont>
+#include <numeric>
+
+FileListModel::FileListModel(const EntryStore &files, QObject *parent)
+    : QAbstractTableModel(parent), files(files)
+{
+}
+
+int FileListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(displayOrder.size());
+}
+
+int FileListModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant FileListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= displayOrder.size()
+        || displayOrder[index.row()] >= files.size()) {
+        return QVariant();
+    }
+    
+    const int entryIndex = displayOrder[index.row()];
+    const EntryStore::PreviewState previewState = files.previewState(entryIndex);
+    const bool isNewName = index.column() == NewNameColumn;
+    const auto renamed = [&]() {
+        return files.newNameColumn().at(entryIndex) != files.originalNameColumn().at(entryIndex);
+    };
+    
+    switch (role) {
+        case Qt::DisplayRole:
+            switch (index.column()) {
+                case OriginalNameColumn:
+                    return FileNameCodec::display(files.originalName(entryIndex));
+                case NewNameColumn:
+                    if (previewState == EntryStore::PreviewPending) {
+                        return tr("(hashing...)");
+                    }
+                    if (previewState == EntryStore::PreviewUnreadable) {
+                        return tr("(cannot read file)");
+                    }
+                    return FileNameCodec::display(files.newName(entryIndex));
+                case PathColumn:
+                    return FileNameCodec::display(files.directory(entryIndex));
+            }
+            break;
+        case Qt::ToolTipRole:
+            if (files.isStale(entryIndex)) {
+                return tr("Missing or modified since the session was saved");
+            }
+            if (files.isUnmatched(entryIndex) && isNewName) {
+                return tr("Not in the mapping file");
+            }
+            if (files.exceedsLimits(entryIndex) && isNewName) {
+                return tr("A pattern exceeded its match limits on this name, so it keeps its name");
+            }
+            if (files.leavesFolder(entryIndex) && isNewName) {
+                return tr("The new name would move the file out of its folder, so it keeps its name");
+            }
+            break;
+        case Qt::ForegroundRole:
+            if (files.isStale(entryIndex) && index.column() == OriginalNameColumn) {
+                return QBrush(Qt::darkYellow);
+            }
+            if (isNewName && (files.exceedsLimits(entryIndex) || files.leavesFolder(entryIndex))) {
+                return QBrush(Qt::darkRed);
+            }
+            // Highlight changes in the new name column, grey out pending rows
+            if (isNewName && previewState != EntryStore::PreviewReady) {
+                return QBrush(Qt::gray);
+            }
+            if (isNewName && renamed()) {
+                return QBrush(Qt::darkGreen);
+            }
+            break;
+        case Qt::FontRole:
+            if (isNewName && previewState != EntryStore::PreviewReady) {
+                QFont font;
+                font.setItalic(true);
+                return font;
+            }
+            if (isNewName && renamed()) {
+                QFont font;
+                font.setBold(true);
+                return font;
+            }
+            break;
+    }
+    
+    return QVariant();
+}
+
+QVariant FileListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+    if (role == Qt::InitialSortOrderRole) {
+        return int(Qt::AscendingOrder);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    
+    switch (section) {
+        case OriginalNameColumn:
+            return tr("Original Name");
+        case NewNameColumn:
+            return tr("New Name");
+        case PathColumn:
+            return tr("File Path");
+    }
+    return QVariant();
+}
+
+void FileListModel::resetEntries()
+{
+    beginResetModel();
+    ++nameGeneration;
+    order.resize(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    visible.clear();
+    displayOrder = order;
+    endResetModel();
+}
+
+void FileListModel::appendEntries(int firstEntry)
+{
+    const int count = int(files.size()) - firstEntry;
+    if (count <= 0) {
+        return;
+    }
+    
+    // New entries are shown until the owner applies its filter again
+    const int firstRow = int(displayOrder.size());
+    beginInsertRows(QModelIndex(), firstRow, firstRow + count - 1);
+    ++nameGeneration;
+    order.reserve(files.size());
+    displayOrder.reserve(displayOrder.size() + count);
+    for (int i = firstEntry; i < files.size(); ++i) {
+        order.append(i);
+        displayOrder.append(i);
+    }
+    if (!visible.isEmpty()) {
+        visible.resize(files.size(), 1);
+    }
+    endInsertRows();
+}
+
+void FileListModel::setDisplayOrder(const QList<int> &newOrder)
+{
+    order = newOrder;
+    const QList<int> rows = visibleRows();
+    if (rows.size() != displayOrder.size()) {
+        beginResetModel();
+        displayOrder = rows;
+        endResetModel();
+        return;
+    }
+    
+    emit layoutAboutToBeChanged();
+    
+    // Move persistent indexes (selection, current row) along with their entries
+    QList<int> rowOfEntry(files.size(), -1);
+    for (int row = 0; row < rows.size(); ++row) {
+        rowOfEntry[rows[row]] = row;
+    }
+    
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for (const QModelIndex &oldIndex : oldIndexes) {
+        const int row = rowOfEntry.value(displayOrder.value(oldIndex.row(), -1), -1);
+        newIndexes.append(row >= 0 ? index(row, oldIndex.column()) : QModelIndex());
+    }
+    
+    displayOrder = rows;
+    changePersistentIndexList(oldIndexes, newIndexes);
+    
+    emit layoutChanged();
+}
+
+void FileListModel::setFilter(const QList<int> &entries)
+{
+    beginResetModel();
+    visible.fill(0, files.size());
+    for (int entry : entries) {
+        visible[entry] = 1;
+    }
+    displayOrder = visibleRows();
+    endResetModel();
+}
+
+void FileListModel::clearFilter()
+{
+    if (visible.isEmpty()) {
+        return;
+    }
+    beginResetModel();
+    visible.clear();
+    displayOrder = order;
+    endResetModel();
+}
+
+QList<int> FileListModel::visibleRows() const
+{
+    if (visible.isEmpty()) {
+        return order;
+    }
+    QList<int> rows;
+    for (int entry : order) {
+        if (visible.value(entry)) {
+            rows.append(entry);
+        }
+    }
+    return rows;
+}
+
+void FileListModel::namesChanged()
+{
+    ++nameGeneration;
+    if (displayOrder.isEmpty()) {
+        return;
+    }
+    emit dataChanged(index(0, 0), index(int(displayOrder.size()) - 1, ColumnCount - 1));
+}
@@ -0,0 +1,89 @@
+#ifndef FILELISTMODEL_H
+#define FILELISTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+
+class EntryStore;
+
+/**
+ * @brief Table model presenting the file entries owned by FileListWidget.
+ *
+ * The model does not copy entries. Rows are shown in display order, which is
+ * the numbering order, so the visible order always matches the tag indices.
+ */
+class FileListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        OriginalNameColumn,
+        NewNameColumn,
+        PathColumn,
+        ColumnCount
+    };
+
+    explicit FileListModel(const EntryStore &files, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Reset the model after entries were added or removed, showing them in added order.
+     */
+    void resetEntries();
+    
+    /**
+     * @brief Insert rows for the entries from firstEntry on, which were appended to the store.
+     *
+     * One row range insertion at the end; the rows keep the existing display order.
+     */
+    void appendEntries(int firstEntry);
+
+    /**
+     * @brief Reorder the rows; selection and current index follow their entries.
+     * @param order Entry indices in display order (must cover every entry once)
+     */
+    void setDisplayOrder(const QList<int> &order);
+
+    /**
+     * @brief Show only the given entries (still in display order).
+     * @param entries Matching entry indices, in any order
+     */
+    void setFilter(const QList<int> &entries);
+    
+    /**
+     * @brief Show all entries again.
+     */
+    void clearFilter();
+    
+    bool hasFilter() const { return !visible.isEmpty(); }
+
+    /**
+     * @brief Notify views that the new names (or the names in general) changed.
+     */
+    void namesChanged();
+
+    int entryIndex(int row) const { return displayOrder[row]; }
+    const EntryStore &store() const { return files; }
+    
+    /**
+     * @brief Counter that changes whenever names may have changed; keys cached per-row data.
+     */
+    quint64 generation() const { return nameGeneration; }
+
+private:
+    QList<int> visibleRows() const;
+    
+    const EntryStore &files;
+    QList<int> order;        // Display order of all entries
+    QList<char> visible;     // Entry -> shown; empty when no filter is set
+    QList<int> displayOrder; // Row -> entry index (order without filtered entries)
+    quint64 nameGeneration = 0;
+};
+
+#endif // FILELISTMODEL_H
@@ -1,5 +1,12 @@
 #include "filelistwidget.h"
+#include "filelistmodel.h"
 #include "operation.h"
+#include "session.h"
+#include "scanoptionsdialog.h"
+#include "namediffdelegate.h"
+#include "renamesimulator.h"
+#include "operationfactory.h"
+#include "filenamecodec.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QHeaderView>
@@ -17,17 +24,169 @@
 #include <QDropEvent>
 #include <QMimeData>
 #include <QUrl>
-#include <QDirIterator>
+#include <QSignalBlocker>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <numeric>
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+namespace {
+
+// Lists up to this size are previewed in one pass without a viewport-first step
+constexpr int ViewportFirstThreshold = 2000;
+
+// Paths per normalization and dedup job of uniqueNewPaths()
+constexpr qsizetype PathChunkSize = 8192;
+
+// Normalize a batch of paths (absolute, cleaned) and drop the ones already in the
+// list or repeated in the batch, keeping the first occurrence and the batch order.
+// The paths are partitioned by hash, so every worker checks one partition against
+// the store and its own set without locking.
+QStringList uniqueNewPaths(const QStringList &filePaths, const EntryStore &files)
+{
+    const qsizetype count = filePaths.size();
+    QStringList normalized(count);
+    QList<size_t> hashes(count);
+    QList<qsizetype> chunkStarts;
+    for (qsizetype begin = 0; begin < count; begin += PathChunkSize) {
+        chunkStarts.append(begin);
+    }
+    const QString currentPath = QDir::currentPath();
+    QtConcurrent::blockingMap(chunkStarts, [&](qsizetype begin) {
+        const qsizetype end = qMin(begin + PathChunkSize, count);
+        for (qsizetype i = begin; i < end; ++i) {
+            const QString &path = filePaths[i];
+            normalized[i] = QDir::cleanPath(QDir::isAbsolutePath(path)
+                                            ? path : currentPath + QLatin1Char('/') + path);
+            hashes[i] = qHash(normalized[i]);
+        }
+    });
+    
+    const int partitionCount = count < PathChunkSize ? 1 : qMax(QThread::idealThreadCount(), 1);
+    QList<QList<int>> partitions(partitionCount);
+    for (qsizetype i = 0; i < count; ++i) {
+        partitions[hashes[i] % partitionCount].append(int(i));
+    }
+    QList<char> keep(count, 0);
+    QtConcurrent::blockingMap(partitions, [&](const QList<int> &partition) {
+        QSet<QString> seen;
+        seen.reserve(partition.size());
+        for (int i : partition) {
+            const QString &path = normalized[i];
+            if (!seen.contains(path) && !files.contains(path)) {
+                seen.insert(path);
+                keep[i] = 1;
+            }
+        }
+    });
+    
+    QStringList unique;
+    unique.reserve(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        if (keep[i]) {
+            unique.append(normalized[i]);
+        }
+    }
+    return unique;
+}
+
+// Whether a new name keeps the file below its folder. '/' may move it into a subfolder,
+// but ".." segments must not resolve above the folder or to the folder itself.
+bool staysInFolder(const QString &directory, const QString &newPath)
+{
+    const QString target = QDir::cleanPath(newPath);
+    const QString prefix = directory.endsWith(u'/') ? directory : directory + u'/';
+    return target.size() > prefix.size() && target.startsWith(prefix);
+}
+
+} // namespace
+
+// Differences between a snapshot of the list and the disk, after the watcher lost events
+struct WatchRescan {
+    QStringList gone;                            // Listed, but no longer a regular file
+    QList<QPair<QString, FileMetadata>> changed; // Listed, with different metadata
+    QStringList found;                           // Below a watched folder, but not listed
+};
+
+namespace {
+
+WatchRescan rescanWatchedFolders(const EntryStore &files, const QStringList &roots,
+                                 const ScanOptions &options)
+{
+    WatchRescan result;
+    QStringList paths;
+    paths.reserve(files.size());
+    for (int i = 0; i < files.size(); ++i) {
+        paths.append(files.fullPath(i));
+    }
+    const QList<FileMetadata> current = FileMetadata::readAll(paths);
+    for (int i = 0; i < files.size(); ++i) {
+        const FileMetadata &before = files.metadata(i);
+        if (current[i].type != FileMetadata::RegularFile) {
+            result.gone.append(paths[i]);
+        } else if (current[i].size != before.size || current[i].modified != before.modified
+                   || current[i].inode != before.inode || current[i].device != before.device) {
+            result.changed.append({paths[i], current[i]});
+        }
+    }
+    
+    const DirectoryScanner scanner(options);
+    for (const QString &root : roots) {
+        for (const QString &path : scanner.scan(root)) {
+            if (!files.contains(path)) {
+                result.found.append(path);
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
 
 FileListWidget::FileListWidget(QWidget *parent)
     : QWidget(parent)
 {
+    model = new FileListModel(files, this);
     setupUI();
     
+    // Initialize the watcher for async numbering order computation
+    orderingWatcher = new QFutureWatcher<Numbering>(this);
+    connect(orderingWatcher, &QFutureWatcher<Numbering>::finished,
+            this, &FileListWidget::onOrderingReady);
+    
+    revalidationWatcher = new QFutureWatcher<QStringList>(this);
+    connect(revalidationWatcher, &QFutureWatcher<QStringList>::finished,
+            this, &FileListWidget::onRevalidationReady);
+    
+    rescanWatcher = new QFutureWatcher<WatchRescan>(this);
+    connect(rescanWatcher, &QFutureWatcher<WatchRescan>::finished,
+            this, &FileListWidget::onRescanReady);
+    
     // Initialize the watcher for async preview generation
-    previewWatcher = new QFutureWatcher<QString>(this);
-    connect(previewWatcher, &QFutureWatcher<QString>::finished,
+    previewWatcher = new QFutureWatcher<PreviewChunk>(this);
+    connect(previewWatcher, &QFutureWatcher<PreviewChunk>::finished,
             this, &FileListWidget::onPreviewsReady);
+    
+    // Rows outside the viewport are finished at lower priority than the GUI
+    previewPool = new QThreadPool(this);
+    previewPool->setThreadPriority(QThread::LowPriority);
+    
+    // Content hashes are computed in the background; rows stay pending until ready
+    contentHasher = new ContentHasher(this);
+    connect(contentHasher, &ContentHasher::hashesReady,
+            this, &FileListWidget::onHashesReady);
+    
+    hashRefreshTimer = new QTimer(this);
+    hashRefreshTimer->setSingleShot(true);
+    hashRefreshTimer->setInterval(250);
+    connect(hashRefreshTimer, &QTimer::timeout, this, &FileListWidget::applyReceivedHashes);
+    
+    // Optional notifications about external changes to the listed files
+    directoryWatcher = new DirectoryWatcher(this);
+    connect(directoryWatcher, &DirectoryWatcher::changesReady,
+            this, &FileListWidget::onDirectoryChanges);
 }
 
 void FileListWidget::setupUI()
@@ -43,14 +202,50 @@ void FileListWidget::setupUI()
     titleLabel->setFont(titleFont);
     mainLayout->addWidget(titleLabel);
     
-    // Tree widget
-    treeWidget = new QTreeWidget(this);
-    treeWidget->setColumnCount(3);
-    treeWidget->setHeaderLabels({tr("Original Name"), tr("New Name"), tr("File Path")});
-    treeWidget->setAlternatingRowColors(true);
-    treeWidget->setSortingEnabled(true);  // Enable sorting
-    treeWidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    treeWidget->setContextMenuPolicy(Qt::CustomContextMenu);
+    // Filter bar: substring search in one column plus a status condition
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    filterLayout->setContentsMargins(0, 0, 0, 0);
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter..."));
+    filterEdit->setClearButtonEnabled(true);
+    filterFieldCombo = new QComboBox(this);
+    filterFieldCombo->addItem(tr("Original Name"), int(FileFilter::OriginalName));
+    filterFieldCombo->addItem(tr("New Name"), int(FileFilter::NewName));
+    filterFieldCombo->addItem(tr("Path"), int(FileFilter::Path));
+    filterStatusCombo = new QComboBox(this);
+    filterStatusCombo->addItem(tr("All Files"), int(FileFilter::AllFiles));
+    filterStatusCombo->addItem(tr("Changed Only"), int(FileFilter::ChangedOnly));
+    filterStatusCombo->addItem(tr("Conflicts Only"), int(FileFilter::ConflictsOnly));
+    filterStatusCombo->addItem(tr("Not in Mapping"), int(FileFilter::UnmatchedOnly));
+    filterStatusCombo->addItem(tr("Over Pattern Limits"), int(FileFilter::LimitExceededOnly));
+    connect(filterEdit, &QLineEdit::textChanged, this, &FileListWidget::applyFilter);
+    connect(filterFieldCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &FileListWidget::applyFilter);
+    connect(filterStatusCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &FileListWidget::applyFilter);
+    filterLayout->addWidget(filterEdit, 1);
+    filterLayout->addWidget(filterFieldCombo);
+    filterLayout->addWidget(filterStatusCombo);
+    mainLayout->addLayout(filterLayout);
+    
+    // File list view, rows are shown in numbering order
+    treeView = new QTreeView(this);
+    treeView->setModel(model);
+    treeView->setRootIsDecorated(false);
+    treeView->setUniformRowHeights(true);  // Allows fast layout of large lists
+    treeView->setAlternatingRowColors(true);
+    treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    treeView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+    
+    // Changed parts of new names are highlighted while painting, for visible rows only
+    treeView->setItemDelegateForColumn(FileListModel::NewNameColumn, new NameDiffDelegate(treeView));
+    
+    // Clicking a header changes the numbering order, so the displayed order
+    // and the numbering order never diverge
+    treeView->header()->setSectionsClickable(true);
+    treeView->header()->setSortIndicatorShown(true);
+    updateSortIndicator();
     
     // Enable drag and drop
     setAcceptDrops(true);
@@ -58,22 +253,24 @@ void FileListWidget::setupUI()
     // Set column widths
     // Use Interactive mode to allow manual column resizing by the user
     // The last section will stretch to fill available space
-    treeWidget->header()->setStretchLastSection(true);
-    treeWidget->header()->setSectionResizeMode(0, QHeaderView::Interactive);
-    treeWidget->header()->setSectionResizeMode(1, QHeaderView::Interactive);
-    treeWidget->header()->setSectionResizeMode(2, QHeaderView::Stretch);
+    treeView->header()->setStretchLastSection(true);
+    treeView->header()->setSectionResizeMode(0, QHeaderView::Interactive);
+    treeView->header()->setSectionResizeMode(1, QHeaderView::Interactive);
+    treeView->header()->setSectionResizeMode(2, QHeaderView::Stretch);
     
     // Set reasonable initial column widths
-    treeWidget->setColumnWidth(0, 200);  // Original Name column
-    treeWidget->setColumnWidth(1, 200);  // New Name column
+    treeView->setColumnWidth(0, 200);  // Original Name column
+    treeView->setColumnWidth(1, 200);  // New Name column
     // Column 2 (File Path) will stretch to fill remaining space
     
-    connect(treeWidget, &QTreeWidget::itemSelectionChanged,
+    connect(treeView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &FileListWidget::onItemSelectionChanged);
-    connect(treeWidget, &QTreeWidget::customContextMenuRequested,
+    connect(treeView, &QTreeView::customContextMenuRequested,
             this, &FileListWidget::showContextMenu);
+    connect(treeView->header(), &QHeaderView::sectionClicked,
+            this, &FileListWidget::onHeaderClicked);
     
-    mainLayout->addWidget(treeWidget, 1);
+    mainLayout->addWidget(treeView, 1);
     
     // Bottom bar with file count and rename button
     QHBoxLayout *bottomLayout = new QHBoxLayout();
@@ -83,6 +280,35 @@ void FileListWidget::setupUI()
     fileCountLabel = new QLabel(this);
     updateFileCountLabel();
     bottomLayout->addWidget(fileCountLabel);
+    bottomLayout->addSpacing(12);
+    
+    // Numbering order selector
+    QLabel *numberingOrderLabel = new QLabel(tr("Number by:"), this);
+    numberingOrderCombo = new QComboBox(this);
+    numberingOrderCombo->addItem(tr("Added Order"), int(NumberingOrder::Added));
+    numberingOrderCombo->addItem(tr("Name"), int(NumberingOrder::Name));
+    numberingOrderCombo->addItem(tr("Path"), int(NumberingOrder::Path));
+    numberingOrderCombo->addItem(tr("Date Modified"), int(NumberingOrder::Modified));
+    numberingOrderCombo->addItem(tr("Size"), int(NumberingOrder::Size));
+    connect(numberingOrderCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &FileListWidget::onNumberingOrderChanged);
+    bottomLayout->addWidget(numberingOrderLabel);
+    bottomLayout->addWidget(numberingOrderCombo);
+    bottomLayout->addSpacing(12);
+    
+    // Watching for external changes is opt-in (uses inotify watches)
+    watchCheckBox = new QCheckBox(tr("Watch folders"), this);
+    watchCheckBox->setToolTip(tr("Update the list when files are deleted, renamed or added "
+                                 "by other programs"));
+    watchCheckBox->setVisible(DirectoryWatcher::isSupported());
+    connect(watchCheckBox, &QCheckBox::toggled, this, &FileListWidget::onWatchToggled);
+    bottomLayout->addWidget(watchCheckBox);
+    
+    // Include/exclude rules for dropped folders
+    scanOptionsButton = new QPushButton(tr("Folder Options..."), this);
+    scanOptionsButton->setToolTip(tr("Choose which files are taken from dropped folders"));
+    connect(scanOptionsButton, &QPushButton::clicked, this, &FileListWidget::showScanOptions);
+    bottomLayout->addWidget(scanOptionsButton);
     
     // Add stretch to push button to the right
     bottomLayout->addStretch();
@@ -98,134 +324,516 @@ void FileListWidget::setupUI()
 
 void FileListWidget::addFiles(const QStringList &filePaths)
 {
-    // Disable updates during batch addition to improve performance
-    treeWidget->setUpdatesEnabled(false);
+    const int firstEntry = files.size();
+    if (appendEntries(filePaths) == 0) {
+        return;
+    }
+    
+    // One row range insertion for the whole batch
+    entriesAppended(firstEntry);
+    emit filesChanged();
+}
+
+int FileListWidget::appendEntries(const QStringList &filePaths)
+{
+    const int firstEntry = files.size();
     
-    // Reserve space in the files list if we know the approximate size
-    files.reserve(files.size() + filePaths.size());
+    // Parallel duplicate check against the store's path index, before anything is stat'ed
+    const QStringList candidates = uniqueNewPaths(filePaths, files);
     
-    for (const QString &filePath : filePaths) {
-        QFileInfo fileInfo(filePath);
-        if (!fileInfo.exists() || !fileInfo.isFile()) {
-            continue;
-        }
-        
-        // Fast duplicate check using QSet (O(1) instead of O(n))
-        if (filePathsSet.contains(filePath)) {
-            continue;
+    // One batched stat pass validates the paths and yields the metadata kept on the entries
+    const QList<FileMetadata> metadata = FileMetadata::readAll(candidates);
+    QStringList accepted;
+    QList<FileMetadata> acceptedMetadata;
+    accepted.reserve(candidates.size());
+    acceptedMetadata.reserve(candidates.size());
+    for (qsizetype k = 0; k < candidates.size(); ++k) {
+        if (metadata[k].type == FileMetadata::RegularFile) {
+            accepted.append(candidates[k]);
+            acceptedMetadata.append(metadata[k]);
         }
-        
-        FileEntry entry;
-        entry.fullPath = filePath;
-        entry.directory = fileInfo.absolutePath();
-        entry.originalName = fileInfo.fileName();
-        entry.newName = fileInfo.fileName();
-        
-        QTreeWidgetItem *item = new QTreeWidgetItem(treeWidget);
-        item->setText(0, entry.originalName);
-        item->setText(1, entry.newName);
-        item->setText(2, entry.directory);
-        entry.item = item;
-        
-        files.append(entry);
-        filePathsSet.insert(filePath);
     }
     
-    // Re-enable updates and trigger a single repaint
-    treeWidget->setUpdatesEnabled(true);
+    files.appendPaths(accepted, acceptedMetadata);
+    files.trimToBudget();
     
-    updateFileCountLabel();
-    emit filesChanged();
+    if (watchCheckBox->isChecked()) {
+        watchEntryDirectories(firstEntry);
+    }
+    return files.size() - firstEntry;
 }
 
 void FileListWidget::clearFiles()
 {
-    treeWidget->clear();
     files.clear();
-    filePathsSet.clear();
-    updateFileCountLabel();
+    watchedRoots.clear();
+    directoryWatcher->clear();
+    contentHasher->cancelAll();
+    receivedHashes.clear();
+    entriesChanged();
     emit filesChanged();
 }
 
-void FileListWidget::updatePreviews(const QList<std::shared_ptr<Operation>> &operations)
+void FileListWidget::exportSession(SessionData &data) const
+{
+    data.files = files;
+    data.stamps.clear();
+    data.watchedRoots = QStringList(watchedRoots.cbegin(), watchedRoots.cend());
+    data.numberingOrder = numberingOrder;
+    data.numberingDirection = numberingDirection;
+}
+
+void FileListWidget::importSession(SessionData &data)
+{
+    contentHasher->cancelAll();
+    receivedHashes.clear();
+    
+    // The session was loaded with this list's budget (see MainWindow::openSession())
+    files = std::move(data.files);
+    files.trimToBudget();
+    
+    watchedRoots = QSet<QString>(data.watchedRoots.cbegin(), data.watchedRoots.cend());
+    if (watchCheckBox->isChecked()) {
+        onWatchToggled(true);
+    }
+    
+    numberingOrder = data.numberingOrder;
+    numberingDirection = data.numberingDirection;
+    {
+        QSignalBlocker blocker(numberingOrderCombo);
+        numberingOrderCombo->setCurrentIndex(numberingOrderCombo->findData(int(numberingOrder)));
+    }
+    updateSortIndicator();
+    
+    entriesChanged();
+    emit filesChanged();
+    
+    // The snapshot was not checked against the disk; do that in the background
+    revalidationWatcher->setFuture(QtConcurrent::run(&Session::findStale, files, data.stamps));
+}
+
+void FileListWidget::setMemoryBudget(qint64 bytes, const QString &spillDirectory)
+{
+    if (!spillDirectory.isEmpty()) {
+        files.setSpillDirectory(spillDirectory);
+    }
+    files.setMemoryBudget(bytes);
+}
+
+void FileListWidget::onRevalidationReady()
 {
-    // Cancel any pending preview computation
-    if (previewWatcher->isRunning()) {
-        previewWatcher->cancel();
-        previewWatcher->waitForFinished();
+    const QStringList stalePaths = revalidationWatcher->result();
+    if (stalePaths.isEmpty()) {
+        return;
+    }
+    
+    // Match by path, the list may have changed while the check was running
+    for (const QString &path : stalePaths) {
+        const qsizetype i = files.indexOf(path);
+        if (i >= 0) {
+            files.setStale(i, true);
+        }
     }
+    model->namesChanged();
+}
+
+void FileListWidget::updatePreviews(const QList<std::shared_ptr<Operation>> &operations)
+{
+    currentOperations = operations;
+    previewEntries.clear();
+    previewTimer.start();
+    
+    // Cancel any pending preview computation without waiting for it
+    cancelPreviews();
     
     // If no files, nothing to do
     if (files.isEmpty()) {
         return;
     }
     
-    // Create a lambda that captures operations and applies them to a filename
-    // Note: We capture 'operations' by value to ensure it remains valid
-    // We don't capture 'this' as applyOperations is now static and thread-safe
-    auto applyOpsFunc = [operations](const QString &fileName) -> QString {
-        // Extract the file index from a specially formatted string
-        // Format: "index|filename"
-        int sepIndex = fileName.indexOf('|');
-        if (sepIndex >= 0) {
-            int fileIndex = fileName.left(sepIndex).toInt();
-            QString actualFileName = fileName.mid(sepIndex + 1);
-            return FileListWidget::applyOperations(actualFileName, operations, fileIndex);
+    // Collect the content hash algorithms referenced by <hash:...> tags
+    requiredHashes.clear();
+    bool usesScopedCounters = false;
+    for (const auto &op : operations) {
+        if (op) {
+            for (const QString &algorithm : op->requiredHashes()) {
+                if (!requiredHashes.contains(algorithm)) {
+                    requiredHashes.append(algorithm);
+                }
+            }
+            usesScopedCounters = usesScopedCounters || op->usesScopedCounters();
+        }
+    }
+    
+    // Numbers follow the display order. Per-directory/extension counters only cost
+    // anything when a tag uses them; they are computed along the order in the
+    // background and cached until the entries or the order change. onOrderingReady()
+    // calls back once both are known.
+    if (usesScopedCounters && !scopedNumberingValid && !orderingPending) {
+        startScopedNumbering();
+    }
+    if (orderingPending) {
+        return;
+    }
+    
+    // Files with missing hashes are queued for hashing and marked pending instead
+    // of blocking the preview
+    if (!requiredHashes.isEmpty()) {
+        for (int i = 0; i < files.size(); ++i) {
+            for (const QString &algorithm : std::as_const(requiredHashes)) {
+                if (!files.contentHashes(i).contains(algorithm)) {
+                    contentHasher->request(files.fullPath(i), algorithm);
+                }
+            }
         }
-        return FileListWidget::applyOperations(fileName, operations, 0);
-    };
+    }
     
-    // Extract original filenames for parallel processing, prepending the index
-    QList<QString> originalNames;
-    originalNames.reserve(files.size());
-    for (int i = 0; i < files.size(); ++i) {
-        originalNames.append(QString("%1|%2").arg(i).arg(files[i].originalName));
+    auto input = newPreviewInput();
+    input->numberingIndex = numberingIndex;
+    input->usesScopedCounters = usesScopedCounters;
+    if (usesScopedCounters) {
+        input->scopedNumbering = scopedNumbering;
+    }
+    input->requiredHashes = requiredHashes;
+    input->operations = operations;
+    
+    // Large lists show the visible rows right away; everything else follows in the background
+    if (files.size() > ViewportFirstThreshold) {
+        int firstRow = treeView->indexAt(QPoint(0, 0)).row();
+        int lastRow = treeView->indexAt(QPoint(0, treeView->viewport()->height() - 1)).row();
+        if (firstRow >= 0) {
+            if (lastRow < 0) {
+                lastRow = model->rowCount() - 1;
+            }
+            QList<int> visibleEntries;
+            for (int row = firstRow; row <= lastRow; ++row) {
+                visibleEntries.append(model->entryIndex(row));
+            }
+            input->files = files;
+            installPreview(computePreview(*input, -1, visibleEntries), visibleEntries);
+            model->namesChanged();
+        }
     }
     
-    // Start parallel computation of new names
-    QFuture<QString> future = QtConcurrent::mapped(originalNames, applyOpsFunc);
-    previewWatcher->setFuture(future);
+    // Each worker turns one chunk of the snapshot into a chunk of new names, which
+    // goes straight to the spill file when the list does not fit the memory budget
+    input->files = files;
+    QList<int> chunks(files.newNameColumn().chunkCount());
+    std::iota(chunks.begin(), chunks.end(), 0);
+    previewWatcher->setFuture(QtConcurrent::mapped(previewPool, chunks, [input](int chunk) {
+        return FileListWidget::computePreview(*input, chunk, QList<int>());
+    }));
 }
 
-int FileListWidget::applyRename(QStringList &errors)
+void FileListWidget::updateEntryPreviews(const QList<int> &entryIndices)
 {
-    int successCount = 0;
-    errors.clear();
+    // Only used while no full update is running and no counters are involved, so
+    // the other entries keep valid previews
+    previewEntries = entryIndices;
+    previewTimer.start();
+    if (entryIndices.isEmpty()) {
+        model->namesChanged();
+        return;
+    }
     
-    for (int i = 0; i < files.size(); ++i) {
-        if (files[i].newName == files[i].originalName) {
-            continue; // No change, skip
+    for (int i : entryIndices) {
+        for (const QString &algorithm : std::as_const(requiredHashes)) {
+            if (!files.contentHashes(i).contains(algorithm)) {
+                contentHasher->request(files.fullPath(i), algorithm);
+            }
+        }
+    }
+    
+    auto input = newPreviewInput();
+    input->files = files;
+    input->numberingIndex = numberingIndex;
+    input->requiredHashes = requiredHashes;
+    input->operations = currentOperations;
+    previewWatcher->setFuture(QtConcurrent::run(previewPool, [input, entryIndices]() {
+        return FileListWidget::computePreview(*input, -1, entryIndices);
+    }));
+}
+
+void FileListWidget::cancelPreviews()
+{
+    // Running chunks notice the flag within a few hundred names and return early; the
+    // results of this run, should any still arrive, no longer match the generation
+    if (previewCancelled) {
+        previewCancelled->store(true, std::memory_order_relaxed);
+    }
+    previewWatcher->cancel();
+    ++previewGeneration;
+}
+
+std::shared_ptr<PreviewInput> FileListWidget::newPreviewInput()
+{
+    auto input = std::make_shared<PreviewInput>();
+    input->generation = previewGeneration;
+    input->cancelled = std::make_shared<std::atomic<bool>>(false);
+    previewCancelled = input->cancelled;
+    return input;
+}
+
+PreviewChunk FileListWidget::computePreview(const PreviewInput &input, int chunk,
+                                            const QList<int> &entryIndices)
+{
+    // A chunk of a full update, or the listed entries of a partial one
+    const qsizetype first = qsizetype(qMax(chunk, 0)) * StringColumn::ChunkSize;
+    const int count = chunk >= 0 ? int(qMin<qsizetype>(StringColumn::ChunkSize, input.files.size() - first))
+                                 : int(entryIndices.size());
+    const StringColumn &originalNames = input.files.originalNameColumn();
+    
+    // Rename from Mapping operations are joined against every entry to find the
+    // files the mapping misses
+    QList<const MappingFileOperation *> mappings;
+    for (const auto &op : input.operations) {
+        if (op && op->getType() == OperationType::MappingFile) {
+            mappings.append(static_cast<const MappingFileOperation *>(op.get()));
+        }
+    }
+    
+    PreviewChunk result;
+    result.generation = input.generation;
+    result.chunk = chunk;
+    result.states.resize(count);
+    if (!mappings.isEmpty()) {
+        result.unmatched.resize(count);
+    }
+    StringChunkBuilder names;
+    for (int k = 0; k < count; ++k) {
+        // A superseded run stops early; its results are dropped by generation
+        if (k % 256 == 0 && input.cancelled && input.cancelled->load(std::memory_order_relaxed)) {
+            result.names = names.finish();
+            return result;
         }
         
-        QString oldPath = files[i].fullPath;
-        QString newPath = files[i].directory + QDir::separator() + files[i].newName;
+        const int i = chunk >= 0 ? int(first + k) : entryIndices[k];
+        const QHash<QString, QString> &contentHashes = input.files.contentHashes(i);
         
-        // Check if target file already exists
-        if (QFile::exists(newPath)) {
-            errors.append(tr("Cannot rename '%1': target file '%2' already exists")
-                         .arg(files[i].originalName)
-                         .arg(files[i].newName));
+        // Rows waiting for a hash, or whose file could not be read (an empty digest),
+        // keep their original name so they are never renamed
+        EntryStore::PreviewState state = EntryStore::PreviewReady;
+        for (const QString &algorithm : input.requiredHashes) {
+            const auto it = contentHashes.constFind(algorithm);
+            if (it == contentHashes.constEnd()) {
+                state = state == EntryStore::PreviewReady ? EntryStore::PreviewPending : state;
+            } else if (it->isEmpty()) {
+                state = EntryStore::PreviewUnreadable;
+            }
+        }
+        result.states[k] = char(state);
+        if (state != EntryStore::PreviewReady) {
+            names.append(originalNames.at(i));
             continue;
         }
         
-        // Try to rename
-        QFile file(oldPath);
-        if (file.rename(newPath)) {
-            files[i].fullPath = newPath;
-            files[i].originalName = files[i].newName;
-            files[i].item->setText(0, files[i].newName);
-            files[i].item->setForeground(1, QBrush(Qt::black));
-            QFont font = files[i].item->font(1);
-            font.setBold(false);
-            files[i].item->setFont(1, font);
-            successCount++;
+        TagContext context;
+        context.fileIndex = input.numberingIndex.value(i, i);
+        if (input.usesScopedCounters) {
+            context.directoryIndex = input.scopedNumbering.directoryIndex[i];
+            context.extensionIndex = input.scopedNumbering.extensionIndex[i];
+            context.directoryExtensionIndex = input.scopedNumbering.directoryExtensionIndex[i];
+        }
+        context.contentHashes = contentHashes;
+        const FileMetadata &metadata = input.files.metadata(i);
+        if (metadata.isValid()) {
+            context.modified = metadata.modified;
+        }
+        const QString originalName = originalNames.at(i).toString();
+        context.originalName = originalName;
+        context.directory = input.files.directory(i);
+        for (const MappingFileOperation *mapping : std::as_const(mappings)) {
+            if (!mapping->contains(originalName, context)) {
+                result.unmatched[k] = 1;
+            }
+        }
+        
+        // Rows on which a pattern gave up keep their original name, like pending ones,
+        // so a name built from the other operations alone is never renamed to
+        bool limitExceeded = false;
+        const QString newName = applyOperations(originalName, input.operations, context, &limitExceeded);
+        if (limitExceeded) {
+            if (result.limitExceeded.isEmpty()) {
+                result.limitExceeded.resize(count);
+            }
+            result.limitExceeded[k] = 1;
+            names.append(originalName);
+        } else if (!staysInFolder(context.directory, context.directory + u'/' + newName)) {
+            // Names like "../x" would move the file out of the list's folders; such
+            // rows keep their name too
+            if (result.outsideFolder.isEmpty()) {
+                result.outsideFolder.resize(count);
+            }
+            result.outsideFolder[k] = 1;
+            names.append(originalName);
         } else {
-            errors.append(tr("Failed to rename '%1': %2")
-                         .arg(files[i].originalName)
-                         .arg(file.errorString()));
+            names.append(newName);
+        }
+    }
+    result.names = input.files.place(names.finish());
+    return result;
+}
+
+void FileListWidget::installPreview(const PreviewChunk &preview, const QList<int> &entryIndices)
+{
+    QStringList newNames;
+    newNames.reserve(entryIndices.size());
+    for (int k = 0; k < entryIndices.size(); ++k) {
+        newNames.append(preview.names->at(k).toString());
+        files.setPreviewState(entryIndices[k], EntryStore::PreviewState(preview.states[k]));
+        files.setUnmatched(entryIndices[k], !preview.unmatched.isEmpty() && preview.unmatched[k]);
+        files.setExceedsLimits(entryIndices[k], !preview.limitExceeded.isEmpty() && preview.limitExceeded[k]);
+        files.setLeavesFolder(entryIndices[k], !preview.outsideFolder.isEmpty() && preview.outsideFolder[k]);
+    }
+    files.setNewNames(entryIndices, newNames);
+}
+
+QList<RenameTask> FileListWidget::renameTasks(QList<int> *entries) const
+{
+    // New names containing '/' move the file into that (possibly new) subfolder;
+    // targets outside the folder are never renamed to, whatever set the new name
+    QList<RenameTask> tasks;
+    const StringColumn &originalNames = files.originalNameColumn();
+    const StringColumn &newNames = files.newNameColumn();
+    for (int i = 0; i < files.size(); ++i) {
+        if (newNames.at(i) == originalNames.at(i)) {
+            continue; // No change, skip
+        }
+        const QString newPath = files.newPath(i);
+        if (!staysInFolder(files.directory(i), newPath)) {
+            continue;
+        }
+        tasks.append({files.fullPath(i), QDir::cleanPath(newPath)});
+        if (entries) {
+            entries->append(i);
+        }
+    }
+    return tasks;
+}
+
+QString FileListWidget::dryRun(QString *details) const
+{
+    const QList<RenameTask> tasks = renameTasks();
+    if (tasks.isEmpty()) {
+        return tr("No file would be renamed.");
+    }
+    const DryRunReport report = RenameSimulator::simulate(tasks);
+    if (details) {
+        *details = report.details(tasks);
+    }
+    return report.summary();
+}
+
+int FileListWidget::applyRename(QStringList &errors)
+{
+    int successCount = 0;
+    errors.clear();
+    
+    // Collect the whole batch first; the executor orders renames that depend on
+    // each other and runs the rest in parallel
+    QList<int> taskEntries;
+    const QList<RenameTask> tasks = renameTasks(&taskEntries);
+    QStringList taskNames;
+    for (int i : std::as_const(taskEntries)) {
+        taskNames.append(files.newName(i));
+    }
+    if (tasks.isEmpty()) {
+        return 0;
+    }
+    
+    // Run the batch off the GUI thread so large batches and copies across file systems
+    // can show progress; the window stays modal meanwhile. The watcher holds its events
+    // until the entries have been updated from the results below.
+    std::atomic<int> completed{0};
+    QFutureWatcher<QList<int>> renameWatcher;
+    QProgressDialog progress(tr("Renaming files..."), QString(), 0, int(tasks.size()), this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    QTimer progressTimer;
+    connect(&progressTimer, &QTimer::timeout, &progress, [&progress, &completed]() {
+        progress.setValue(completed.load(std::memory_order_relaxed));
+    });
+    QEventLoop loop;
+    connect(&renameWatcher, &QFutureWatcher<QList<int>>::finished, &loop, &QEventLoop::quit);
+    
+    directoryWatcher->hold();
+    renameWatcher.setFuture(QtConcurrent::run([&tasks, &completed]() {
+        RenameExecutor executor;
+        return executor.run(tasks, &completed);
+    }));
+    progressTimer.start(50);
+    if (!renameWatcher.isFinished()) {
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+    progressTimer.stop();
+    const QList<int> results = renameWatcher.result();
+    progress.setValue(int(tasks.size()));
+    
+    // Renamed entries are updated in one batch, so each name chunk is rebuilt once
+    QList<int> renamedEntries;
+    QStringList renamedDirectories;
+    QStringList renamedNames;
+    QSet<QString> renamedSources;
+    QSet<QString> renamedTargets;
+    for (int k = 0; k < tasks.size(); ++k) {
+        const int i = taskEntries[k];
+        switch (results[k]) {
+            case 0: {
+                const QFileInfo target(tasks[k].target);
+                renamedSources.insert(tasks[k].source);
+                renamedTargets.insert(tasks[k].target);
+                renamedEntries.append(i);
+                renamedDirectories.append(target.absolutePath());
+                renamedNames.append(target.fileName());
+                successCount++;
+                break;
+            }
+            case EEXIST:
+            case ECANCELED: // The file at the target could not be renamed away first
+                errors.append(tr("Cannot rename '%1': target file '%2' already exists")
+                             .arg(files.originalName(i))
+                             .arg(taskNames[k]));
+                break;
+            default:
+                errors.append(tr("Failed to rename '%1': %2")
+                             .arg(files.originalName(i))
+                             .arg(RenameExecutor::errorString(results[k])));
+                break;
         }
     }
+    files.setLocations(renamedEntries, renamedDirectories, renamedNames);
+    files.setNewNames(renamedEntries, renamedNames);
+    files.trimToBudget();
     
+    // Extensions and folders may have changed, which regroups per-extension and
+    // per-directory counters
+    scopedNumberingValid = false;
+    ++scopedNumberingGeneration;
+    fileFilter.invalidate();
+    model->namesChanged();
+    if (model->hasFilter()) {
+        applyFilter();
+    }
+    
+    // Changes other programs made during the batch are applied now. The batch's own
+    // renames (or their copy and delete) are left out by path; the entries already
+    // carry their new locations.
+    DirectoryChanges external = directoryWatcher->release();
+    external.changes.removeIf([&](const DirectoryChange &change) {
+        switch (change.kind) {
+            case DirectoryChange::FileRenamed:
+                return renamedSources.contains(change.path) && renamedTargets.contains(change.newPath);
+            case DirectoryChange::FileRemoved:
+                return renamedSources.contains(change.path);
+            case DirectoryChange::FileAdded:
+                return renamedTargets.contains(change.path);
+            default:
+                return false;
+        }
+    });
+    if (!external.isEmpty()) {
+        onDirectoryChanges(external);
+    }
     return successCount;
 }
 
@@ -236,65 +844,578 @@ void FileListWidget::onItemSelectionChanged()
 
 void FileListWidget::onPreviewsReady()
 {
-    // Get results from the parallel computation
-    QList<QString> results = previewWatcher->future().results();
-    
-    // Validate that the number of results matches the number of files
-    // If they don't match, files may have been added/removed during computation
-    // In this case, we skip the update as it would be inconsistent
-    if (results.size() != files.size()) {
-        qWarning() << "Preview results size mismatch: expected" << files.size() 
-                   << "but got" << results.size() << "- skipping update";
+    // Get results from the parallel computation; a superseded run is dropped whole,
+    // it may have stopped part way
+    if (previewWatcher->isCanceled()) {
         return;
     }
+    const QList<PreviewChunk> results = previewWatcher->future().results();
+    for (const PreviewChunk &preview : results) {
+        if (preview.generation != previewGeneration) {
+            return;
+        }
+    }
     
-    // Disable updates during batch update to improve performance
-    treeWidget->setUpdatesEnabled(false);
+    // Validate that the results match the files; if files were added or removed during
+    // the computation, the update would be inconsistent and is skipped
+    const int expected = previewEntries.isEmpty() ? files.newNameColumn().chunkCount() : 1;
+    bool consistent = results.size() == expected;
+    for (qsizetype k = 0; consistent && k < results.size(); ++k) {
+        const qsizetype first = qsizetype(k) * StringColumn::ChunkSize;
+        const qsizetype size = previewEntries.isEmpty()
+            ? qMin<qsizetype>(StringColumn::ChunkSize, files.size() - first) : previewEntries.size();
+        consistent = results[k].names->size() == size;
+    }
+    if (!consistent) {
+        qWarning() << "Preview results do not match the file list - skipping update";
+        return;
+    }
     
-    // Update UI with the computed new names (this runs in the main thread)
-    for (int i = 0; i < files.size(); ++i) {
-        QString newName = results[i];
-        files[i].newName = newName;
-        files[i].item->setText(1, newName);
-        
-        // Highlight changes
-        if (newName != files[i].originalName) {
-            files[i].item->setForeground(1, QBrush(Qt::darkGreen));
-            QFont font = files[i].item->font(1);
-            font.setBold(true);
-            files[i].item->setFont(1, font);
-        } else {
-            files[i].item->setForeground(1, QBrush(Qt::black));
-            QFont font = files[i].item->font(1);
-            font.setBold(false);
-            files[i].item->setFont(1, font);
+    // Store the computed new names (this runs in the main thread); chunks of a full
+    // update replace the new names of their entries as a whole
+    int count = 0;
+    for (const PreviewChunk &preview : results) {
+        count += preview.names->size();
+        if (preview.chunk < 0) {
+            installPreview(preview, previewEntries);
+            continue;
+        }
+        files.setNewNameChunk(preview.chunk, preview.names);
+        const int first = preview.chunk * StringColumn::ChunkSize;
+        for (int k = 0; k < preview.names->size(); ++k) {
+            files.setPreviewState(first + k, EntryStore::PreviewState(preview.states[k]));
+            files.setUnmatched(first + k, !preview.unmatched.isEmpty() && preview.unmatched[k]);
+            files.setExceedsLimits(first + k, !preview.limitExceeded.isEmpty() && preview.limitExceeded[k]);
+            files.setLeavesFolder(first + k, !preview.outsideFolder.isEmpty() && preview.outsideFolder[k]);
         }
     }
+    files.trimToBudget();
+    
+    emit previewCostMeasured(previewTimer.nsecsElapsed(), count);
+    
+    // Single repaint of the visible rows; filters on new names or status are rerun
+    fileFilter.invalidateNewNames();
+    model->namesChanged();
+    if (model->hasFilter()) {
+        applyFilter();
+    } else {
+        updateFileCountLabel();
+    }
+}
+
+void FileListWidget::onOrderingReady()
+{
+    // A synchronous reordering may have superseded this result
+    if (!orderingPending) {
+        return;
+    }
+    
+    const Numbering numbering = orderingWatcher->result();
+    if (reorderPending && numbering.order.size() != files.size()) {
+        return;
+    }
+    
+    // Scoped numbers are only current if nothing regrouped the entries meanwhile
+    const bool scopedCurrent = numbering.scoped.directoryIndex.size() == files.size()
+        && scopedJobGeneration == scopedNumberingGeneration;
+    
+    orderingPending = false;
+    if (reorderPending) {
+        reorderPending = false;
+        applyOrdering(numbering.order);
+    }
+    if (scopedCurrent) {
+        scopedNumbering = numbering.scoped;
+        scopedNumberingValid = true;
+    }
+    updatePreviews(currentOperations);
+}
+
+void FileListWidget::onNumberingOrderChanged(int index)
+{
+    numberingOrder = NumberingOrder(numberingOrderCombo->itemData(index).toInt());
+    numberingDirection = Qt::AscendingOrder;
+    updateSortIndicator();
+    
+    startOrdering();
+    updatePreviews(currentOperations);
+}
+
+void FileListWidget::onHeaderClicked(int section)
+{
+    NumberingOrder order;
+    if (section == FileListModel::OriginalNameColumn) {
+        order = NumberingOrder::Name;
+    } else if (section == FileListModel::PathColumn) {
+        order = NumberingOrder::Path;
+    } else {
+        // New names depend on the numbering, so they cannot define it
+        updateSortIndicator();
+        return;
+    }
+    
+    // Clicking the active column again toggles the direction
+    if (order == numberingOrder) {
+        numberingDirection = numberingDirection == Qt::AscendingOrder ? Qt::DescendingOrder
+                                                                      : Qt::AscendingOrder;
+    } else {
+        numberingOrder = order;
+        numberingDirection = Qt::AscendingOrder;
+    }
+    
+    {
+        QSignalBlocker blocker(numberingOrderCombo);
+        numberingOrderCombo->setCurrentIndex(numberingOrderCombo->findData(int(numberingOrder)));
+    }
+    updateSortIndicator();
+    
+    startOrdering();
+    updatePreviews(currentOperations);
+}
+
+void FileListWidget::updateSortIndicator()
+{
+    int section = -1;  // No indicator for orders without a matching column
+    if (numberingOrder == NumberingOrder::Name) {
+        section = FileListModel::OriginalNameColumn;
+    } else if (numberingOrder == NumberingOrder::Path) {
+        section = FileListModel::PathColumn;
+    }
+    
+    QSignalBlocker blocker(treeView->header());
+    treeView->header()->setSortIndicator(section, numberingDirection);
+}
+
+void FileListWidget::entriesChanged()
+{
+    model->resetEntries();
+    fileFilter.invalidate();
+    applyFilter();
+    startOrdering();
+}
+
+void FileListWidget::entriesAppended(int firstEntry)
+{
+    // Rows are inserted at the end; filter and numbering order are then brought up
+    // to date as after a reset
+    model->appendEntries(firstEntry);
+    fileFilter.invalidate();
+    applyFilter();
+    startOrdering();
+}
+
+void FileListWidget::applyFilter()
+{
+    const QString text = filterEdit->text();
+    const auto status = FileFilter::Status(filterStatusCombo->currentData().toInt());
+    if (text.isEmpty() && status == FileFilter::AllFiles) {
+        model->clearFilter();
+    } else {
+        const auto field = FileFilter::Field(filterFieldCombo->currentData().toInt());
+        model->setFilter(fileFilter.apply(files, field, text, status));
+    }
+    updateFileCountLabel();
+}
+
+void FileListWidget::startOrdering()
+{
+    // Added order is known without computation
+    if (numberingOrder == NumberingOrder::Added && numberingDirection == Qt::AscendingOrder) {
+        orderingPending = false;
+        reorderPending = false;
+        QList<int> order(files.size());
+        std::iota(order.begin(), order.end(), 0);
+        applyOrdering(order);
+        return;
+    }
     
-    // Re-enable updates and trigger a single repaint
-    treeWidget->setUpdatesEnabled(true);
+    // Sort keys and the sort itself are computed off the GUI thread, with the scoped
+    // counters if a tag uses them; the list is passed by value (implicitly shared) so
+    // later edits do not affect the snapshot
+    const bool withScoped = std::any_of(currentOperations.cbegin(), currentOperations.cend(),
+                                        [](const std::shared_ptr<Operation> &op) {
+        return op && op->usesScopedCounters();
+    });
+    orderingPending = true;
+    reorderPending = true;
+    scopedJobGeneration = scopedNumberingGeneration;
+    orderingWatcher->setFuture(QtConcurrent::run(&FileOrdering::computeNumbering, files,
+                                                 numberingOrder, numberingDirection,
+                                                 withScoped));
+}
+
+void FileListWidget::startScopedNumbering()
+{
+    // The order stays; only the counters are computed, along the current order
+    orderingPending = true;
+    reorderPending = false;
+    scopedJobGeneration = scopedNumberingGeneration;
+    orderingWatcher->setFuture(QtConcurrent::run([files = files, numberingIndex = numberingIndex]() {
+        QList<int> order(files.size());
+        for (int i = 0; i < files.size(); ++i) {
+            order[numberingIndex.value(i, i)] = i;
+        }
+        Numbering numbering;
+        numbering.scoped = FileOrdering::computeScoped(files, order);
+        return numbering;
+    }));
+}
+
+void FileListWidget::applyOrdering(const QList<int> &order)
+{
+    scopedNumberingValid = false;
+    ++scopedNumberingGeneration;
+    numberingIndex.resize(order.size());
+    for (int row = 0; row < order.size(); ++row) {
+        numberingIndex[order[row]] = row;
+    }
+    model->setDisplayOrder(order);
 }
 
 QString FileListWidget::applyOperations(const QString &fileName, 
                                        const QList<std::shared_ptr<Operation>> &operations,
-                                       int fileIndex)
+                                       const TagContext &context, bool *limitExceeded)
 {
     QString result = fileName;
+    bool exceeded = false;
     
     for (const auto &op : operations) {
-        if (op) {
-            result = op->perform(result, fileIndex);
+        // Files outside the operation's condition keep their name for this step
+        if (op && op->appliesTo(result)) {
+            result = op->performWithinLimits(result, context, exceeded);
         }
     }
     
+    if (limitExceeded) {
+        *limitExceeded = exceeded;
+    }
     return result;
 }
 
+void FileListWidget::onHashesReady(const QList<ContentHash> &results)
+{
+    // Collect results and refresh at most every few hundred milliseconds
+    receivedHashes.append(results);
+    if (!hashRefreshTimer->isActive()) {
+        hashRefreshTimer->start();
+    }
+}
+
+void FileListWidget::applyReceivedHashes()
+{
+    if (receivedHashes.isEmpty()) {
+        return;
+    }
+    
+    // Results are matched by path; files removed meanwhile are skipped
+    for (const ContentHash &result : std::as_const(receivedHashes)) {
+        const qsizetype i = files.indexOf(result.filePath);
+        if (i >= 0) {
+            files.setContentHash(i, result.algorithm, result.digest);
+        }
+    }
+    
+    receivedHashes.clear();
+    updatePreviews(currentOperations);
+}
+
+void FileListWidget::onWatchToggled(bool enabled)
+{
+    directoryWatcher->clear();
+    if (!enabled) {
+        return;
+    }
+    
+    for (const QString &root : std::as_const(watchedRoots)) {
+        directoryWatcher->watchDirectory(root, true);
+    }
+    watchEntryDirectories(0);
+}
+
+void FileListWidget::watchEntryDirectories(int firstEntry)
+{
+    // Entries are mostly grouped by directory, so skipping repeats avoids most lookups
+    int lastDirectory = -1;
+    for (int i = firstEntry; i < files.size(); ++i) {
+        if (files.directoryId(i) != lastDirectory) {
+            lastDirectory = files.directoryId(i);
+            directoryWatcher->watchDirectory(files.directory(i), false);
+        }
+    }
+}
+
+void FileListWidget::onDirectoryChanges(const DirectoryChanges &changes)
+{
+    // Watcher paths are absolute, like the entry directories. Entries are found through
+    // the store's path index; the ones this batch already moved are tracked on the side
+    // until the moves are applied in one batch at the end.
+    QList<bool> removed(files.size(), false);
+    QHash<int, QString> moved;                  // Entry -> new path
+    QHash<QString, int> entryByNewPath;         // New path -> entry
+    QHash<QString, QSet<int>> movedByDirectory; // New folder -> entries moved into it
+    QStringList addedPaths;
+    bool pathsChanged = false;
+    
+    const auto folderOf = [](const QString &path) {
+        return path.left(path.lastIndexOf(QLatin1Char('/')));
+    };
+    auto currentPath = [&](int i) {
+        return moved.value(i, files.fullPath(i));
+    };
+    auto entryAt = [&](const QString &path) {
+        const auto it = entryByNewPath.constFind(path);
+        if (it != entryByNewPath.constEnd()) {
+            return *it;
+        }
+        const qsizetype i = files.indexOf(path);
+        return i >= 0 && !removed[i] && !moved.contains(int(i)) ? int(i) : -1;
+    };
+    auto forgetMove = [&](int i) {
+        const auto it = moved.constFind(i);
+        if (it != moved.constEnd()) {
+            movedByDirectory[folderOf(*it)].remove(i);
+            entryByNewPath.remove(*it);
+            moved.erase(it);
+        }
+    };
+    auto removeEntry = [&](int i) {
+        forgetMove(i);
+        removed[i] = true;
+        pathsChanged = true;
+    };
+    auto moveEntry = [&](int i, const QString &newPath) {
+        forgetMove(i);
+        moved.insert(i, newPath);
+        entryByNewPath.insert(newPath, i);
+        movedByDirectory[folderOf(newPath)].insert(i);
+        pathsChanged = true;
+    };
+    
+    // Folder events cover whole subtrees: the folders below one are found by binary
+    // search in the folder table sorted by path, and their entries through a list per
+    // folder id. Both are built on the first folder event of a batch.
+    QList<int> sortedDirectories;
+    QList<QList<int>> entriesByDirectory;
+    bool folderIndexBuilt = false;
+    auto entriesBelow = [&](const QString &folder) {
+        const QStringList &directories = files.directoryTable();
+        if (!folderIndexBuilt) {
+            entriesByDirectory.resize(directories.size());
+            for (int i = 0; i < files.size(); ++i) {
+                entriesByDirectory[files.directoryId(i)].append(i);
+            }
+            sortedDirectories.resize(directories.size());
+            std::iota(sortedDirectories.begin(), sortedDirectories.end(), 0);
+            std::sort(sortedDirectories.begin(), sortedDirectories.end(), [&](int a, int b) {
+                return directories[a] < directories[b];
+            });
+            folderIndexBuilt = true;
+        }
+        
+        QList<int> entries;
+        const auto addFolder = [&](int directoryId) {
+            for (int i : std::as_const(entriesByDirectory[directoryId])) {
+                if (!removed[i] && !moved.contains(i)) {
+                    entries.append(i);
+                }
+            }
+        };
+        const auto firstAtLeast = [&](const QString &path) {
+            return std::lower_bound(sortedDirectories.cbegin(), sortedDirectories.cend(), path,
+                                    [&](int id, const QString &value) { return directories[id] < value; });
+        };
+        // The folder itself, then everything starting with "folder/" (contiguous when
+        // sorted; "folder b" sorts between the two)
+        const auto exact = firstAtLeast(folder);
+        if (exact != sortedDirectories.cend() && directories[*exact] == folder) {
+            addFolder(*exact);
+        }
+        const QString prefix = folder + QLatin1Char('/');
+        for (auto it = firstAtLeast(prefix);
+             it != sortedDirectories.cend() && directories[*it].startsWith(prefix); ++it) {
+            addFolder(*it);
+        }
+        
+        // Entries this batch already moved into the subtree
+        for (auto it = movedByDirectory.cbegin(); it != movedByDirectory.cend(); ++it) {
+            if (it.key() == folder || it.key().startsWith(prefix)) {
+                for (int i : it.value()) {
+                    entries.append(i);
+                }
+            }
+        }
+        return entries;
+    };
+    
+    // New files follow the same rules as the scan of the folder they appeared in
+    const DirectoryScanner scanner(scanOptions);
+    auto acceptsNewFile = [&](const QString &path) {
+        for (const QString &root : std::as_const(watchedRoots)) {
+            if (path.startsWith(root + QLatin1Char('/'))) {
+                return scanner.accepts(root, path);
+            }
+        }
+        return true;
+    };
+    
+    // Events were lost: the list is compared against the disk in the background, and
+    // the differences come back as a batch of their own (onRescanReady())
+    if (changes.overflowed) {
+        startRescan();
+    }
+    
+    for (const DirectoryChange &change : changes.changes) {
+        switch (change.kind) {
+            case DirectoryChange::FileAdded:
+                if (acceptsNewFile(change.path)) {
+                    addedPaths.append(change.path);
+                }
+                break;
+            case DirectoryChange::FileRemoved: {
+                const int i = entryAt(change.path);
+                if (i >= 0) {
+                    removeEntry(i);
+                }
+                break;
+            }
+            case DirectoryChange::FileRenamed: {
+                const int i = entryAt(change.path);
+                if (i >= 0) {
+                    // Renamed onto another listed file: keep only one entry
+                    const int target = entryAt(change.newPath);
+                    if (target >= 0) {
+                        removeEntry(target);
+                    }
+                    moveEntry(i, change.newPath);
+                }
+                break;
+            }
+            case DirectoryChange::DirectoryRemoved:
+            case DirectoryChange::DirectoryRenamed: {
+                for (int i : entriesBelow(change.path)) {
+                    if (change.kind == DirectoryChange::DirectoryRemoved) {
+                        removeEntry(i);
+                    } else {
+                        moveEntry(i, change.newPath + currentPath(i).mid(change.path.size()));
+                    }
+                }
+                break;
+            }
+        }
+    }
+    
+    // Moved entries take their new paths in one batch; those whose name changed need a
+    // new preview
+    QList<int> movedEntries;
+    QStringList movedDirectories;
+    QStringList movedNames;
+    QSet<int> renamed;
+    for (auto it = moved.cbegin(); it != moved.cend(); ++it) {
+        const QFileInfo fileInfo(it.value());
+        movedEntries.append(it.key());
+        movedDirectories.append(fileInfo.absolutePath());
+        movedNames.append(fileInfo.fileName());
+        if (files.originalNameColumn().at(it.key()) != fileInfo.fileName()) {
+            renamed.insert(it.key());
+        }
+    }
+    files.setLocations(movedEntries, movedDirectories, movedNames);
+    
+    // Compact the entry list in one pass, keeping the order of the remaining entries
+    QList<int> newIndex(files.size(), -1);
+    int kept = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        if (!removed[i]) {
+            newIndex[i] = kept++;
+        }
+    }
+    if (kept != files.size()) {
+        files.remove(removed);
+    }
+    
+    const int firstNew = files.size();
+    const int addedCount = appendEntries(addedPaths);
+    if (!pathsChanged && addedCount == 0) {
+        return;
+    }
+    if (pathsChanged) {
+        entriesChanged();
+    } else {
+        entriesAppended(firstNew);
+    }
+    
+    // Without numbering tags a file's preview only depends on its own name, so only
+    // renamed and new entries need one; otherwise (or while a full update or the
+    // numbering order is still being computed) everything is recomputed
+    bool usesCounters = false;
+    for (const auto &op : std::as_const(currentOperations)) {
+        usesCounters = usesCounters || (op && op->usesCounters());
+    }
+    if (usesCounters || orderingPending || previewWatcher->isRunning()) {
+        updatePreviews(currentOperations);
+        return;
+    }
+    
+    QList<int> entryIndices;
+    entryIndices.reserve(renamed.size() + addedCount);
+    for (int i : std::as_const(renamed)) {
+        if (newIndex[i] >= 0) {
+            entryIndices.append(newIndex[i]);
+        }
+    }
+    for (int i = firstNew; i < files.size(); ++i) {
+        entryIndices.append(i);
+    }
+    updateEntryPreviews(entryIndices);
+}
+
+void FileListWidget::startRescan()
+{
+    // A comparison that started before the latest loss could miss its changes
+    if (rescanWatcher->isRunning()) {
+        rescanAgain = true;
+        return;
+    }
+    rescanWatcher->setFuture(QtConcurrent::run(&rescanWatchedFolders, files,
+                                               QStringList(watchedRoots.cbegin(), watchedRoots.cend()),
+                                               scanOptions));
+}
+
+void FileListWidget::onRescanReady()
+{
+    if (rescanAgain) {
+        rescanAgain = false;
+        startRescan();
+        return;
+    }
+    if (!watchCheckBox->isChecked()) {
+        return; // Watching was turned off meanwhile
+    }
+    
+    // Entries are matched by path; the list may have changed while the comparison ran
+    const WatchRescan rescan = rescanWatcher->result();
+    for (const QPair<QString, FileMetadata> &change : rescan.changed) {
+        const qsizetype i = files.indexOf(change.first);
+        if (i >= 0) {
+            files.setMetadata(i, change.second);
+        }
+    }
+    DirectoryChanges changes;
+    for (const QString &path : rescan.gone) {
+        changes.changes.append({DirectoryChange::FileRemoved, path, QString()});
+    }
+    for (const QString &path : rescan.found) {
+        changes.changes.append({DirectoryChange::FileAdded, path, QString()});
+    }
+    if (!changes.isEmpty()) {
+        onDirectoryChanges(changes);
+    }
+}
+
 void FileListWidget::showContextMenu(const QPoint &pos)
 {
     // Only show context menu if there are selected items
-    QList<QTreeWidgetItem*> selectedItems = treeWidget->selectedItems();
-    if (selectedItems.isEmpty()) {
+    if (!treeView->selectionModel()->hasSelection()) {
         return;
     }
     
@@ -302,43 +1423,29 @@ void FileListWidget::showContextMenu(const QPoint &pos)
     QAction *removeAction = contextMenu.addAction(tr("Remove Selected"));
     connect(removeAction, &QAction::triggered, this, &FileListWidget::removeSelectedFiles);
     
-    contextMenu.exec(treeWidget->mapToGlobal(pos));
+    contextMenu.exec(treeView->viewport()->mapToGlobal(pos));
 }
 
 void FileListWidget::removeSelectedFiles()
 {
-    QList<QTreeWidgetItem*> selectedItems = treeWidget->selectedItems();
-    if (selectedItems.isEmpty()) {
+    const QItemSelection selection = treeView->selectionModel()->selection();
+    if (selection.isEmpty()) {
         return;
     }
     
-    // Disable updates during batch removal
-    treeWidget->setUpdatesEnabled(false);
-    
-    // Create a set of items to remove for quick lookup
-    QSet<QTreeWidgetItem*> itemsToRemove;
-    for (QTreeWidgetItem *item : selectedItems) {
-        itemsToRemove.insert(item);
-    }
-    
-    // Remove files from the list in reverse order to maintain indices
-    for (int i = files.size() - 1; i >= 0; --i) {
-        if (itemsToRemove.contains(files[i].item)) {
-            // Update filePathsSet to reflect removal
-            filePathsSet.remove(files[i].fullPath);
-            
-            // Remove the tree widget item
-            delete files[i].item;
-            
-            // Remove from the files list
-            files.removeAt(i);
+    // Selection ranges go straight into a bitmap of entries, without an index per row
+    QList<bool> removed(files.size(), false);
+    for (const QItemSelectionRange &range : selection) {
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            removed[model->entryIndex(row)] = true;
         }
     }
     
-    // Re-enable updates
-    treeWidget->setUpdatesEnabled(true);
-    
-    updateFileCountLabel();
+    // One stable compaction pass over the store, then a single model reset; new names
+    // and preview states move with their entries
+    files.remove(removed);
+    files.trimToBudget();
+    entriesChanged();
     emit filesChanged();
 }
 
@@ -364,19 +1471,28 @@ void FileListWidget::dropEvent(QDropEvent *event)
     
     if (mimeData->hasUrls()) {
         QStringList filePaths;
+        const DirectoryScanner scanner(scanOptions);
         
         // Process each dropped URL
         for (const QUrl &url : mimeData->urls()) {
             if (url.isLocalFile()) {
-                QString path = url.toLocalFile();
-                QFileInfo fileInfo(path);
+                // Exact bytes of the dropped path; stat'ed by those bytes as well
+                const QString path = FileNameCodec::localFile(url);
+                const FileMetadata metadata = FileMetadata::read(path);
                 
-                if (fileInfo.isFile()) {
+                if (metadata.type == FileMetadata::RegularFile) {
                     // Add file directly
                     filePaths.append(path);
-                } else if (fileInfo.isDir()) {
-                    // Recursively collect files from directory
-                    filePaths.append(collectFilesFromDirectory(path));
+                } else if (metadata.type == FileMetadata::Directory) {
+                    // Collect the files below the folder; excluded subfolders are skipped
+                    filePaths.append(scanner.scan(path));
+                    
+                    // New files in dropped folders are picked up while watching
+                    const QString root = QFileInfo(path).absoluteFilePath();
+                    watchedRoots.insert(root);
+                    if (watchCheckBox->isChecked()) {
+                        directoryWatcher->watchDirectory(root, true);
+                    }
                 }
             }
         }
@@ -390,25 +1506,51 @@ void FileListWidget::dropEvent(QDropEvent *event)
     }
 }
 
-QStringList FileListWidget::collectFilesFromDirectory(const QString &dirPath)
+void FileListWidget::showScanOptions()
 {
-    QStringList filePaths;
-    
-    // Use QDirIterator to recursively traverse the directory
-    QDirIterator it(dirPath, QDir::Files, QDirIterator::Subdirectories);
-    
-    while (it.hasNext()) {
-        filePaths.append(it.next());
+    ScanOptionsDialog dialog(scanOptions, this);
+    if (dialog.exec() == QDialog::Accepted) {
+        scanOptions = dialog.options();
+        scanOptionsButton->setText(scanOptions.isDefault() ? tr("Folder Options...")
+                                                           : tr("Folder Options (active)..."));
     }
-    
-    return filePaths;
 }
+
 void FileListWidget::updateFileCountLabel()
 {
     int count = files.size();
-    if (count == 1) {
-        fileCountLabel->setText(tr("1 file"));
+    QString text;
+    if (model->hasFilter()) {
+        text = tr("%1 of %2 files").arg(model->rowCount()).arg(count);
+    } else if (count == 1) {
+        text = tr("1 file");
     } else {
-        fileCountLabel->setText(tr("%1 files").arg(count));
+        text = tr("%1 files").arg(count);
+    }
+    
+    // Files a mapping file has no row for, as found by the last preview
+    const QList<quint8> &flags = files.flagColumn();
+    const qsizetype unmatched = std::count_if(flags.cbegin(), flags.cend(), [](quint8 flag) {
+        return flag & EntryStore::UnmatchedFlag;
+    });
+    if (unmatched > 0) {
+        text += tr(" (%1 not in mapping)").arg(unmatched);
+    }
+    
+    // Files a pattern gave up on; they keep their name
+    const qsizetype limited = std::count_if(flags.cbegin(), flags.cend(), [](quint8 flag) {
+        return flag & EntryStore::LimitFlag;
+    });
+    if (limited > 0) {
+        text += tr(" (%1 over pattern limits)").arg(limited);
+    }
+    
+    // Files whose new name would leave their folder; they keep their name
+    const qsizetype outside = std::count_if(flags.cbegin(), flags.cend(), [](quint8 flag) {
+        return flag & EntryStore::OutsideFolderFlag;
+    });
+    if (outside > 0) {
+        text += tr(" (%1 outside their folder)").arg(outside);
     }
+    fileCountLabel->setText(text);
 }
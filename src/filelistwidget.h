@@ -2,8 +2,10 @@
 #define FILELISTWIDGET_H
 
 #include <QWidget>
-#include <QTreeWidget>
-#include <QTreeWidgetItem>
+#include <QTreeView>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QLineEdit>
 #include <QStringList>
 #include <QFileInfo>
 #include <QPair>
@@ -13,16 +15,51 @@
 #include <QMenu>
 #include <QLabel>
 #include <QPushButton>
+#include <QTimer>
+#include <QThreadPool>
+#include <QElapsedTimer>
 #include <memory>
+#include <atomic>
+#include "contenthasher.h"
+#include "fileordering.h"
+#include "directorywatcher.h"
+#include "filefilter.h"
+#include "directoryscanner.h"
+#include "filemetadata.h"
+#include "renameexecutor.h"
+#include "entrystore.h"
 
 class Operation;
+class FileListModel;
+struct TagContext;
+struct SessionData;
+struct WatchRescan;
 
-struct FileEntry {
-    QString fullPath;
-    QString directory;
-    QString originalName;
-    QString newName;
-    QTreeWidgetItem *item;
+/**
+ * @brief New names computed in the background, for one chunk of entries or a list of entries.
+ */
+struct PreviewChunk {
+    int generation = 0;                       // Preview run the chunk belongs to
+    int chunk = -1;                           // Chunk of a full update; -1 for a partial update
+    std::shared_ptr<const StringChunk> names; // Pending entries keep their original name
+    QList<char> states;                       // Per name: EntryStore::PreviewState
+    QList<char> unmatched;                    // Per name: not in a mapping file; empty without one
+    QList<char> limitExceeded;                // Per name: a pattern exceeded its limits; empty if none did
+    QList<char> outsideFolder;                // Per name: it resolved outside the folder; empty if none did
+};
+
+/**
+ * @brief Snapshot of everything the background preview computation reads.
+ */
+struct PreviewInput {
+    EntryStore files;
+    QList<int> numberingIndex;
+    ScopedNumbering scopedNumbering;
+    bool usesScopedCounters = false;
+    QStringList requiredHashes;
+    QList<std::shared_ptr<Operation>> operations;
+    int generation = 0;                          // Copied into every PreviewChunk
+    std::shared_ptr<std::atomic<bool>> cancelled; // Set once a newer run supersedes this one
 };
 
 class FileListWidget : public QWidget
@@ -36,16 +73,47 @@ public:
     void clearFiles();
     void updatePreviews(const QList<std::shared_ptr<Operation>> &operations);
     int applyRename(QStringList &errors);
+    
+    /**
+     * @brief Simulate applyRename() without touching the files.
+     * @param details Receives one line per conflict and cycle; may be null
+     * @return Summary of conflicts, system calls and the estimated time
+     */
+    QString dryRun(QString *details = nullptr) const;
+    int fileCount() const { return int(files.size()); }
+    void exportSession(SessionData &data) const;
+    void importSession(SessionData &data);
+    
+    /**
+     * @brief Limit the memory used by file names; beyond it names are spilled to disk.
+     * @param bytes Budget for the original and new names
+     * @param spillDirectory Folder for the spill file; empty keeps the current one
+     */
+    void setMemoryBudget(qint64 bytes, const QString &spillDirectory = QString());
+    qint64 memoryBudget() const { return files.memoryBudget(); }
+    QString spillDirectory() const { return files.spillDirectory(); }
 
 signals:
     void filesChanged();
     void renameRequested();
+    void previewCostMeasured(qint64 elapsedNs, int fileCount);
 
 private slots:
     void onItemSelectionChanged();
     void onPreviewsReady();
+    void onOrderingReady();
+    void onNumberingOrderChanged(int index);
+    void onHeaderClicked(int section);
     void showContextMenu(const QPoint &pos);
     void removeSelectedFiles();
+    void onHashesReady(const QList<ContentHash> &results);
+    void applyReceivedHashes();
+    void onWatchToggled(bool enabled);
+    void onDirectoryChanges(const DirectoryChanges &changes);
+    void onRevalidationReady();
+    void onRescanReady();
+    void applyFilter();
+    void showScanOptions();
 
 protected:
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -54,18 +122,68 @@ protected:
 
 private:
     void setupUI();
+    QList<RenameTask> renameTasks(QList<int> *entries = nullptr) const;
     void updateFileCountLabel();
+    void entriesChanged();
+    void entriesAppended(int firstEntry);
+    int appendEntries(const QStringList &filePaths);
+    void updateEntryPreviews(const QList<int> &entryIndices);
+    void installPreview(const PreviewChunk &preview, const QList<int> &entryIndices);
+    void cancelPreviews();
+    std::shared_ptr<PreviewInput> newPreviewInput();
+    void watchEntryDirectories(int firstEntry);
+    void startRescan();
+    void startOrdering();
+    void startScopedNumbering();
+    void applyOrdering(const QList<int> &order);
+    void updateSortIndicator();
     static QString applyOperations(const QString &fileName, 
                                    const QList<std::shared_ptr<Operation>> &operations,
-                                   int fileIndex = 0);
-    QStringList collectFilesFromDirectory(const QString &dirPath);
+                                   const TagContext &context, bool *limitExceeded = nullptr);
+    static PreviewChunk computePreview(const PreviewInput &input, int chunk, const QList<int> &entryIndices);
+    
+    // --benchmark-preview runs the preview pass without a widget
+    friend class EngineVerifier;
     
-    QTreeWidget *treeWidget;
+    QTreeView *treeView;
+    FileListModel *model;
     QLabel *fileCountLabel;
+    QComboBox *numberingOrderCombo;
+    QCheckBox *watchCheckBox;
+    QPushButton *scanOptionsButton;
+    QLineEdit *filterEdit;
+    QComboBox *filterFieldCombo;
+    QComboBox *filterStatusCombo;
+    FileFilter fileFilter;
     QPushButton *renameButton;
-    QList<FileEntry> files;
-    QSet<QString> filePathsSet; // For fast duplicate checking
-    QFutureWatcher<QString> *previewWatcher;
+    EntryStore files; // Also answers duplicate checks by path
+    QFutureWatcher<PreviewChunk> *previewWatcher;
+    int previewGeneration = 0; // Results of older runs are dropped when they arrive
+    std::shared_ptr<std::atomic<bool>> previewCancelled; // Cancel flag of the running run
+    QList<int> previewEntries; // Entries of a partial preview update (empty = all entries)
+    QThreadPool *previewPool; // Low-priority threads for rows outside the viewport
+    QElapsedTimer previewTimer; // Measures the cost of the running preview update
+    QFutureWatcher<Numbering> *orderingWatcher;
+    QFutureWatcher<QStringList> *revalidationWatcher; // Stale check after opening a session
+    QFutureWatcher<WatchRescan> *rescanWatcher; // Comparison with the disk after lost watcher events
+    bool rescanAgain = false; // Events were lost again while the comparison was running
+    NumberingOrder numberingOrder = NumberingOrder::Added;
+    Qt::SortOrder numberingDirection = Qt::AscendingOrder;
+    bool orderingPending = false; // Previews wait for the numbering order and scoped numbers
+    bool reorderPending = false;  // The running ordering job also computes a new order
+    QList<int> numberingIndex; // Entry index -> 0-based number used by tags
+    ScopedNumbering scopedNumbering; // Per-directory/extension numbers, computed on demand
+    bool scopedNumberingValid = false;
+    int scopedNumberingGeneration = 0; // Bumped whenever the entries are regrouped or reordered
+    int scopedJobGeneration = 0;       // Generation the running ordering job started from
+    QList<std::shared_ptr<Operation>> currentOperations;
+    QStringList requiredHashes; // Hash algorithms needed by currentOperations
+    ContentHasher *contentHasher;
+    QList<ContentHash> receivedHashes;
+    QTimer *hashRefreshTimer; // Coalesces hash results into one preview refresh
+    DirectoryWatcher *directoryWatcher;
+    QSet<QString> watchedRoots; // Dropped folders; new files in them are added
+    ScanOptions scanOptions; // Rules for dropped folders and files added to them later
 };
 
 #endif // FILELISTWIDGET_H
@@ -0,0 +1,162 @@
+#include "filemetadata.h"
+#include "filenamecodec.h"
+#include "iouring.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QtConcurrent>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+#ifdef REGEX_RENAME_HAVE_IO_URING
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+constexpr qsizetype ChunkSize = 4096;
+constexpr unsigned RingEntries = 1024;
+
+// Run fn(begin, end) over [0, count) in parallel chunks of ChunkSize
+template <typename Fn>
+void forEachChunk(qsizetype count, Fn fn)
+{
+    QList<qsizetype> chunkStarts;
+    for (qsizetype begin = 0; begin < count; begin += ChunkSize) {
+        chunkStarts.append(begin);
+    }
+    QtConcurrent::blockingMap(chunkStarts, [count, &fn](const qsizetype &begin) {
+        fn(begin, qMin<qsizetype>(begin + ChunkSize, count));
+    });
+}
+
+#ifdef Q_OS_UNIX
+FileMetadata::Type typeOf(unsigned mode)
+{
+    if (S_ISREG(mode)) {
+        return FileMetadata::RegularFile;
+    }
+    return S_ISDIR(mode) ? FileMetadata::Directory : FileMetadata::Other;
+}
+#endif
+
+#ifdef REGEX_RENAME_HAVE_IO_URING
+constexpr unsigned StatxMask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO;
+
+FileMetadata fromStatx(const struct statx &info)
+{
+    FileMetadata metadata;
+    metadata.type = typeOf(info.stx_mode);
+    metadata.size = qint64(info.stx_size);
+    metadata.modified = qint64(info.stx_mtime.tv_sec) * 1000000000 + info.stx_mtime.tv_nsec;
+    // Same encoding as st_dev from stat(), so ids from both paths compare equal
+    metadata.device = quint64(makedev(info.stx_dev_major, info.stx_dev_minor));
+    metadata.inode = quint64(info.stx_ino);
+    return metadata;
+}
+
+// Keeps up to RingEntries statx calls in flight; each slot owns one result buffer
+bool readAllWithIoUring(const QList<QByteArray> &paths, QList<FileMetadata> &results)
+{
+    IoUring ring(RingEntries);
+    if (!ring.supports(IORING_OP_STATX)) {
+        return false;
+    }
+    
+    const unsigned slots = ring.capacity();
+    QList<struct statx> buffers(slots);
+    QList<qsizetype> pathOfSlot(slots, -1);
+    QList<unsigned> freeSlots;
+    for (unsigned slot = slots; slot > 0; --slot) {
+        freeSlots.append(slot - 1);
+    }
+    
+    qsizetype next = 0;
+    unsigned inFlight = 0;
+    while (next < paths.size() || inFlight > 0) {
+        while (next < paths.size() && !freeSlots.isEmpty() && ring.freeEntries() > 0) {
+            const unsigned slot = freeSlots.takeLast();
+            pathOfSlot[slot] = next;
+            ring.prepareStatx(paths[next].constData(), AT_STATX_SYNC_AS_STAT, StatxMask,
+                              &buffers[slot], slot);
+            ++next;
+            ++inFlight;
+        }
+        if (!ring.submit(1)) {
+            // Nothing was accepted; the remaining paths are done by the caller's fallback
+            return false;
+        }
+        quint64 slot = 0;
+        int result = 0;
+        while (ring.nextCompletion(slot, result)) {
+            if (result == 0) {
+                results[pathOfSlot[slot]] = fromStatx(buffers[slot]);
+            }
+            freeSlots.append(unsigned(slot));
+            --inFlight;
+        }
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+FileMetadata FileMetadata::read(const QString &path)
+{
+    FileMetadata metadata;
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (stat(FileNameCodec::encode(path).constData(), &info) != 0) {
+        return metadata;
+    }
+    metadata.type = typeOf(info.st_mode);
+    metadata.size = qint64(info.st_size);
+#if defined(Q_OS_DARWIN)
+    metadata.modified = qint64(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    metadata.modified = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    metadata.device = quint64(info.st_dev);
+    metadata.inode = quint64(info.st_ino);
+#else
+    const QFileInfo fileInfo(path);
+    if (!fileInfo.exists()) {
+        return metadata;
+    }
+    metadata.type = fileInfo.isFile() ? RegularFile : fileInfo.isDir() ? Directory : Other;
+    metadata.size = fileInfo.size();
+    metadata.modified = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+    return metadata;
+}
+
+QList<FileMetadata> FileMetadata::readAll(const QStringList &paths)
+{
+    QList<FileMetadata> results(paths.size());
+
+#ifdef REGEX_RENAME_HAVE_IO_URING
+    // Small lists are not worth setting up a ring
+    if (paths.size() >= 64) {
+        QList<QByteArray> encoded;
+        encoded.reserve(paths.size());
+        for (const QString &path : paths) {
+            encoded.append(FileNameCodec::encode(path));
+        }
+        if (readAllWithIoUring(encoded, results)) {
+            return results;
+        }
+    }
+#endif
+
+    FileMetadata *out = results.data();
+    const QString *in = paths.constData();
+    forEachChunk(paths.size(), [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            out[i] = read(in[i]);
+        }
+    });
+    return results;
+}
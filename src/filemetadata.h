@@ -0,0 +1,46 @@
+#ifndef FILEMETADATA_H
+#define FILEMETADATA_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+/**
+ * @brief File system metadata of a path, taken once when the file is added.
+ *
+ * Kept for every entry so ordering by date or size and session snapshots
+ * do not need to stat the files again.
+ */
+struct FileMetadata {
+    enum Type : quint8 {
+        Missing,      // Could not be stat'ed (metadata unknown)
+        RegularFile,
+        Directory,
+        Other         // Sockets, devices, ...
+    };
+    
+    Type type = Missing;
+    qint64 size = -1;
+    qint64 modified = 0;  // Nanoseconds since epoch
+    quint64 device = 0;   // st_dev encoding, whichever call read it
+    quint64 inode = 0;
+    
+    bool isValid() const { return type != Missing; }
+    
+    /**
+     * @brief Stat a single path (following symbolic links).
+     */
+    static FileMetadata read(const QString &path);
+    
+    /**
+     * @brief Stat many paths at once.
+     *
+     * On Linux the statx calls are queued through io_uring in batches, so the
+     * kernel runs them concurrently; elsewhere (or without io_uring) the paths
+     * are stat'ed in parallel chunks on the global thread pool.
+     * @return Metadata per path, in the same order
+     */
+    static QList<FileMetadata> readAll(const QStringList &paths);
+};
+
+#endif // FILEMETADATA_H
@@ -0,0 +1,283 @@
+#include "filenamecodec.h"
+#include <QFile>
+#include <QUrl>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#else
+#include <QDirIterator>
+#include <QFileInfo>
+#endif
+
+namespace {
+
+// Escaped bytes are 0xDC00 plus the byte; only bytes >= 0x80 can be invalid
+constexpr char16_t EscapeBase = 0xDC00;
+constexpr char16_t FirstEscape = 0xDC80;
+constexpr char16_t LastEscape = 0xDCFF;
+
+// Private-use characters that stand in for escapes while regular expressions match
+constexpr char16_t MappedBase = 0xF700;
+constexpr char16_t FirstMapped = 0xF780;
+constexpr char16_t LastMapped = 0xF7FF;
+
+// A low surrogate in the escape range that is not the second half of a pair
+bool isEscapeAt(QStringView name, qsizetype i)
+{
+    const char16_t c = name[i].unicode();
+    return c >= FirstEscape && c <= LastEscape && (i == 0 || !name[i - 1].isHighSurrogate());
+}
+
+#ifdef Q_OS_UNIX
+// Length of the longest prefix made of complete, well-formed UTF-8 sequences
+// (no overlong forms, no surrogates, nothing above U+10FFFF)
+qsizetype validUtf8Prefix(const uchar *data, qsizetype size)
+{
+    qsizetype i = 0;
+    while (i < size) {
+        const uchar c = data[i];
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        
+        int length;
+        uchar low = 0x80;
+        uchar high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c == 0xE0) {
+            length = 3;
+            low = 0xA0;
+        } else if (c == 0xED) {
+            length = 3;
+            high = 0x9F;
+        } else if (c >= 0xE1 && c <= 0xEF) {
+            length = 3;
+        } else if (c == 0xF0) {
+            length = 4;
+            low = 0x90;
+        } else if (c == 0xF4) {
+            length = 4;
+            high = 0x8F;
+        } else if (c >= 0xF1 && c <= 0xF3) {
+            length = 4;
+        } else {
+            return i;
+        }
+        
+        if (size - i < length || data[i + 1] < low || data[i + 1] > high) {
+            return i;
+        }
+        for (int k = 2; k < length; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) {
+                return i;
+            }
+        }
+        i += length;
+    }
+    return size;
+}
+
+FileMetadata::Type typeOf(mode_t mode)
+{
+    if (S_ISREG(mode)) {
+        return FileMetadata::RegularFile;
+    }
+    return S_ISDIR(mode) ? FileMetadata::Directory : FileMetadata::Other;
+}
+#endif
+
+} // namespace
+
+QString FileNameCodec::decode(const char *bytes, qsizetype size)
+{
+#ifdef Q_OS_UNIX
+    const auto *data = reinterpret_cast<const uchar *>(bytes);
+    
+    // Common case: valid UTF-8, left to Qt's vectorized decoder
+    qsizetype valid = validUtf8Prefix(data, size);
+    if (valid == size) {
+        return QString::fromUtf8(bytes, size);
+    }
+    
+    QString result;
+    result.reserve(size);
+    qsizetype i = 0;
+    while (true) {
+        result += QString::fromUtf8(bytes + i, valid);
+        i += valid;
+        if (i == size) {
+            break;
+        }
+        result += QChar(char16_t(EscapeBase + data[i]));
+        ++i;
+        valid = validUtf8Prefix(data + i, size - i);
+    }
+    return result;
+#else
+    return QFile::decodeName(QByteArray(bytes, size));
+#endif
+}
+
+QByteArray FileNameCodec::encode(QStringView name)
+{
+#ifdef Q_OS_UNIX
+    if (!hasEscapes(name)) {
+        return name.toUtf8();
+    }
+    
+    QByteArray result;
+    result.reserve(name.size() * 3);
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < name.size(); ++i) {
+        if (isEscapeAt(name, i)) {
+            result += name.mid(start, i - start).toUtf8();
+            result += char(name[i].unicode() - EscapeBase);
+            start = i + 1;
+        }
+    }
+    result += name.mid(start).toUtf8();
+    return result;
+#else
+    return QFile::encodeName(name.toString());
+#endif
+}
+
+bool FileNameCodec::hasEscapes(QStringView name)
+{
+    for (qsizetype i = 0; i < name.size(); ++i) {
+        if (isEscapeAt(name, i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString FileNameCodec::mapEscapes(QStringView name)
+{
+    QString result = name.toString();
+    for (qsizetype i = 0; i < result.size(); ++i) {
+        if (isEscapeAt(name, i)) {
+            result[i] = QChar(char16_t(name[i].unicode() - EscapeBase + MappedBase));
+        }
+    }
+    return result;
+}
+
+QString FileNameCodec::restoreEscapes(QStringView mapped)
+{
+    QString result = mapped.toString();
+    for (qsizetype i = 0; i < result.size(); ++i) {
+        const char16_t c = result[i].unicode();
+        if (c >= FirstMapped && c <= LastMapped) {
+            result[i] = QChar(char16_t(c - MappedBase + EscapeBase));
+        }
+    }
+    return result;
+}
+
+bool FileNameCodec::canMapEscapes(QStringView name)
+{
+    for (const QChar c : name) {
+        if (c.unicode() >= FirstMapped && c.unicode() <= LastMapped) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString FileNameCodec::display(const QString &name)
+{
+    if (!hasEscapes(name)) {
+        return name;
+    }
+    QString result = name;
+    for (qsizetype i = 0; i < result.size(); ++i) {
+        if (isEscapeAt(name, i)) {
+            result[i] = QChar::ReplacementCharacter;
+        }
+    }
+    return result;
+}
+
+QString FileNameCodec::localFile(const QUrl &url)
+{
+#ifdef Q_OS_UNIX
+    // QUrl keeps percent-encoded bytes that are not UTF-8 as they are
+    if (url.isLocalFile() && url.host().isEmpty()) {
+        return decode(QByteArray::fromPercentEncoding(url.path(QUrl::FullyEncoded).toLatin1()));
+    }
+#endif
+    return url.toLocalFile();
+}
+
+QList<FileNameCodec::DirectoryEntry> FileNameCodec::list(const QString &directory, bool *ok)
+{
+    QList<DirectoryEntry> entries;
+#ifdef Q_OS_UNIX
+    DIR *dir = ::opendir(encode(directory).constData());
+    if (ok) {
+        *ok = dir != nullptr;
+    }
+    if (!dir) {
+        return entries;
+    }
+    
+    const int directoryFd = ::dirfd(dir);
+    while (const dirent *entry = ::readdir(dir)) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        
+        DirectoryEntry result;
+        result.name = decode(name, qsizetype(std::strlen(name)));
+        
+        // The type comes with the entry on most file systems; links and file systems
+        // without d_type need a stat
+        struct stat info;
+        switch (entry->d_type) {
+            case DT_REG:
+                result.type = FileMetadata::RegularFile;
+                break;
+            case DT_DIR:
+                result.type = FileMetadata::Directory;
+                break;
+            case DT_LNK:
+            case DT_UNKNOWN:
+                result.isSymLink = entry->d_type == DT_LNK
+                    || (::fstatat(directoryFd, name, &info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(info.st_mode));
+                if (::fstatat(directoryFd, name, &info, 0) == 0) {
+                    result.type = typeOf(info.st_mode);
+                }
+                break;
+            default:
+                result.type = FileMetadata::Other;
+                break;
+        }
+        entries.append(result);
+    }
+    ::closedir(dir);
+#else
+    QDirIterator it(directory, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    if (ok) {
+        *ok = QFileInfo(directory).isDir();
+    }
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        DirectoryEntry result;
+        result.name = info.fileName();
+        result.type = info.isFile() ? FileMetadata::RegularFile
+                    : info.isDir() ? FileMetadata::Directory
+                    : info.exists() ? FileMetadata::Other : FileMetadata::Missing;
+        result.isSymLink = info.isSymLink();
+        entries.append(result);
+    }
+#endif
+    return entries;
+}
@@ -0,0 +1,79 @@
+#ifndef FILENAMECODEC_H
+#define FILENAMECODEC_H
+
+#include <QString>
+#include <QStringView>
+#include <QByteArray>
+#include <QList>
+#include "filemetadata.h"
+
+class QUrl;
+
+/**
+ * @brief Lossless conversion between file name bytes and QString.
+ *
+ * Linux file names are byte strings that are usually, but not always, UTF-8.
+ * Valid UTF-8 decodes as usual; every byte of an invalid sequence becomes a lone
+ * low surrogate U+DC80..U+DCFF ("surrogate escape"), which encode() turns back
+ * into the same byte. Names are decoded once when they are read from the file
+ * system, renamed as UTF-16 and encoded once when they go back to the kernel, so
+ * a name that is not valid UTF-8 keeps its exact bytes. QFile::encodeName() and
+ * QFile::decodeName() would replace such bytes and lose the file.
+ *
+ * On other platforms file names are Unicode and the functions fall back to the
+ * QFile conversions.
+ */
+class FileNameCodec
+{
+public:
+    /**
+     * @brief One entry of a directory listing.
+     */
+    struct DirectoryEntry {
+        QString name;
+        FileMetadata::Type type = FileMetadata::Missing; // Of the link target for symbolic links
+        bool isSymLink = false;
+    };
+    
+    static QString decode(const char *bytes, qsizetype size);
+    static QString decode(const QByteArray &bytes) { return decode(bytes.constData(), bytes.size()); }
+    static QByteArray encode(QStringView name);
+    
+    /**
+     * @brief Whether the name contains bytes that are not valid UTF-8.
+     */
+    static bool hasEscapes(QStringView name);
+    
+    /**
+     * @brief The name for display: escaped bytes are shown as U+FFFD.
+     *
+     * Keeps the length, so positions in the name stay valid for the display text.
+     */
+    static QString display(const QString &name);
+    
+    /**
+     * @brief The name with escaped bytes moved to the private-use characters U+F780..U+F7FF.
+     *
+     * Regular expressions need valid UTF-16 and never match a name with escapes. The
+     * mapped name keeps its length, so match positions stay valid, and restoreEscapes()
+     * undoes the mapping. That is only exact if the name has no characters of the
+     * private-use range itself (see canMapEscapes()).
+     */
+    static QString mapEscapes(QStringView name);
+    static QString restoreEscapes(QStringView mapped);
+    static bool canMapEscapes(QStringView name);
+    
+    /**
+     * @brief Local path of a file URL (e.g. from a drop), with the exact bytes of its
+     * percent-encoding.
+     */
+    static QString localFile(const QUrl &url);
+    
+    /**
+     * @brief Names in a directory except "." and "..", decoded losslessly.
+     * @param ok Set to false if the directory could not be read; may be null
+     */
+    static QList<DirectoryEntry> list(const QString &directory, bool *ok = nullptr);
+};
+
+#endif // FILENAMECODEC_H
@@ -0,0 +1,335 @@
+#include "fileordering.h"
+#include "entrystore.h"
+#include <QCollator>
+#include <QHash>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+namespace {
+
+constexpr int ChunkSize = 16384;
+
+// Run fn(begin, end) over [0, count) in parallel chunks of ChunkSize
+template <typename Fn>
+void forEachChunk(int count, Fn fn)
+{
+    QList<int> chunkStarts;
+    for (int begin = 0; begin < count; begin += ChunkSize) {
+        chunkStarts.append(begin);
+    }
+    QtConcurrent::blockingMap(chunkStarts, [count, &fn](const int &begin) {
+        fn(begin, qMin(begin + ChunkSize, count));
+    });
+}
+
+// Sort slices in parallel, then merge neighbouring runs pairwise in parallel rounds
+template <typename Less>
+void parallelSort(QList<int> &indices, Less less)
+{
+    const int count = int(indices.size());
+    const int parts = qBound(1, QThread::idealThreadCount(), count / ChunkSize + 1);
+    
+    QList<int> bounds;
+    for (int i = 0; i <= parts; ++i) {
+        bounds.append(int(qint64(count) * i / parts));
+    }
+    
+    // Take the data pointer once; the worker threads must not detach the list
+    int *data = indices.data();
+    
+    QList<int> slices(parts);
+    std::iota(slices.begin(), slices.end(), 0);
+    QtConcurrent::blockingMap(slices, [&](const int &slice) {
+        std::sort(data + bounds[slice], data + bounds[slice + 1], less);
+    });
+    
+    for (int width = 1; width < parts; width *= 2) {
+        QList<int> merges;
+        for (int slice = 0; slice + width < parts; slice += 2 * width) {
+            merges.append(slice);
+        }
+        QtConcurrent::blockingMap(merges, [&](const int &slice) {
+            std::inplace_merge(data + bounds[slice], data + bounds[slice + width],
+                               data + bounds[qMin(slice + 2 * width, parts)], less);
+        });
+    }
+}
+
+// Sort by natural collation of a string derived from each entry index
+template <typename KeyText>
+QList<int> sortByCollation(const EntryStore &files, Qt::SortOrder direction, KeyText keyText)
+{
+    const int count = int(files.size());
+    
+    // QCollatorSortKey has no default constructor, so keys are kept per chunk
+    QList<QList<QCollatorSortKey>> chunkKeys((count + ChunkSize - 1) / ChunkSize);
+    QList<QCollatorSortKey> *chunkData = chunkKeys.data();
+    forEachChunk(count, [&](int begin, int end) {
+        // QCollator is not safe to share between threads; one per chunk is cheap enough
+        QCollator collator;
+        collator.setNumericMode(true);
+        collator.setCaseSensitivity(Qt::CaseInsensitive);
+        
+        QList<QCollatorSortKey> &keys = chunkData[begin / ChunkSize];
+        keys.reserve(end - begin);
+        for (int i = begin; i < end; ++i) {
+            keys.append(collator.sortKey(keyText(i)));
+        }
+    });
+    
+    const QList<QList<QCollatorSortKey>> &constKeys = chunkKeys;
+    auto key = [&constKeys](int index) -> const QCollatorSortKey & {
+        return constKeys[index / ChunkSize][index % ChunkSize];
+    };
+    
+    QList<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    parallelSort(indices, [&key, direction](int a, int b) {
+        const int result = key(a).compare(key(b));
+        if (result != 0) {
+            return direction == Qt::AscendingOrder ? result < 0 : result > 0;
+        }
+        return a < b;
+    });
+    return indices;
+}
+
+// Sort by an integer value derived from each entry index
+template <typename KeyValue>
+QList<int> sortByValue(const EntryStore &files, Qt::SortOrder direction, KeyValue keyValue)
+{
+    const int count = int(files.size());
+    
+    QList<qint64> keys(count);
+    qint64 *keyData = keys.data();
+    forEachChunk(count, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            keyData[i] = keyValue(i);
+        }
+    });
+    
+    QList<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    parallelSort(indices, [keyData, direction](int a, int b) {
+        if (keyData[a] != keyData[b]) {
+            return direction == Qt::AscendingOrder ? keyData[a] < keyData[b] : keyData[a] > keyData[b];
+        }
+        return a < b;
+    });
+    return indices;
+}
+
+// Extension of a file name as a hash key; extensions group case-insensitively.
+// The view points into the name column of the store being numbered.
+struct ExtensionKey {
+    QStringView text;
+    
+    bool operator==(const ExtensionKey &other) const
+    {
+        return text.compare(other.text, Qt::CaseInsensitive) == 0;
+    }
+};
+
+size_t qHash(const ExtensionKey &key, size_t seed = 0)
+{
+    // Case-folded like the comparison; surrogates are left out, which keeps equal keys
+    // hashing equally without folding pairs
+    size_t hash = seed ^ size_t(key.text.size());
+    for (const QChar c : key.text) {
+        if (!c.isSurrogate()) {
+            hash = hash * 31 + c.toCaseFolded().unicode();
+        }
+    }
+    return hash;
+}
+    
+ExtensionKey extensionKey(QStringView name)
+{
+    // Dotfiles (like .bashrc) have no extension
+    const qsizetype dotIndex = name.lastIndexOf(u'.');
+    return ExtensionKey{dotIndex > 0 ? name.mid(dotIndex + 1) : QStringView()};
+}
+
+// Intern the extension of every entry as an int id. Chunks intern into local tables
+// in parallel; the distinct extensions of each chunk are then mapped to global ids.
+QList<int> extensionIds(const EntryStore &files)
+{
+    const int count = int(files.size());
+    QList<int> ids(count);
+    int *idData = ids.data();
+    
+    QList<QHash<ExtensionKey, int>> chunkTables((count + ChunkSize - 1) / ChunkSize);
+    QHash<ExtensionKey, int> *tableData = chunkTables.data();
+    const StringColumn &names = files.originalNameColumn();
+    forEachChunk(count, [&](int begin, int end) {
+        QHash<ExtensionKey, int> &table = tableData[begin / ChunkSize];
+        for (int i = begin; i < end; ++i) {
+            const ExtensionKey key = extensionKey(names.at(i));
+            auto it = table.find(key);
+            if (it == table.end()) {
+                it = table.insert(key, int(table.size()));
+            }
+            idData[i] = it.value();
+        }
+    });
+    
+    // Only touches distinct extensions per chunk, not rows
+    QHash<ExtensionKey, int> globalTable;
+    QList<QList<int>> localToGlobal(chunkTables.size());
+    for (qsizetype chunk = 0; chunk < chunkTables.size(); ++chunk) {
+        const QHash<ExtensionKey, int> &table = chunkTables.at(chunk);
+        QList<int> &mapping = localToGlobal[chunk];
+        mapping.resize(table.size());
+        for (auto it = table.cbegin(); it != table.cend(); ++it) {
+            auto global = globalTable.find(it.key());
+            if (global == globalTable.end()) {
+                global = globalTable.insert(it.key(), int(globalTable.size()));
+            }
+            mapping[it.value()] = global.value();
+        }
+    }
+    
+    const QList<QList<int>> &constMapping = localToGlobal;
+    forEachChunk(count, [&](int begin, int end) {
+        const QList<int> &mapping = constMapping[begin / ChunkSize];
+        for (int i = begin; i < end; ++i) {
+            idData[i] = mapping[idData[i]];
+        }
+    });
+    return ids;
+}
+
+// Combined group of the per-directory-and-extension counter
+qint64 directoryExtensionKey(int directoryId, int extensionId)
+{
+    return (qint64(directoryId) << 32) | quint32(extensionId);
+}
+
+} // namespace
+
+QList<int> FileOrdering::compute(const EntryStore &files, NumberingOrder order,
+                                 Qt::SortOrder direction)
+{
+    switch (order) {
+        case NumberingOrder::Name:
+            return sortByCollation(files, direction, [&files](int i) {
+                return files.originalName(i);
+            });
+        case NumberingOrder::Path:
+            return sortByCollation(files, direction, [&files](int i) {
+                return files.fullPath(i);
+            });
+        case NumberingOrder::Modified:
+            return sortByValue(files, direction, [&files](int i) {
+                // Metadata from ingestion; only entries without it are stat'ed here
+                const FileMetadata metadata = files.metadata(i).isValid()
+                    ? files.metadata(i) : FileMetadata::read(files.fullPath(i));
+                return metadata.modified;
+            });
+        case NumberingOrder::Size:
+            return sortByValue(files, direction, [&files](int i) {
+                const FileMetadata metadata = files.metadata(i).isValid()
+                    ? files.metadata(i) : FileMetadata::read(files.fullPath(i));
+                return metadata.size;
+            });
+        case NumberingOrder::Added:
+            break;
+    }
+    
+    QList<int> indices(files.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    if (direction == Qt::DescendingOrder) {
+        std::reverse(indices.begin(), indices.end());
+    }
+    return indices;
+}
+
+Numbering FileOrdering::computeNumbering(const EntryStore &files, NumberingOrder order,
+                                         Qt::SortOrder direction, bool withScoped)
+{
+    Numbering numbering;
+    numbering.order = compute(files, order, direction);
+    if (withScoped) {
+        numbering.scoped = computeScoped(files, numbering.order);
+    }
+    return numbering;
+}
+
+ScopedNumbering FileOrdering::computeScoped(const EntryStore &files, const QList<int> &order)
+{
+    const int count = int(order.size());
+    const int chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    
+    ScopedNumbering numbering;
+    numbering.directoryIndex.resize(count);
+    numbering.extensionIndex.resize(count);
+    numbering.directoryExtensionIndex.resize(count);
+    int *directoryIndex = numbering.directoryIndex.data();
+    int *extensionIndex = numbering.extensionIndex.data();
+    int *directoryExtensionIndex = numbering.directoryExtensionIndex.data();
+    
+    // Groups are ints: the store's directory ids and interned extension ids
+    const QList<int> extensions = extensionIds(files);
+    
+    // Per chunk: group counts and, after the prefix sum, the offset of each group
+    struct ChunkCounts {
+        QHash<int, int> directory;
+        QHash<int, int> extension;
+        QHash<qint64, int> directoryExtension;
+    };
+    QList<ChunkCounts> chunks(chunkCount);
+    ChunkCounts *chunkData = chunks.data();
+    
+    // Pass 1: local index of every row within its group inside the chunk
+    forEachChunk(count, [&](int begin, int end) {
+        ChunkCounts &counts = chunkData[begin / ChunkSize];
+        for (int row = begin; row < end; ++row) {
+            const int entryIndex = order[row];
+            const int directoryId = files.directoryId(entryIndex);
+            const int extensionId = extensions[entryIndex];
+            directoryIndex[entryIndex] = counts.directory[directoryId]++;
+            extensionIndex[entryIndex] = counts.extension[extensionId]++;
+            directoryExtensionIndex[entryIndex] =
+                counts.directoryExtension[directoryExtensionKey(directoryId, extensionId)]++;
+        }
+    });
+    
+    // Exclusive prefix sum over chunks per group; counts become chunk offsets
+    // (only touches distinct groups per chunk, not rows)
+    auto prefixSum = [&chunks](auto member) {
+        std::decay_t<decltype(chunks.first().*member)> totals;
+        for (ChunkCounts &chunk : chunks) {
+            for (auto it = (chunk.*member).begin(); it != (chunk.*member).end(); ++it) {
+                int &total = totals[it.key()];
+                const int chunkTotal = it.value();
+                it.value() = total;
+                total += chunkTotal;
+            }
+        }
+    };
+    prefixSum(&ChunkCounts::directory);
+    prefixSum(&ChunkCounts::extension);
+    prefixSum(&ChunkCounts::directoryExtension);
+    
+    // Pass 2: add the chunk offsets
+    forEachChunk(count, [&](int begin, int end) {
+        const ChunkCounts &offsets = chunkData[begin / ChunkSize];
+        if (begin == 0) {
+            return;  // The first chunk has no offsets
+        }
+        for (int row = begin; row < end; ++row) {
+            const int entryIndex = order[row];
+            const int directoryId = files.directoryId(entryIndex);
+            const int extensionId = extensions[entryIndex];
+            directoryIndex[entryIndex] += offsets.directory.value(directoryId);
+            extensionIndex[entryIndex] += offsets.extension.value(extensionId);
+            directoryExtensionIndex[entryIndex] +=
+                offsets.directoryExtension.value(directoryExtensionKey(directoryId, extensionId));
+        }
+    });
+    
+    return numbering;
+}
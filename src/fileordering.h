@@ -0,0 +1,80 @@
+#ifndef FILEORDERING_H
+#define FILEORDERING_H
+
+#include <QList>
+#include <QtGlobal>
+
+class EntryStore;
+
+/**
+ * @brief Order in which files are numbered (and displayed).
+ */
+enum class NumberingOrder {
+    Added,     // Order in which files were added
+    Name,      // Natural sort on file name ("img2" before "img10")
+    Path,      // Natural sort on full path
+    Modified,  // Last modification time
+    Size       // File size
+};
+
+/**
+ * @brief Per-entry indices for counters that restart per directory and/or extension.
+ */
+struct ScopedNumbering {
+    QList<int> directoryIndex;
+    QList<int> extensionIndex;
+    QList<int> directoryExtensionIndex;
+};
+
+/**
+ * @brief A numbering order together with the scoped indices along it.
+ */
+struct Numbering {
+    QList<int> order;       // Entry indices in numbering order
+    ScopedNumbering scoped; // Empty unless requested
+};
+
+/**
+ * @brief Computes numbering orders for large file lists.
+ *
+ * Sort keys (collation keys, timestamps, sizes) are computed once per file in
+ * parallel chunks, so the comparator only compares precomputed keys. The sort
+ * itself runs as parallel slice sorts followed by pairwise merges.
+ */
+class FileOrdering
+{
+public:
+    /**
+     * @brief Compute the order of the given files.
+     * @param files The files to order
+     * @param order The sort criterion
+     * @param direction Ascending or descending; ties always keep the added order
+     * @return Entry indices in numbering order
+     */
+    static QList<int> compute(const EntryStore &files, NumberingOrder order,
+                              Qt::SortOrder direction);
+    
+    /**
+     * @brief Compute the order and, if requested, the scoped indices along it.
+     * @param files The files to order
+     * @param order The sort criterion
+     * @param direction Ascending or descending
+     * @param withScoped Also compute the per-directory and per-extension indices
+     */
+    static Numbering computeNumbering(const EntryStore &files, NumberingOrder order,
+                                      Qt::SortOrder direction, bool withScoped);
+    
+    /**
+     * @brief Compute per-directory and per-extension indices along a numbering order.
+     * 
+     * Groups are directory ids and interned extension ids, so no per-row keys are built.
+     * Runs as one parallel pass over chunks of the order (local counts per group),
+     * a prefix sum of the chunk counts per group, and a parallel fix-up pass.
+     * @param files The files to number
+     * @param order Entry indices in numbering order
+     * @return Indices per entry for each counter scope
+     */
+    static ScopedNumbering computeScoped(const EntryStore &files, const QList<int> &order);
+};
+
+#endif // FILEORDERING_H
@@ -0,0 +1,271 @@
+#include "iouring.h"
+
+#ifdef REGEX_RENAME_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+// No liburing: the three system calls are used directly
+int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+template <typename T>
+T *at(void *base, unsigned offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int ringFd = ioUringSetup(entries, &params);
+    if (ringFd < 0) {
+        return;
+    }
+    
+    // With IORING_FEAT_SINGLE_MMAP both rings share one mapping
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+    }
+    
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        ::close(ringFd);
+        return;
+    }
+    if (singleMap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            munmap(sqRing, sqRingSize);
+            sqRing = nullptr;
+            ::close(ringFd);
+            return;
+        }
+    }
+    
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = nullptr;
+        if (cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        munmap(sqRing, sqRingSize);
+        sqRing = cqRing = nullptr;
+        ::close(ringFd);
+        return;
+    }
+    
+    sqHead = at<unsigned>(sqRing, params.sq_off.head);
+    sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqArray = at<unsigned>(sqRing, params.sq_off.array);
+    cqHead = at<unsigned>(cqRing, params.cq_off.head);
+    cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = at<void>(cqRing, params.cq_off.cqes);
+    sqEntries = params.sq_entries;
+    fd = ringFd;
+    
+    // Which opcodes this kernel implements
+    const size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    auto *probe = static_cast<io_uring_probe *>(std::calloc(1, probeSize));
+    if (probe && ioUringRegister(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        for (unsigned op = 0; op <= probe->last_op && op < 256; ++op) {
+            supported[op] = (probe->ops[op].flags & IO_URING_OP_SUPPORTED) ? 1 : 0;
+        }
+    }
+    std::free(probe);
+}
+
+IoUring::~IoUring()
+{
+    if (fd < 0) {
+        return;
+    }
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    munmap(sqRing, sqRingSize);
+    ::close(fd);
+}
+
+bool IoUring::supports(int opcode) const
+{
+    return fd >= 0 && opcode >= 0 && opcode < 256 && supported[opcode];
+}
+
+unsigned IoUring::freeEntries() const
+{
+    if (fd < 0) {
+        return 0;
+    }
+    const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    return sqEntries - (*sqTail - head);
+}
+
+io_uring_sqe *IoUring::nextEntry()
+{
+    if (freeEntries() == 0) {
+        return nullptr;
+    }
+    const unsigned tail = *sqTail;
+    const unsigned index = tail & *sqMask;
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    return sqe;
+}
+
+bool IoUring::prepareRename(const char *from, const char *to, unsigned flags, quint64 userData,
+                            bool link)
+{
+    io_uring_sqe *sqe = nextEntry();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RENAMEAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<quint64>(from);
+    sqe->len = unsigned(AT_FDCWD);
+    sqe->addr2 = reinterpret_cast<quint64>(to);
+    sqe->rename_flags = flags;
+    sqe->user_data = userData;
+    if (link) {
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+    
+    // Publish the entry; the kernel reads the tail with acquire semantics
+    __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+    ++pendingSubmit;
+    return true;
+}
+
+bool IoUring::prepareStatx(const char *path, int flags, unsigned mask, void *buffer, quint64 userData)
+{
+    io_uring_sqe *sqe = nextEntry();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<quint64>(path);
+    sqe->len = mask;
+    sqe->off = reinterpret_cast<quint64>(buffer);
+    sqe->statx_flags = unsigned(flags);
+    sqe->user_data = userData;
+    
+    __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+    ++pendingSubmit;
+    return true;
+}
+
+bool IoUring::submit(unsigned waitFor)
+{
+    if (fd < 0) {
+        return false;
+    }
+    while (true) {
+        const int submitted = ioUringEnter(fd, pendingSubmit, waitFor,
+                                           waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted >= 0) {
+            pendingSubmit -= qMin(pendingSubmit, unsigned(submitted));
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+bool IoUring::nextCompletion(quint64 &userData, int &result)
+{
+    if (fd < 0) {
+        return false;
+    }
+    const unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const io_uring_cqe &cqe = static_cast<const io_uring_cqe *>(cqes)[head & *cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#else
+
+IoUring::IoUring(unsigned entries)
+{
+    Q_UNUSED(entries);
+}
+
+IoUring::~IoUring()
+{
+}
+
+bool IoUring::supports(int opcode) const
+{
+    Q_UNUSED(opcode);
+    return false;
+}
+
+unsigned IoUring::freeEntries() const
+{
+    return 0;
+}
+
+bool IoUring::prepareRename(const char *, const char *, unsigned, quint64, bool)
+{
+    return false;
+}
+
+bool IoUring::prepareStatx(const char *, int, unsigned, void *, quint64)
+{
+    return false;
+}
+
+bool IoUring::submit(unsigned)
+{
+    return false;
+}
+
+bool IoUring::nextCompletion(quint64 &, int &)
+{
+    return false;
+}
+
+#endif
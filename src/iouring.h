@@ -0,0 +1,110 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// IORING_OP_RENAMEAT and IORING_OP_STATX are enum values; this flag arrived with
+// the same headers (5.12) and tells whether they can be used at all
+#ifdef IORING_FEAT_NATIVE_WORKERS
+#define REGEX_RENAME_HAVE_IO_URING 1
+#endif
+#endif
+
+/**
+ * @brief Minimal io_uring submission/completion ring, set up with raw system calls.
+ *
+ * Only the operations the batch backends need are wrapped. Entries are queued
+ * with the prepare functions, handed to the kernel with submit(), and their
+ * results collected with nextCompletion(); the caller identifies them by the
+ * user data it passed in. On systems without io_uring (old kernels, other
+ * platforms, or io_uring disabled by policy) isValid() is false and nothing
+ * can be queued, so callers fall back to their thread pool path.
+ */
+class IoUring
+{
+public:
+    /**
+     * @param entries Submission queue size (rounded up to a power of two by the kernel)
+     */
+    explicit IoUring(unsigned entries = 256);
+    ~IoUring();
+    
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+    
+    bool isValid() const { return fd >= 0; }
+    
+    /**
+     * @brief Check whether the kernel implements an opcode (IORING_OP_*).
+     */
+    bool supports(int opcode) const;
+    
+    /**
+     * @brief Number of entries that can still be queued before the next submit().
+     */
+    unsigned freeEntries() const;
+    
+    /**
+     * @brief Capacity of the submission queue.
+     */
+    unsigned capacity() const { return sqEntries; }
+    
+    /**
+     * @brief Queue renameat2(AT_FDCWD, from, AT_FDCWD, to, flags).
+     * @param link Start the next queued entry only after this one succeeded
+     *             (IOSQE_IO_LINK); if it fails, the next one completes with -ECANCELED
+     * @return False if the queue is full
+     */
+    bool prepareRename(const char *from, const char *to, unsigned flags, quint64 userData,
+                       bool link = false);
+    
+    /**
+     * @brief Queue statx(AT_FDCWD, path, flags, mask, buffer); buffer is a struct statx.
+     * @return False if the queue is full
+     */
+    bool prepareStatx(const char *path, int flags, unsigned mask, void *buffer, quint64 userData);
+    
+    /**
+     * @brief Hand the queued entries to the kernel.
+     * @param waitFor Block until at least this many completions are available
+     * @return False on a submission error
+     */
+    bool submit(unsigned waitFor = 0);
+    
+    /**
+     * @brief Take the next completion, if any.
+     * @param userData Receives the user data of the completed entry
+     * @param result Receives the result (negative errno on failure)
+     */
+    bool nextCompletion(quint64 &userData, int &result);
+    
+private:
+#ifdef REGEX_RENAME_HAVE_IO_URING
+    io_uring_sqe *nextEntry();
+#endif
+
+    int fd = -1;
+    unsigned sqEntries = 0;
+    unsigned pendingSubmit = 0;    // Queued but not yet handed to the kernel
+    unsigned char supported[256] = {};
+    
+    // Shared ring memory
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    void *sqes = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    void *cqes = nullptr;
+};
+
+#endif // IOURING_H
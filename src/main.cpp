@@ -1,10 +1,34 @@
 #include <QApplication>
 #include <QFile>
+#include <QCommandLineParser>
+#include <cstring>
 #include "mainwindow.h"
+#include "entrystore.h"
+#include "filenamecodec.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
+    QApplication::setApplicationName("regex-rename");
+    QApplication::setApplicationVersion("1.0.0");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Batch file renamer");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption presetOption("preset", "Load the operation chain from a preset file.", "file");
+    parser.addOption(presetOption);
+    QCommandLineOption sessionOption("session", "Open a saved session.", "file");
+    parser.addOption(sessionOption);
+    QCommandLineOption memoryBudgetOption("memory-budget",
+                                          "Memory for file names in MiB; beyond it names are kept in "
+                                          "a memory-mapped spill file.", "MiB");
+    parser.addOption(memoryBudgetOption);
+    QCommandLineOption spillDirOption("spill-dir", "Folder for the spill file (cache folder by default).",
+                                      "directory");
+    parser.addOption(spillDirOption);
+    parser.addPositionalArgument("files", "Files to add to the list.", "[files...]");
+    parser.process(app);
     
     // Load global stylesheet
     QFile styleFile(":/resource/style.qss");
@@ -16,7 +40,38 @@ int main(int argc, char *argv[])
     
     MainWindow window;
     window.resize(1200, 700);
+    if (parser.isSet(memoryBudgetOption) || parser.isSet(spillDirOption)) {
+        const qint64 budget = parser.isSet(memoryBudgetOption)
+            ? qMax<qint64>(parser.value(memoryBudgetOption).toLongLong(), 1) << 20
+            : EntryStore::DefaultMemoryBudget;
+        window.setMemoryBudget(budget, parser.value(spillDirOption));
+    }
     window.show();
     
+    if (parser.isSet(sessionOption)) {
+        window.openSession(parser.value(sessionOption));
+    }
+    if (parser.isSet(presetOption)) {
+        window.loadPreset(parser.value(presetOption));
+    }
+    if (!parser.positionalArguments().isEmpty()) {
+        QStringList filePaths = parser.positionalArguments();
+#ifdef Q_OS_UNIX
+        // The parsed arguments have invalid UTF-8 replaced; take the exact bytes
+        // from argv, where the positional arguments appear in the same order
+        int next = 1;
+        for (QString &path : filePaths) {
+            for (; next < argc; ++next) {
+                if (QString::fromLocal8Bit(argv[next]) == path) {
+                    path = FileNameCodec::decode(argv[next], qsizetype(std::strlen(argv[next])));
+                    ++next;
+                    break;
+                }
+            }
+        }
+#endif
+        window.addFiles(filePaths);
+    }
+    
     return app.exec();
 }
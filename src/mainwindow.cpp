@@ -1,9 +1,14 @@
 #include "mainwindow.h"
 #include "operationlistwidget.h"
 #include "filelistwidget.h"
+#include "preset.h"
+#include "previewscheduler.h"
+#include "session.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QVBoxLayout>
+#include <QApplication>
+#include <QFileInfo>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -33,11 +38,38 @@ void MainWindow::setupMenuBar()
     
     fileMenu->addSeparator();
     
+    QAction *loadPresetAction = new QAction(tr("&Load Preset..."), this);
+    loadPresetAction->setShortcut(QKeySequence(tr("Ctrl+L")));
+    connect(loadPresetAction, &QAction::triggered, this, &MainWindow::onLoadPreset);
+    fileMenu->addAction(loadPresetAction);
+    
+    QAction *savePresetAction = new QAction(tr("&Save Preset..."), this);
+    savePresetAction->setShortcut(QKeySequence::Save);
+    connect(savePresetAction, &QAction::triggered, this, &MainWindow::onSavePreset);
+    fileMenu->addAction(savePresetAction);
+    
+    fileMenu->addSeparator();
+    
+    QAction *openSessionAction = new QAction(tr("Open Sess&ion..."), this);
+    connect(openSessionAction, &QAction::triggered, this, &MainWindow::onOpenSession);
+    fileMenu->addAction(openSessionAction);
+    
+    QAction *saveSessionAction = new QAction(tr("Save Session..."), this);
+    connect(saveSessionAction, &QAction::triggered, this, &MainWindow::onSaveSession);
+    fileMenu->addAction(saveSessionAction);
+    
+    fileMenu->addSeparator();
+    
     QAction *applyAction = new QAction(tr("&Apply Rename"), this);
     applyAction->setShortcut(QKeySequence(tr("Ctrl+R")));
     connect(applyAction, &QAction::triggered, this, &MainWindow::onApplyRename);
     fileMenu->addAction(applyAction);
     
+    QAction *dryRunAction = new QAction(tr("&Dry Run..."), this);
+    dryRunAction->setShortcut(QKeySequence(tr("Ctrl+Shift+R")));
+    connect(dryRunAction, &QAction::triggered, this, &MainWindow::onDryRun);
+    fileMenu->addAction(dryRunAction);
+    
     fileMenu->addSeparator();
     
     QAction *exitAction = new QAction(tr("E&xit"), this);
@@ -71,9 +103,16 @@ void MainWindow::setupUI()
     
     setCentralWidget(splitter);
     
-    // Connect operations changes to preview updates
-    connect(operationList, &OperationListWidget::operationsChanged, 
+    // Operation edits go through the scheduler, which updates immediately for cheap
+    // previews and coalesces edits for expensive ones; file list changes update directly
+    previewScheduler = new PreviewScheduler(this);
+    connect(operationList, &OperationListWidget::operationsChanged, this, [this]() {
+        previewScheduler->schedule(fileList->fileCount());
+    });
+    connect(previewScheduler, &PreviewScheduler::updateRequested,
             this, &MainWindow::updatePreviews);
+    connect(fileList, &FileListWidget::previewCostMeasured,
+            previewScheduler, &PreviewScheduler::recordCost);
     connect(fileList, &FileListWidget::filesChanged,
             this, &MainWindow::updatePreviews);
     
@@ -96,6 +135,11 @@ void MainWindow::onAddFiles()
     }
 }
 
+void MainWindow::addFiles(const QStringList &filePaths)
+{
+    fileList->addFiles(filePaths);
+}
+
 void MainWindow::onClearFiles()
 {
     fileList->clearFiles();
@@ -118,6 +162,142 @@ void MainWindow::onApplyRename()
     }
 }
 
+void MainWindow::onDryRun()
+{
+    // Lists the affected folders and probes the target file system; can take a moment
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString details;
+    const QString summary = fileList->dryRun(&details);
+    QApplication::restoreOverrideCursor();
+    
+    QMessageBox box(QMessageBox::Information, tr("Dry Run"), summary, QMessageBox::Ok, this);
+    if (!details.isEmpty()) {
+        box.setIcon(QMessageBox::Warning);
+        box.setDetailedText(details);
+    }
+    box.exec();
+}
+
+void MainWindow::onLoadPreset()
+{
+    QString filePath = QFileDialog::getOpenFileName(
+        this,
+        tr("Load Preset"),
+        QString(),
+        tr("Presets (*.json *.cbor);;All Files (*)")
+    );
+    
+    if (!filePath.isEmpty()) {
+        loadPreset(filePath);
+    }
+}
+
+bool MainWindow::loadPreset(const QString &filePath)
+{
+    QList<OperationSpec> specs;
+    QString errorMessage;
+    if (!Preset::load(filePath, specs, errorMessage)) {
+        QMessageBox::warning(this, tr("Load Preset"),
+                             tr("Could not load preset '%1':\n%2").arg(filePath, errorMessage));
+        return false;
+    }
+    
+    operationList->setOperationSpecs(specs);
+    return true;
+}
+
+void MainWindow::onSavePreset()
+{
+    QString filePath = QFileDialog::getSaveFileName(
+        this,
+        tr("Save Preset"),
+        QString(),
+        tr("JSON Preset (*.json);;Binary Preset (*.cbor)")
+    );
+    
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    QString errorMessage;
+    if (!Preset::save(filePath, operationList->getOperationSpecs(), errorMessage)) {
+        QMessageBox::warning(this, tr("Save Preset"),
+                             tr("Could not save preset '%1':\n%2").arg(filePath, errorMessage));
+    }
+}
+
+void MainWindow::onOpenSession()
+{
+    QString filePath = QFileDialog::getOpenFileName(
+        this,
+        tr("Open Session"),
+        QString(),
+        tr("Sessions (*.rrsession);;All Files (*)")
+    );
+    
+    if (!filePath.isEmpty()) {
+        openSession(filePath);
+    }
+}
+
+bool MainWindow::openSession(const QString &filePath)
+{
+    // Load with the list's memory budget, so large sessions spill while loading
+    SessionData data;
+    data.files.setSpillDirectory(fileList->spillDirectory());
+    data.files.setMemoryBudget(fileList->memoryBudget());
+    QString errorMessage;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool loaded = Session::load(filePath, data, errorMessage);
+    QApplication::restoreOverrideCursor();
+    
+    if (!loaded) {
+        QMessageBox::warning(this, tr("Open Session"),
+                             tr("Could not open session '%1':\n%2").arg(filePath, errorMessage));
+        return false;
+    }
+    
+    operationList->setOperationSpecs(data.operations);
+    fileList->importSession(data);
+    return true;
+}
+
+void MainWindow::setMemoryBudget(qint64 bytes, const QString &spillDirectory)
+{
+    fileList->setMemoryBudget(bytes, spillDirectory);
+}
+
+void MainWindow::onSaveSession()
+{
+    QString filePath = QFileDialog::getSaveFileName(
+        this,
+        tr("Save Session"),
+        QString(),
+        tr("Sessions (*.rrsession)")
+    );
+    
+    if (filePath.isEmpty()) {
+        return;
+    }
+    if (QFileInfo(filePath).suffix().isEmpty()) {
+        filePath += ".rrsession";
+    }
+    
+    SessionData data;
+    fileList->exportSession(data);
+    data.operations = operationList->getOperationSpecs();
+    
+    QString errorMessage;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool saved = Session::save(filePath, data, errorMessage);
+    QApplication::restoreOverrideCursor();
+    
+    if (!saved) {
+        QMessageBox::warning(this, tr("Save Session"),
+                             tr("Could not save session '%1':\n%2").arg(filePath, errorMessage));
+    }
+}
+
 void MainWindow::onAbout()
 {
     QMessageBox::about(this, tr("About Regex Rename"),
@@ -129,6 +309,11 @@ void MainWindow::onAbout()
 
 void MainWindow::updatePreviews()
 {
+    // Cards build their operations in the background; one that is not done yet
+    // triggers another update when it is
+    if (!operationList->isReady()) {
+        return;
+    }
     QList<std::shared_ptr<Operation>> operations = operationList->getOperations();
     fileList->updatePreviews(operations);
 }
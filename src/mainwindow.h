@@ -9,6 +9,7 @@
 
 class OperationListWidget;
 class FileListWidget;
+class PreviewScheduler;
 
 class MainWindow : public QMainWindow
 {
@@ -17,11 +18,25 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
-
+    
+    bool loadPreset(const QString &filePath);
+    bool openSession(const QString &filePath);
+    void addFiles(const QStringList &filePaths);
+
+    /**
+     * @brief Limit the memory used by file names (see FileListWidget::setMemoryBudget()).
+     */
+    void setMemoryBudget(qint64 bytes, const QString &spillDirectory = QString());
+    
 private slots:
     void onAddFiles();
     void onClearFiles();
     void onApplyRename();
+    void onDryRun();
+    void onLoadPreset();
+    void onSavePreset();
+    void onOpenSession();
+    void onSaveSession();
     void onAbout();
 
 private:
@@ -32,6 +47,7 @@ private:
     QSplitter *splitter;
     OperationListWidget *operationList;
     FileListWidget *fileList;
+    PreviewScheduler *previewScheduler;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,177 @@
+#include "namediffdelegate.h"
+#include "filelistmodel.h"
+#include "filelistwidget.h"
+#include <QPainter>
+#include <QApplication>
+#include <QFontMetrics>
+
+namespace {
+
+// Larger middle parts are marked as one changed span instead of diffed
+constexpr qsizetype MaxDiffCells = 256 * 256;
+
+// Bound for the cache; scrolling through a huge list should not keep every row
+constexpr int MaxCachedEntries = 4096;
+
+const QColor ChangedBackground(0, 160, 0, 48);
+
+} // namespace
+
+NameDiffDelegate::NameDiffDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+QList<NameDiffDelegate::Span> NameDiffDelegate::changedSpans(const QString &from, const QString &to)
+{
+    // Common prefix and suffix first; most renames only touch a small part of the name
+    const qsizetype common = qMin(from.size(), to.size());
+    qsizetype prefix = 0;
+    while (prefix < common && from.at(prefix) == to.at(prefix)) {
+        ++prefix;
+    }
+    qsizetype suffix = 0;
+    while (suffix < common - prefix
+           && from.at(from.size() - 1 - suffix) == to.at(to.size() - 1 - suffix)) {
+        ++suffix;
+    }
+    
+    const qsizetype m = from.size() - prefix - suffix;
+    const qsizetype n = to.size() - prefix - suffix;
+    QList<Span> spans;
+    if (n == 0) {
+        return spans;
+    }
+    if (m == 0 || m * n > MaxDiffCells) {
+        spans.append({int(prefix), int(n)});
+        return spans;
+    }
+    
+    // Longest common subsequence of the middle parts; characters of the new name
+    // outside of it are the changed ones
+    const QChar *a = from.constData() + prefix;
+    const QChar *b = to.constData() + prefix;
+    QList<quint16> table((m + 1) * (n + 1), 0);
+    auto length = [&table, n](qsizetype i, qsizetype j) -> quint16 & {
+        return table[i * (n + 1) + j];
+    };
+    for (qsizetype i = m - 1; i >= 0; --i) {
+        for (qsizetype j = n - 1; j >= 0; --j) {
+            length(i, j) = a[i] == b[j] ? quint16(length(i + 1, j + 1) + 1)
+                                        : qMax(length(i + 1, j), length(i, j + 1));
+        }
+    }
+    
+    auto markChanged = [&spans](int position) {
+        if (!spans.isEmpty() && spans.last().start + spans.last().length == position) {
+            ++spans.last().length;
+        } else {
+            spans.append({position, 1});
+        }
+    };
+    qsizetype i = 0;
+    qsizetype j = 0;
+    while (j < n) {
+        if (i < m && a[i] == b[j]) {
+            ++i;
+            ++j;
+        } else if (i < m && length(i + 1, j) >= length(i, j + 1)) {
+            ++i;
+        } else {
+            markChanged(int(prefix + j));
+            ++j;
+        }
+    }
+    
+    // Never split a surrogate pair between a changed and an unchanged span
+    for (Span &span : spans) {
+        if (span.start > 0 && to.at(span.start).isLowSurrogate()) {
+            --span.start;
+            ++span.length;
+        }
+        const int end = span.start + span.length;
+        if (end < to.size() && to.at(end - 1).isHighSurrogate()) {
+            ++span.length;
+        }
+    }
+    return spans;
+}
+
+void NameDiffDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                             const QModelIndex &index) const
+{
+    const auto *fileModel = qobject_cast<const FileListModel *>(index.model());
+    if (!fileModel || !index.isValid()) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+    
+    const EntryStore &files = fileModel->store();
+    const int entryIndex = fileModel->entryIndex(index.row());
+    const QString originalName = files.originalName(entryIndex);
+    const QString newName = files.newName(entryIndex);
+    if (files.previewState(entryIndex) != EntryStore::PreviewReady || newName == originalName) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+    
+    // Spans of the current generation only; a new preview pass invalidates all of them
+    if (cacheGeneration != fileModel->generation() || spanCache.size() > MaxCachedEntries) {
+        spanCache.clear();
+        cacheGeneration = fileModel->generation();
+    }
+    auto cached = spanCache.constFind(entryIndex);
+    if (cached == spanCache.constEnd()) {
+        cached = spanCache.insert(entryIndex, changedSpans(originalName, newName));
+    }
+    const QList<Span> &spans = *cached;
+    
+    // Background, selection and focus from the style, then the text in segments
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+    const QWidget *widget = opt.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    const int margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+    const QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget)
+                               .adjusted(margin, 0, -margin, 0);
+    const QString text = opt.text;
+    opt.text.clear();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+    
+    const bool selected = opt.state & QStyle::State_Selected;
+    const QColor textColor = opt.palette.color(selected ? QPalette::HighlightedText : QPalette::Text);
+    QFont plainFont = opt.font;
+    plainFont.setBold(false);
+    QFont changedFont = opt.font;
+    changedFont.setBold(true);
+    
+    painter->save();
+    painter->setClipRect(textRect);
+    painter->setPen(textColor);
+    int x = textRect.left();
+    auto drawSegment = [&](int start, int count, bool changed) {
+        if (count <= 0 || x > textRect.right()) {
+            return;
+        }
+        const QString part = text.mid(start, count);
+        const QFont &font = changed ? changedFont : plainFont;
+        const int width = QFontMetrics(font).horizontalAdvance(part);
+        const QRect rect(x, textRect.top(), width, textRect.height());
+        if (changed && !selected) {
+            painter->fillRect(rect.adjusted(0, 1, 0, -1), ChangedBackground);
+        }
+        painter->setFont(font);
+        painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine, part);
+        x += width;
+    };
+    
+    int position = 0;
+    for (const Span &span : spans) {
+        const int start = qMax(span.start, position);
+        drawSegment(position, start - position, false);
+        drawSegment(start, span.start + span.length - start, true);
+        position = qMax(position, span.start + span.length);
+    }
+    drawSegment(position, int(text.size()) - position, false);
+    painter->restore();
+}
@@ -0,0 +1,43 @@
+#ifndef NAMEDIFFDELEGATE_H
+#define NAMEDIFFDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QHash>
+#include <QList>
+
+/**
+ * @brief Paints the new name with the changed character spans highlighted.
+ *
+ * The spans are computed while painting, so only rows that are actually shown
+ * pay for them, and are cached per entry until the model's name generation
+ * changes. Rows that are unchanged or still pending use the default painting.
+ */
+class NameDiffDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    struct Span {
+        int start;   // Position in the new name
+        int length;
+    };
+    
+    explicit NameDiffDelegate(QObject *parent = nullptr);
+    
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    
+    /**
+     * @brief Find the characters of a new name that are not taken over from the old one.
+     * @param from The original name
+     * @param to The new name
+     * @return Inserted or replaced spans of the new name, in ascending order
+     */
+    static QList<Span> changedSpans(const QString &from, const QString &to);
+
+private:
+    mutable QHash<int, QList<Span>> spanCache; // Entry index -> spans
+    mutable quint64 cacheGeneration = 0;
+};
+
+#endif // NAMEDIFFDELEGATE_H
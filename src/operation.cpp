@@ -1,159 +1,575 @@
 #include "operation.h"
+#include "contenthasher.h"
+#include "replacementdictionary.h"
+#include "renamemapping.h"
+#include "filenamecodec.h"
 #include <QRegularExpression>
+#include <QDateTime>
+#include <QVarLengthArray>
+#include <QObject>
 
-QString Operation::replaceTags(const QString &text, int fileIndex)
+TagTemplate::TagTemplate(const QString &text)
+    : m_text(text)
 {
-    QString result = text;
-    
-    // Pattern to match tags like <0:0>, <00:5>, <000:14>, or <0>
-    // Format: <(0+)(:(\\d+))?>
-    QRegularExpression tagPattern(R"(<(0+)(?::(\d+))?>)");
+    // Pattern to match numbering tags like <0:0>, <00:5>, <000:14>, <0> or <00:1:dir>
+    // content hash tags like <hash:sha256> or <hash:xxh64:8> and date tags like <mtime:yyyy>
+    static const QRegularExpression tagPattern(
+        R"(<(?:(0+)(?::(\d+))?(?::(dir|ext|dir\+ext))?|hash:([a-z0-9]+)(?::(\d+))?|mtime:([^<>]+))>)");
     
+    qsizetype literalStart = 0;
     QRegularExpressionMatchIterator iter = tagPattern.globalMatch(text);
-    
-    // Process matches in reverse order to maintain correct positions
-    QList<QRegularExpressionMatch> matches;
     while (iter.hasNext()) {
-        matches.prepend(iter.next());
-    }
-    
-    for (const QRegularExpressionMatch &match : matches) {
-        QString fullMatch = match.captured(0);
-        QString zeros = match.captured(1);
-        QString startNumStr = match.captured(2);
-        
-        // Determine minimum width from number of zeros
-        int minWidth = zeros.length();
-        
-        // Determine starting number (default is 1 if not specified)
-        int startNum = startNumStr.isEmpty() ? 1 : startNumStr.toInt();
-        
-        // Calculate the actual number for this file
-        int number = startNum + fileIndex;
+        QRegularExpressionMatch match = iter.next();
         
-        // Format the number with leading zeros
-        QString formattedNumber = QString("%1").arg(number, minWidth, 10, QChar('0'));
+        Segment segment;
+        if (!match.captured(1).isEmpty()) {
+            // Numbering tag: minimum width from number of zeros, start defaults to 1
+            segment.kind = Segment::Number;
+            segment.width = match.capturedLength(1);
+            segment.start = match.captured(2).isEmpty() ? 1 : match.captured(2).toInt();
+            
+            const QString scope = match.captured(3);
+            if (scope == "dir") {
+                segment.scope = CounterScope::Directory;
+            } else if (scope == "ext") {
+                segment.scope = CounterScope::Extension;
+            } else if (scope == "dir+ext") {
+                segment.scope = CounterScope::DirectoryExtension;
+            }
+        } else if (match.capturedStart(6) >= 0) {
+            segment.kind = Segment::Mtime;
+            segment.text = match.captured(6);
+        } else if (ContentHasher::isSupportedAlgorithm(match.captured(4))) {
+            segment.kind = Segment::Hash;
+            segment.text = match.captured(4);
+            segment.width = match.captured(5).toInt();
+        } else {
+            // Unknown hash algorithm - keep the tag as literal text
+            continue;
+        }
         
-        // Replace this occurrence
-        result.replace(match.capturedStart(0), match.capturedLength(0), formattedNumber);
+        if (match.capturedStart(0) > literalStart) {
+            Segment literal;
+            literal.text = text.mid(literalStart, match.capturedStart(0) - literalStart);
+            m_segments.append(literal);
+        }
+        m_segments.append(segment);
+        m_hasTags = true;
+        literalStart = match.capturedEnd(0);
     }
     
+    if (literalStart < text.length()) {
+        Segment literal;
+        literal.text = text.mid(literalStart);
+        m_segments.append(literal);
+    }
+}
+
+QString TagTemplate::expand(const TagContext &context) const
+{
+    // Plain text is returned as-is without rebuilding the string
+    if (!m_hasTags) {
+        return m_text;
+    }
+    
+    QString result;
+    result.reserve(m_text.length() + 16);
+    for (const Segment &segment : m_segments) {
+        switch (segment.kind) {
+            case Segment::Literal:
+                result += segment.text;
+                break;
+            case Segment::Number:
+                // Format the number for this file with leading zeros
+                result += QString("%1").arg(segment.start + context.index(segment.scope), segment.width, 10, QChar('0'));
+                break;
+            case Segment::Hash: {
+                const QString digest = context.contentHashes.value(segment.text);
+                result += segment.width > 0 ? digest.left(segment.width) : digest;
+                break;
+            }
+            case Segment::Mtime:
+                if (context.modified >= 0) {
+                    result += QDateTime::fromMSecsSinceEpoch(context.modified / 1000000).toString(segment.text);
+                }
+                break;
+        }
+    }
     return result;
 }
 
-QString ReplaceOperation::perform(const QString &fileName, int fileIndex) const
+QStringList TagTemplate::requiredHashes() const
 {
-    QRegularExpression regex(m_pattern);
-    if (regex.isValid()) {
-        // First replace tags in the replacement string
-        QString replacementWithTags = replaceTags(m_replacement, fileIndex);
-        
-        // Separate basename from extension
-        int dotIndex = fileName.lastIndexOf('.');
-        if (dotIndex > 0) {
-            // Has extension - only replace in basename
-            QString baseName = fileName.left(dotIndex);
-            QString extension = fileName.mid(dotIndex);
-            baseName.replace(regex, replacementWithTags);
-            return baseName + extension;
-        } else {
-            // No extension - replace entire filename
-            QString result = fileName;
-            result.replace(regex, replacementWithTags);
-            return result;
+    QStringList algorithms;
+    for (const Segment &segment : m_segments) {
+        if (segment.kind == Segment::Hash && !algorithms.contains(segment.text)) {
+            algorithms.append(segment.text);
+        }
+    }
+    return algorithms;
+}
+
+bool TagTemplate::usesCounters() const
+{
+    for (const Segment &segment : m_segments) {
+        if (segment.kind == Segment::Number) {
+            return true;
         }
     }
-    return fileName;
+    return false;
 }
 
-QString PrefixOperation::perform(const QString &fileName, int fileIndex) const
+bool TagTemplate::usesScopedCounters() const
 {
-    QString prefixWithTags = replaceTags(m_prefix, fileIndex);
-    return prefixWithTags + fileName;
+    for (const Segment &segment : m_segments) {
+        if (segment.kind == Segment::Number && segment.scope != CounterScope::Global) {
+            return true;
+        }
+    }
+    return false;
 }
 
-QString SuffixOperation::perform(const QString &fileName, int fileIndex) const
+QStringList Operation::requiredHashes() const
 {
-    QString suffixWithTags = replaceTags(m_suffix, fileIndex);
-    
-    // Add suffix before extension
-    // Note: dotIndex > 0 ensures we don't treat dotfiles (like .bashrc) as having extensions
-    int dotIndex = fileName.lastIndexOf('.');
-    if (dotIndex > 0) {
-        return fileName.left(dotIndex) + suffixWithTags + fileName.mid(dotIndex);
-    } else {
-        return fileName + suffixWithTags;
+    QStringList algorithms;
+    for (const TagTemplate *tagTemplate : tagTemplates()) {
+        for (const QString &algorithm : tagTemplate->requiredHashes()) {
+            if (!algorithms.contains(algorithm)) {
+                algorithms.append(algorithm);
+            }
+        }
     }
+    return algorithms;
 }
 
-QString InsertOperation::perform(const QString &fileName, int fileIndex) const
+bool Operation::usesCounters() const
 {
-    QString textWithTags = replaceTags(m_text, fileIndex);
+    for (const TagTemplate *tagTemplate : tagTemplates()) {
+        if (tagTemplate->usesCounters()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Operation::usesScopedCounters() const
+{
+    for (const TagTemplate *tagTemplate : tagTemplates()) {
+        if (tagTemplate->usesScopedCounters()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Start of the extension in a file name, or its length if there is none.
+// A leading dot does not start an extension, so dotfiles (like .bashrc) keep their name.
+qsizetype extensionStart(QStringView fileName)
+{
+    const qsizetype dotIndex = fileName.lastIndexOf(QLatin1Char('.'));
+    return dotIndex > 0 ? dotIndex : fileName.size();
+}
+
+// Concatenate up to three parts with a single allocation
+QString concat(QStringView first, QStringView second, QStringView third = QStringView())
+{
+    QString result;
+    result.reserve(first.size() + second.size() + third.size());
+    result.append(first);
+    result.append(second);
+    result.append(third);
+    return result;
+}
+
+bool isAscii(QStringView text)
+{
+    for (QChar c : text) {
+        if (c.unicode() >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if the pattern matches exactly its own text, i.e. has no regex syntax
+bool isLiteralPattern(const QString &pattern)
+{
+    static const QString metaCharacters = QStringLiteral("\\^$.|?*+()[]{}");
+    if (pattern.isEmpty()) {
+        return false;
+    }
+    for (QChar c : pattern) {
+        if (metaCharacters.contains(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Length of the start-of-pattern options such as (*UCP) at the start of a pattern
+qsizetype leadingOptionsLength(const QString &pattern)
+{
+    static const QRegularExpression leadingOptions(QStringLiteral(R"(^(?:\(\*[A-Z][A-Z0-9_]*(?:=\d+)?\))*)"));
+    return leadingOptions.match(pattern).capturedLength();
+}
+
+// The pattern with the PCRE2 cost limits of ReplaceOperation set, which have to
+// follow its own start-of-pattern options; the rest goes between before and after
+QString limitedPattern(const QString &pattern, QLatin1String before = QLatin1String(),
+                       QLatin1String after = QLatin1String())
+{
+    const qsizetype optionsLength = leadingOptionsLength(pattern);
+    return pattern.left(optionsLength)
+        + QStringLiteral("(*LIMIT_MATCH=%1)(*LIMIT_DEPTH=%2)")
+              .arg(ReplaceOperation::MatchLimit).arg(ReplaceOperation::DepthLimit)
+        + before + pattern.mid(optionsLength) + after;
+}
+
+// Per-code-unit case folding for extension lookups; keys are folded the same way
+inline char16_t fold(char16_t c)
+{
+    if (c < 0x80) {
+        return c >= u'A' && c <= u'Z' ? char16_t(c + (u'a' - u'A')) : c;
+    }
+    return QChar(c).toCaseFolded().unicode();
+}
+
+// "*.ext" where ext is plain ASCII text, which an extension lookup matches exactly
+// like the glob would
+bool isExtensionGlob(const QString &term)
+{
+    static const QString specialCharacters = QStringLiteral("*?[]\\/.");
+    if (!term.startsWith(QLatin1String("*.")) || term.size() == 2) {
+        return false;
+    }
+    for (QChar c : QStringView(term).mid(2)) {
+        if (c.unicode() >= 0x80 || specialCharacters.contains(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+OperationCondition::OperationCondition(const QString &text)
+    : m_text(text)
+{
+    if (text.startsWith(QLatin1String("re:"))) {
+        const QString pattern = text.mid(3);
+        if (pattern.isEmpty()) {
+            return;
+        }
+        m_empty = false;
+        m_literalCase = Qt::CaseSensitive;
+        if (isLiteralPattern(pattern)) {
+            m_substrings.append(pattern);
+        } else if (pattern.startsWith(QLatin1Char('^')) && isLiteralPattern(pattern.mid(1))) {
+            m_prefix = pattern.mid(1);
+        } else {
+            m_regex.setPattern(limitedPattern(pattern));
+            m_hasRegex = true;
+        }
+    } else {
+        QStringList globs;
+        for (const QString &part : text.split(QLatin1Char(';'))) {
+            const QString term = part.trimmed();
+            if (term.isEmpty()) {
+                continue;
+            }
+            m_empty = false;
+            if (isExtensionGlob(term)) {
+                QString extension = term.mid(2);
+                for (QChar &c : extension) {
+                    c = QChar(fold(c.unicode()));
+                }
+                m_extensions.insert(extension);
+            } else if (term.contains(QLatin1Char('*')) || term.contains(QLatin1Char('?'))
+                       || term.contains(QLatin1Char('['))) {
+                globs.append(QStringLiteral("(?:%1)").arg(QRegularExpression::wildcardToRegularExpression(term)));
+            } else {
+                m_substrings.append(term);
+            }
+        }
+        if (!globs.isEmpty()) {
+            m_regex = QRegularExpression(globs.join(QLatin1Char('|')), QRegularExpression::CaseInsensitiveOption);
+            m_hasRegex = true;
+        }
+    }
     
-    // Separate basename from extension
-    int dotIndex = fileName.lastIndexOf('.');
-    QString baseName;
-    QString extension;
+    if (m_hasRegex) {
+        if (m_regex.isValid()) {
+            m_regex.optimize();
+        } else {
+            m_errorString = QObject::tr("Invalid condition '%1': %2").arg(text, m_regex.errorString());
+        }
+    }
+}
+
+bool OperationCondition::matches(const QString &fileName) const
+{
+    // Cheapest checks first: one hash lookup, then plain string search
+    if (!m_extensions.isEmpty()) {
+        const qsizetype dotIndex = fileName.lastIndexOf(QLatin1Char('.'));
+        if (dotIndex >= 0 && dotIndex + 1 < fileName.size()) {
+            QVarLengthArray<char16_t, 32> extension;
+            for (qsizetype i = dotIndex + 1; i < fileName.size(); ++i) {
+                extension.append(fold(fileName.at(i).unicode()));
+            }
+            // Raw data: the lookup key is not copied
+            const QString key = QString::fromRawData(reinterpret_cast<const QChar *>(extension.constData()),
+                                                     extension.size());
+            if (m_extensions.contains(key)) {
+                return true;
+            }
+        }
+    }
+    for (const QString &substring : m_substrings) {
+        if (fileName.contains(substring, m_literalCase)) {
+            return true;
+        }
+    }
+    if (!m_prefix.isEmpty() && fileName.startsWith(m_prefix)) {
+        return true;
+    }
+    if (!m_hasRegex || !m_regex.isValid()) {
+        return false;
+    }
+    // Escaped bytes as in ReplaceOperation::replaceMatches()
+    if (FileNameCodec::hasEscapes(fileName) && FileNameCodec::canMapEscapes(fileName)) {
+        return m_regex.match(FileNameCodec::mapEscapes(fileName)).hasMatch();
+    }
+    return m_regex.match(fileName).hasMatch();
+}
+
+ReplaceOperation::ReplaceOperation(const QString &pattern, const QString &replacement)
+    : m_pattern(pattern), m_replacement(replacement), m_replacementTemplate(replacement)
+{
+    const QRegularExpression regex(pattern);
+    if (!regex.isValid()) {
+        m_errorString = QObject::tr("Invalid pattern at character %1: %2")
+                            .arg(regex.patternErrorOffset() + 1).arg(regex.errorString());
+        return;
+    }
     
-    if (dotIndex > 0) {
-        // Has extension - only insert in basename
-        baseName = fileName.left(dotIndex);
-        extension = fileName.mid(dotIndex);
-    } else {
-        // No extension - use entire filename as basename
-        baseName = fileName;
-        extension = "";
+    // Literal patterns are replaced with plain string search; backslashes in the
+    // replacement would be back-references, so those always go through the regex
+    m_literal = isLiteralPattern(pattern) && !replacement.contains(QLatin1Char('\\'));
+    if (m_literal) {
+        return;
     }
+    m_captureCount = regex.captureCount();
     
-    // Insert text at the specified position within the basename
-    // If position is negative or beyond the basename length, handle gracefully
-    int pos = m_position;
-    if (pos < 0) {
-        pos = 0;
+    // A match error (the limits) ends a scan like "no more matches" would. An empty
+    // alternative that only matches at the end of the text tells them apart: every
+    // scan that runs to completion reaches it. Backtracking verbs like (*COMMIT) can
+    // end a scan early too, and comments in extended mode cannot be wrapped, so such
+    // patterns are limited without the check.
+    if (!QStringView(pattern).mid(leadingOptionsLength(pattern)).contains(QLatin1String("(*"))) {
+        m_regex.setPattern(limitedPattern(pattern, QLatin1String("(?:"), QLatin1String(")|()\\z")));
+        if (m_regex.isValid() && m_regex.captureCount() == m_captureCount + 1) {
+            m_endGroup = m_captureCount + 1;
+        }
     }
-    if (pos > baseName.length()) {
-        pos = baseName.length();
+    if (m_endGroup < 0) {
+        m_regex.setPattern(limitedPattern(pattern));
+        if (!m_regex.isValid()) {
+            m_regex = regex;
+        }
     }
     
-    baseName.insert(pos, textWithTags);
-    return baseName + extension;
+    // Compile (and JIT) now rather than on the first match in a worker thread
+    m_regex.optimize();
 }
 
-QString ChangeExtensionOperation::perform(const QString &fileName, int fileIndex) const
+bool ReplaceOperation::replaceMatches(QString &text, const QString &replacement) const
 {
-    // Change extension, but preserve dotfiles (like .bashrc)
-    QString result = fileName;
-    int dotIndex = result.lastIndexOf('.');
-    if (dotIndex > 0) {
-        result = result.left(dotIndex);
+    // Back-references \1 to \99 as QString::replace() finds them: a second digit
+    // belongs to the reference if that group exists
+    struct BackReference {
+        qsizetype position;
+        int length;
+        int group;
+    };
+    QVarLengthArray<BackReference, 4> backReferences;
+    for (qsizetype i = 0; i + 1 < replacement.size(); ++i) {
+        if (replacement.at(i) != QLatin1Char('\\')) {
+            continue;
+        }
+        int group = replacement.at(i + 1).digitValue();
+        if (group <= 0 || group > m_captureCount) {
+            continue;
+        }
+        int length = 2;
+        if (i + 2 < replacement.size()) {
+            const int secondDigit = replacement.at(i + 2).digitValue();
+            if (secondDigit >= 0 && group * 10 + secondDigit <= m_captureCount) {
+                group = group * 10 + secondDigit;
+                ++length;
+            }
+        }
+        backReferences.append({i, length, group});
     }
-    if (!m_newExtension.isEmpty()) {
-        if (!m_newExtension.startsWith('.')) {
-            result += '.';
+    
+    // Names with bytes that are not UTF-8 (surrogate escapes) are matched with the escapes
+    // mapped to private-use characters, like the literal path replaces in them; name
+    // parts and captures get their escapes back, the replacement text is taken as typed
+    const bool escaped = FileNameCodec::hasEscapes(text);
+    const bool mapped = escaped && FileNameCodec::canMapEscapes(text);
+    const QString subject = mapped ? FileNameCodec::mapEscapes(text) : text;
+    const auto appendSubject = [mapped](QString &out, QStringView part) {
+        if (mapped) {
+            out.append(FileNameCodec::restoreEscapes(part));
+        } else {
+            out.append(part);
         }
-        result += m_newExtension;
+    };
+    
+    QString result;
+    qsizetype copyStart = 0;
+    bool replaced = false;
+    bool completed = m_endGroup < 0;
+    QRegularExpressionMatchIterator iter = m_regex.globalMatch(subject);
+    while (iter.hasNext()) {
+        const QRegularExpressionMatch match = iter.next();
+        completed = completed || match.capturedStart() == subject.size();
+        if (m_endGroup >= 0 && match.capturedStart(m_endGroup) >= 0) {
+            continue;
+        }
+        appendSubject(result, QStringView(subject).mid(copyStart, match.capturedStart() - copyStart));
+        qsizetype replacementStart = 0;
+        for (const BackReference &reference : backReferences) {
+            result.append(QStringView(replacement).mid(replacementStart, reference.position - replacementStart));
+            appendSubject(result, match.capturedView(reference.group));
+            replacementStart = reference.position + reference.length;
+        }
+        result.append(QStringView(replacement).mid(replacementStart));
+        copyStart = match.capturedEnd();
+        replaced = true;
+    }
+    
+    // The rare name whose escapes cannot be mapped (it has characters of the private-use
+    // range itself) cannot be matched; it is reported like a name over the limits
+    if (!completed || (escaped && !mapped)) {
+        return false;
+    }
+    if (replaced) {
+        appendSubject(result, QStringView(subject).mid(copyStart));
+        text = result;
+    }
+    return true;
+}
+
+QString ReplaceOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    bool limitExceeded = false;
+    return performWithinLimits(fileName, context, limitExceeded);
+}
+
+QString ReplaceOperation::performWithinLimits(const QString &fileName, const TagContext &context,
+                                              bool &limitExceeded) const
+{
+    if (!isValid()) {
+        return fileName;
     }
+    
+    // First replace tags in the replacement string
+    const QString replacementWithTags = m_replacementTemplate.expand(context);
+    
+    // Only replace in the basename, keep the extension
+    const qsizetype dotIndex = extensionStart(fileName);
+    QString baseName = fileName.left(dotIndex);
+    if (m_literal) {
+        baseName.replace(m_pattern, replacementWithTags);
+    } else if (!replaceMatches(baseName, replacementWithTags)) {
+        // Gave up on this name; a partial result would be wrong, so keep the name
+        limitExceeded = true;
+        return fileName;
+    }
+    if (dotIndex == fileName.size()) {
+        return baseName;
+    }
+    return concat(baseName, QStringView(fileName).mid(dotIndex));
+}
+
+QString PrefixOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    return concat(m_prefixTemplate.expand(context), fileName);
+}
+
+QString SuffixOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    const QString suffixWithTags = m_suffixTemplate.expand(context);
+    
+    // Add suffix before extension
+    const QStringView name(fileName);
+    const qsizetype dotIndex = extensionStart(name);
+    return concat(name.left(dotIndex), suffixWithTags, name.mid(dotIndex));
+}
+
+QString InsertOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    const QString textWithTags = m_textTemplate.expand(context);
+    
+    // Insert text at the specified position within the basename, clamped to its bounds
+    const QStringView name(fileName);
+    const qsizetype baseLength = extensionStart(name);
+    const qsizetype pos = qBound(qsizetype(0), qsizetype(m_position), baseLength);
+    
+    QString result;
+    result.reserve(name.size() + textWithTags.size());
+    result.append(name.left(pos));
+    result.append(textWithTags);
+    result.append(name.mid(pos));
     return result;
 }
 
-QString ChangeCaseOperation::perform(const QString &fileName, int fileIndex) const
+QString ChangeExtensionOperation::perform(const QString &fileName, const TagContext &context) const
 {
-    // Separate basename from extension
-    int dotIndex = fileName.lastIndexOf('.');
-    QString baseName;
-    QString extension;
+    Q_UNUSED(context);
     
-    if (dotIndex > 0) {
-        // Has extension - only change case of basename
-        baseName = fileName.left(dotIndex);
-        extension = fileName.mid(dotIndex);
-    } else {
-        // No extension - use entire filename as basename
-        baseName = fileName;
-        extension = "";
+    // Change extension, but preserve dotfiles (like .bashrc)
+    const QStringView baseName = QStringView(fileName).left(extensionStart(fileName));
+    if (m_newExtension.isEmpty()) {
+        return baseName.toString();
     }
+    const bool needsDot = !m_newExtension.startsWith(QLatin1Char('.'));
+    return concat(baseName, needsDot ? QStringView(u".") : QStringView(), m_newExtension);
+}
+
+QString ChangeCaseOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    Q_UNUSED(context);
+    
+    // Only change the case of the basename
+    const qsizetype dotIndex = extensionStart(fileName);
+    QString result = fileName;
     
-    // Apply case transformation to basename
+    // ASCII names (the common case) are converted in place without Unicode case tables
+    if (isAscii(QStringView(fileName).left(dotIndex))) {
+        QChar *data = result.data();
+        bool capitalizeNext = true;
+        for (qsizetype i = 0; i < dotIndex; ++i) {
+            const char16_t c = data[i].unicode();
+            const bool isUpper = c >= u'A' && c <= u'Z';
+            const bool isLower = c >= u'a' && c <= u'z';
+            bool toUpper = m_caseType == Uppercase;
+            if (m_caseType == TitleCase) {
+                toUpper = capitalizeNext && (isUpper || isLower);
+                capitalizeNext = !(isUpper || isLower);
+            }
+            if (toUpper && isLower) {
+                data[i] = QChar(char16_t(c - (u'a' - u'A')));
+            } else if (!toUpper && isUpper) {
+                data[i] = QChar(char16_t(c + (u'a' - u'A')));
+            }
+        }
+        return result;
+    }
+    
+    QString baseName = fileName.left(dotIndex);
     switch (m_caseType) {
         case Lowercase:
             baseName = baseName.toLower();
@@ -181,25 +597,73 @@ QString ChangeCaseOperation::perform(const QString &fileName, int fileIndex) con
         }
     }
     
-    return baseName + extension;
+    return concat(baseName, QStringView(fileName).mid(dotIndex));
 }
 
-QString NewNameOperation::perform(const QString &fileName, int fileIndex) const
+QString NewNameOperation::perform(const QString &fileName, const TagContext &context) const
 {
-    QString newNameWithTags = replaceTags(m_newName, fileIndex);
-    
-    // Separate basename from extension in the original filename
-    // Note: dotIndex > 0 ensures dotfiles (like .bashrc) are not treated as having extensions
-    int dotIndex = fileName.lastIndexOf('.');
-    QString extension;
-    
-    if (dotIndex > 0) {
-        // Has extension - preserve it
-        extension = fileName.mid(dotIndex);
-    } else {
-        // No extension (or is a dotfile)
-        extension = "";
+    // Keep the extension of the original name (dotfiles have none)
+    const QStringView name(fileName);
+    return concat(m_newNameTemplate.expand(context), name.mid(extensionStart(name)));
+}
+
+DictionaryReplaceOperation::DictionaryReplaceOperation(const QString &filePath)
+    : m_filePath(filePath)
+{
+    // Loaded (or taken from the cache) now rather than in a worker thread
+    if (!filePath.isEmpty()) {
+        m_dictionary = ReplacementDictionary::load(filePath, m_errorString);
     }
+}
+
+int DictionaryReplaceOperation::pairCount() const
+{
+    return m_dictionary ? m_dictionary->size() : -1;
+}
+
+QString DictionaryReplaceOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    Q_UNUSED(context);
     
-    return newNameWithTags + extension;
+    // Only replace in the basename; names without matches are returned as they are
+    const qsizetype dotIndex = extensionStart(fileName);
+    QString baseName;
+    if (!m_dictionary || !m_dictionary->replace(QStringView(fileName).left(dotIndex), baseName)) {
+        return fileName;
+    }
+    return concat(baseName, QStringView(fileName).mid(dotIndex));
+}
+
+MappingFileOperation::MappingFileOperation(const QString &filePath)
+    : m_filePath(filePath)
+{
+    // Loaded (or taken from the cache) now rather than in a worker thread
+    if (!filePath.isEmpty()) {
+        m_mapping = RenameMapping::load(filePath, m_errorString);
+    }
+}
+
+qsizetype MappingFileOperation::rowCount() const
+{
+    return m_mapping ? m_mapping->size() : -1;
+}
+
+const QString *MappingFileOperation::newNameOf(const QString &fileName, const TagContext &context) const
+{
+    if (!m_mapping) {
+        return nullptr;
+    }
+    const QStringView name = context.originalName.isNull() ? QStringView(fileName) : context.originalName;
+    return m_mapping->find(name, context.directory);
+}
+
+bool MappingFileOperation::contains(const QString &fileName, const TagContext &context) const
+{
+    return newNameOf(fileName, context) != nullptr;
+}
+
+QString MappingFileOperation::perform(const QString &fileName, const TagContext &context) const
+{
+    const QString *newName = newNameOf(fileName, context);
+    return newName ? *newName : fileName;
 }
@@ -2,8 +2,172 @@
 #define OPERATION_H
 
 #include <QString>
+#include <QStringView>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QRegularExpression>
 #include <memory>
 
+class ReplacementDictionary;
+class RenameMapping;
+
+/**
+ * @brief Kinds of rename operations.
+ */
+enum class OperationType {
+    Replace,
+    Prefix,
+    Suffix,
+    Insert,
+    ChangeExtension,
+    ChangeCase,
+    NewName,
+    DictionaryReplace,
+    MappingFile
+};
+
+/**
+ * @brief Range over which a numbering tag counts.
+ */
+enum class CounterScope {
+    Global,             // One counter across the whole batch
+    Directory,          // Restarts in every directory
+    Extension,          // Restarts for every extension
+    DirectoryExtension  // Restarts for every extension within a directory
+};
+
+/**
+ * @brief Per-file values used when expanding tags in operation text.
+ */
+struct TagContext
+{
+    int fileIndex = 0;                      // 0-based index used for numbering tags
+    int directoryIndex = 0;                 // 0-based index within the file's directory
+    int extensionIndex = 0;                 // 0-based index among files with the same extension
+    int directoryExtensionIndex = 0;        // 0-based index within directory and extension
+    QHash<QString, QString> contentHashes;  // Hash algorithm -> hex digest of the file content
+    qint64 modified = -1;                   // Modification time in ns since the epoch; -1 if unknown
+    QStringView originalName;               // Name before the first operation; valid during perform()
+    QStringView directory;                  // Absolute folder of the file; valid during perform()
+    
+    int index(CounterScope scope) const
+    {
+        switch (scope) {
+            case CounterScope::Directory: return directoryIndex;
+            case CounterScope::Extension: return extensionIndex;
+            case CounterScope::DirectoryExtension: return directoryExtensionIndex;
+            case CounterScope::Global: break;
+        }
+        return fileIndex;
+    }
+};
+
+/**
+ * @brief Text containing tags, parsed once and expanded per file.
+ * 
+ * Supported tags:
+ * - Numbering: <0>, <00:5>, <000:14> (zeros give the minimum width, the number the start)
+ * - Scoped numbering: <00:1:dir>, <000:ext>, <0:dir+ext> (counter restarts per directory/extension)
+ * - Content hash: <hash:sha256>, <hash:xxh64:8> (optional length truncates the digest)
+ * - Modification time: <mtime:yyyy>, <mtime:yyyy-MM-dd> (QDateTime format, local time);
+ *   combined with '/' this moves files into folders, e.g. "<mtime:yyyy>/<mtime:MM>/"
+ */
+class TagTemplate
+{
+public:
+    TagTemplate() = default;
+    explicit TagTemplate(const QString &text);
+    
+    /**
+     * @brief Expand all tags for one file.
+     * @param context The per-file values (index, content hashes)
+     * @return The text with tags replaced; hash and mtime tags without a known value
+     *         expand to nothing
+     */
+    QString expand(const TagContext &context) const;
+    
+    QString text() const { return m_text; }
+    
+    /**
+     * @brief Get the hash algorithms referenced by <hash:...> tags.
+     */
+    QStringList requiredHashes() const;
+    
+    /**
+     * @brief Check whether the text contains any numbering tag.
+     */
+    bool usesCounters() const;
+    
+    /**
+     * @brief Check whether any numbering tag counts per directory or extension.
+     */
+    bool usesScopedCounters() const;
+
+private:
+    struct Segment {
+        enum Kind { Literal, Number, Hash, Mtime };
+        Kind kind = Literal;
+        QString text;   // Literal text, hash algorithm or date format (Mtime)
+        int width = 0;  // Minimum width (Number) or truncation length (Hash, 0 = full digest)
+        int start = 1;  // Starting number (Number)
+        CounterScope scope = CounterScope::Global;  // Counter used by Number
+    };
+    
+    QString m_text;
+    QList<Segment> m_segments;
+    bool m_hasTags = false;
+};
+
+/**
+ * @brief Condition that limits an operation to some files, compiled once.
+ * 
+ * The text is either "re:" followed by a regular expression that is searched in
+ * the name, or a list of terms separated by ';' of which any has to match:
+ * - "*.ext" terms are collected in a set and checked with one hash lookup of the
+ *   file's extension
+ * - other terms with wildcards (* ? [) are globs for the whole name; they are
+ *   combined into one regular expression
+ * - terms without wildcards match names that contain them
+ * Terms ignore case. Regular expressions without regex syntax (optionally
+ * anchored with ^) are checked as substrings or prefixes; others run under the
+ * cost limits of ReplaceOperation and do not match names that exceed them.
+ */
+class OperationCondition
+{
+public:
+    OperationCondition() = default;
+    explicit OperationCondition(const QString &text);
+    
+    /**
+     * @brief Check whether there is no condition, i.e. every file matches.
+     */
+    bool isEmpty() const { return m_empty; }
+    
+    /**
+     * @brief Check whether the regular expression (or glob) compiled; invalid
+     * conditions match no file.
+     */
+    bool isValid() const { return m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+    
+    QString text() const { return m_text; }
+    
+    bool matches(const QString &fileName) const;
+
+private:
+    QString m_text;
+    bool m_empty = true;
+    QSet<QString> m_extensions;     // Case-folded, without the dot
+    QStringList m_substrings;
+    QString m_prefix;               // From a regular expression "^text"
+    Qt::CaseSensitivity m_literalCase = Qt::CaseInsensitive;
+    QRegularExpression m_regex;     // Globs as one alternation, or the "re:" pattern
+    bool m_hasRegex = false;
+    QString m_errorString;
+};
+
 /**
  * @brief Abstract base class for file name operations.
  * 
@@ -18,47 +182,122 @@ public:
     /**
      * @brief Apply this operation to the given filename.
      * @param fileName The input filename to transform
-     * @param fileIndex The index of the file (0-based) used for tag replacement
+     * @param context Per-file values used for tag replacement
      * @return The transformed filename
      */
-    virtual QString perform(const QString &fileName, int fileIndex = 0) const = 0;
+    virtual QString perform(const QString &fileName, const TagContext &context = TagContext()) const = 0;
     
     /**
-     * @brief Get the operation type identifier.
-     * @return A string identifying the operation type (e.g., "replace", "prefix")
+     * @brief Apply this operation within its cost limits.
+     * 
+     * Operations that run user patterns give up on a name once matching it exceeds
+     * their limits and return it unchanged; the default never gives up.
+     * @param limitExceeded Set to true if the operation gave up on this name
      */
-    virtual QString getType() const = 0;
+    virtual QString performWithinLimits(const QString &fileName, const TagContext &context,
+                                        bool &limitExceeded) const
+    {
+        Q_UNUSED(limitExceeded);
+        return perform(fileName, context);
+    }
+    
+    /**
+     * @brief Get the operation type.
+     */
+    virtual OperationType getType() const = 0;
+    
+    /**
+     * @brief Get the content hash algorithms this operation needs per file.
+     * @return Algorithm names referenced by <hash:...> tags (empty if none)
+     */
+    QStringList requiredHashes() const;
+    
+    /**
+     * @brief Check whether this operation uses numbering tags, i.e. whether its result
+     * depends on the position of the file in the list.
+     */
+    bool usesCounters() const;
+    
+    /**
+     * @brief Check whether this operation uses per-directory or per-extension counters.
+     */
+    bool usesScopedCounters() const;
+
+    /**
+     * @brief Limit the operation to files that match a condition.
+     */
+    void setCondition(const OperationCondition &condition) { m_condition = condition; }
+    const OperationCondition &condition() const { return m_condition; }
+    
+    /**
+     * @brief Check whether the operation applies to a name; callers skip perform()
+     * (and keep the name) otherwise.
+     */
+    bool appliesTo(const QString &fileName) const
+    {
+        return m_condition.isEmpty() || m_condition.matches(fileName);
+    }
 
 protected:
     /**
-     * @brief Replace numbering tags in text with formatted numbers.
-     * @param text The text containing tags like <0:0> or <00:5>
-     * @param fileIndex The 0-based index of the current file
-     * @return The text with tags replaced by formatted numbers
+     * @brief Get the tag templates used by this operation.
      */
-    static QString replaceTags(const QString &text, int fileIndex);
+    virtual QList<const TagTemplate *> tagTemplates() const { return {}; }
+    
+private:
+    OperationCondition m_condition;
 };
 
 /**
  * @brief Replace operation using regular expressions.
  * 
  * Replaces all matches of a regex pattern with a replacement string.
+ * The pattern is compiled once on construction and shared by all files; patterns
+ * without regex syntax use plain string search. Regular expressions run under
+ * PCRE2 match and depth limits, so catastrophic backtracking (like "(a+)+$") ends
+ * after a bounded number of steps per match attempt; a name's total cost is that
+ * bound times the number of matches it has, plus one for the final failed search.
+ * performWithinLimits() reports names that hit a limit, which keep their name.
  */
 class ReplaceOperation : public Operation
 {
 public:
-    ReplaceOperation(const QString &pattern, const QString &replacement)
-        : m_pattern(pattern), m_replacement(replacement) {}
+    // Backtracking steps and depth allowed per pcre2_match() call, which covers every
+    // start position tried for one match; globalMatch() makes one call per match found.
+    // Far above what a pattern needs on a file name unless it backtracks exponentially
+    static constexpr int MatchLimit = 100000;
+    static constexpr int DepthLimit = 10000;
+    
+    ReplaceOperation(const QString &pattern, const QString &replacement);
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "replace"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    QString performWithinLimits(const QString &fileName, const TagContext &context,
+                                bool &limitExceeded) const override;
+    OperationType getType() const override { return OperationType::Replace; }
     
     QString getPattern() const { return m_pattern; }
     QString getReplacement() const { return m_replacement; }
+
+    /**
+     * @brief Check whether the pattern compiled; invalid patterns leave names unchanged.
+     */
+    bool isValid() const { return m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+
+protected:
+    QList<const TagTemplate *> tagTemplates() const override { return {&m_replacementTemplate}; }
     
 private:
+    bool replaceMatches(QString &text, const QString &replacement) const;
+    
     QString m_pattern;
     QString m_replacement;
+    TagTemplate m_replacementTemplate;
+    QRegularExpression m_regex;     // The pattern with the cost limits set
+    int m_captureCount = 0;         // Capture groups of the pattern itself
+    int m_endGroup = -1;            // Group that only matches at the end of the text; -1 if none
+    bool m_literal = false;
+    QString m_errorString;
 };
 
 /**
@@ -68,15 +307,19 @@ class PrefixOperation : public Operation
 {
 public:
     explicit PrefixOperation(const QString &prefix)
-        : m_prefix(prefix) {}
+        : m_prefix(prefix), m_prefixTemplate(prefix) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "prefix"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::Prefix; }
     
     QString getPrefix() const { return m_prefix; }
+
+protected:
+    QList<const TagTemplate *> tagTemplates() const override { return {&m_prefixTemplate}; }
     
 private:
     QString m_prefix;
+    TagTemplate m_prefixTemplate;
 };
 
 /**
@@ -86,15 +329,19 @@ class SuffixOperation : public Operation
 {
 public:
     explicit SuffixOperation(const QString &suffix)
-        : m_suffix(suffix) {}
+        : m_suffix(suffix), m_suffixTemplate(suffix) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "suffix"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::Suffix; }
     
     QString getSuffix() const { return m_suffix; }
+
+protected:
+    QList<const TagTemplate *> tagTemplates() const override { return {&m_suffixTemplate}; }
     
 private:
     QString m_suffix;
+    TagTemplate m_suffixTemplate;
 };
 
 /**
@@ -104,17 +351,21 @@ class InsertOperation : public Operation
 {
 public:
     InsertOperation(int position, const QString &text)
-        : m_position(position), m_text(text) {}
+        : m_position(position), m_text(text), m_textTemplate(text) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "insert"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::Insert; }
     
     int getPosition() const { return m_position; }
     QString getText() const { return m_text; }
+
+protected:
+    QList<const TagTemplate *> tagTemplates() const override { return {&m_textTemplate}; }
     
 private:
     int m_position;
     QString m_text;
+    TagTemplate m_textTemplate;
 };
 
 /**
@@ -126,8 +377,8 @@ public:
     explicit ChangeExtensionOperation(const QString &newExtension)
         : m_newExtension(newExtension) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "change_ext"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::ChangeExtension; }
     
     QString getNewExtension() const { return m_newExtension; }
     
@@ -152,8 +403,8 @@ public:
     explicit ChangeCaseOperation(CaseType caseType)
         : m_caseType(caseType) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "change_case"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::ChangeCase; }
     
     CaseType getCaseType() const { return m_caseType; }
     
@@ -170,15 +421,83 @@ class NewNameOperation : public Operation
 {
 public:
     explicit NewNameOperation(const QString &newName)
-        : m_newName(newName) {}
+        : m_newName(newName), m_newNameTemplate(newName) {}
     
-    QString perform(const QString &fileName, int fileIndex = 0) const override;
-    QString getType() const override { return "new_name"; }
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::NewName; }
     
     QString getNewName() const { return m_newName; }
+
+protected:
+    QList<const TagTemplate *> tagTemplates() const override { return {&m_newNameTemplate}; }
     
 private:
     QString m_newName;
+    TagTemplate m_newNameTemplate;
+};
+
+/**
+ * @brief Dictionary replace operation - applies many find -> replacement pairs at once.
+ * 
+ * The pairs come from a dictionary file (see ReplacementDictionary) and are
+ * replaced in the basename in a single scan, however many pairs there are.
+ */
+class DictionaryReplaceOperation : public Operation
+{
+public:
+    explicit DictionaryReplaceOperation(const QString &filePath);
+    
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::DictionaryReplace; }
+    
+    QString getFilePath() const { return m_filePath; }
+    
+    /**
+     * @brief Number of pairs loaded, or -1 if the file could not be loaded.
+     */
+    int pairCount() const;
+    QString errorString() const { return m_errorString; }
+    
+private:
+    QString m_filePath;
+    std::shared_ptr<const ReplacementDictionary> m_dictionary;
+    QString m_errorString;
+};
+
+/**
+ * @brief Rename from mapping operation - takes new names from a mapping file.
+ * 
+ * Files are looked up by their original name or path (see RenameMapping), not by
+ * the name earlier operations produced; files without a row keep the name they have.
+ */
+class MappingFileOperation : public Operation
+{
+public:
+    explicit MappingFileOperation(const QString &filePath);
+    
+    QString perform(const QString &fileName, const TagContext &context = TagContext()) const override;
+    OperationType getType() const override { return OperationType::MappingFile; }
+    
+    QString getFilePath() const { return m_filePath; }
+    
+    /**
+     * @brief Check whether the mapping has a row for a file.
+     * @param context Per-file values; without an original name, fileName is looked up
+     */
+    bool contains(const QString &fileName, const TagContext &context) const;
+    
+    /**
+     * @brief Number of rows loaded, or -1 if the file could not be loaded.
+     */
+    qsizetype rowCount() const;
+    QString errorString() const { return m_errorString; }
+    
+private:
+    const QString *newNameOf(const QString &fileName, const TagContext &context) const;
+    
+    QString m_filePath;
+    std::shared_ptr<const RenameMapping> m_mapping;
+    QString m_errorString;
 };
 
 #endif // OPERATION_H
@@ -1,16 +1,15 @@
 #include "operationcard.h"
 #include <QGroupBox>
+#include <QFileDialog>
+#include <QStyle>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 OperationCard::OperationCard(QWidget *parent)
     : QFrame(parent)
 {
-    // Create debounce timer for text input
-    debounceTimer = new QTimer(this);
-    debounceTimer->setSingleShot(true);
-    debounceTimer->setInterval(300); // 300ms delay after last keystroke
-    connect(debounceTimer, &QTimer::timeout, this, &OperationCard::operationChanged);
-    
     setupUI();
+    rebuildOperation();
 }
 
 void OperationCard::setupUI()
@@ -29,13 +28,15 @@ void OperationCard::setupUI()
     QHBoxLayout *typeLayout = new QHBoxLayout();
     QLabel *typeLabel = new QLabel(tr("Operation:"), this);
     operationTypeCombo = new QComboBox(this);
-    operationTypeCombo->addItem(tr("Replace"), "replace");
-    operationTypeCombo->addItem(tr("Add Prefix"), "prefix");
-    operationTypeCombo->addItem(tr("Add Suffix"), "suffix");
-    operationTypeCombo->addItem(tr("Insert Text"), "insert");
-    operationTypeCombo->addItem(tr("Change Extension"), "change_ext");
-    operationTypeCombo->addItem(tr("Change Case"), "change_case");
-    operationTypeCombo->addItem(tr("New Name"), "new_name");
+    operationTypeCombo->addItem(tr("Replace"), int(OperationType::Replace));
+    operationTypeCombo->addItem(tr("Add Prefix"), int(OperationType::Prefix));
+    operationTypeCombo->addItem(tr("Add Suffix"), int(OperationType::Suffix));
+    operationTypeCombo->addItem(tr("Insert Text"), int(OperationType::Insert));
+    operationTypeCombo->addItem(tr("Change Extension"), int(OperationType::ChangeExtension));
+    operationTypeCombo->addItem(tr("Change Case"), int(OperationType::ChangeCase));
+    operationTypeCombo->addItem(tr("New Name"), int(OperationType::NewName));
+    operationTypeCombo->addItem(tr("Dictionary Replace"), int(OperationType::DictionaryReplace));
+    operationTypeCombo->addItem(tr("Rename from Mapping"), int(OperationType::MappingFile));
     
     typeLayout->addWidget(typeLabel);
     typeLayout->addWidget(operationTypeCombo, 1);
@@ -46,15 +47,18 @@ void OperationCard::setupUI()
     valueLabel = new QLabel(tr("Pattern:"), this);
     valueEdit = new QLineEdit(this);
     valueEdit->setPlaceholderText(tr("Enter pattern..."));
+    browseButton = new QPushButton(tr("..."), this);
+    browseButton->setMaximumWidth(40);
     valueLayout->addWidget(valueLabel);
     valueLayout->addWidget(valueEdit, 1);
+    valueLayout->addWidget(browseButton);
     mainLayout->addLayout(valueLayout);
     
     // Case type combo box (for change_case operation)
     caseTypeCombo = new QComboBox(this);
-    caseTypeCombo->addItem(tr("Lowercase"), "lowercase");
-    caseTypeCombo->addItem(tr("Uppercase"), "uppercase");
-    caseTypeCombo->addItem(tr("Title Case"), "titlecase");
+    caseTypeCombo->addItem(tr("Lowercase"), int(ChangeCaseOperation::Lowercase));
+    caseTypeCombo->addItem(tr("Uppercase"), int(ChangeCaseOperation::Uppercase));
+    caseTypeCombo->addItem(tr("Title Case"), int(ChangeCaseOperation::TitleCase));
     caseTypeCombo->hide();  // Hidden by default
     QHBoxLayout *caseTypeLayout = new QHBoxLayout();
     caseTypeLabel = new QLabel(tr("Case Type:"), this);
@@ -72,6 +76,23 @@ void OperationCard::setupUI()
     replacementLayout->addWidget(replacementEdit, 1);
     mainLayout->addLayout(replacementLayout);
     
+    // Condition row (all operations)
+    QHBoxLayout *conditionLayout = new QHBoxLayout();
+    QLabel *conditionLabel = new QLabel(tr("Only for:"), this);
+    conditionEdit = new QLineEdit(this);
+    conditionEdit->setPlaceholderText(tr("All files (e.g. *.raw;*.nef or re:^DSC\\d+)"));
+    conditionEdit->setToolTip(conditionToolTip());
+    conditionLayout->addWidget(conditionLabel);
+    conditionLayout->addWidget(conditionEdit, 1);
+    mainLayout->addLayout(conditionLayout);
+    
+    // Status row, e.g. the number of dictionary pairs or a load error
+    statusLabel = new QLabel(this);
+    statusLabel->setObjectName("operationStatus");
+    statusLabel->setWordWrap(true);
+    statusLabel->hide();
+    mainLayout->addWidget(statusLabel);
+    
     // Buttons row
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     moveUpButton = new QPushButton(tr("↑"), this);
@@ -93,9 +114,11 @@ void OperationCard::setupUI()
     connect(operationTypeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &OperationCard::onOperationTypeChanged);
     connect(caseTypeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
-            this, &OperationCard::operationChanged);
+            this, &OperationCard::onCaseTypeChanged);
     connect(valueEdit, &QLineEdit::textChanged, this, &OperationCard::onTextChanged);
     connect(replacementEdit, &QLineEdit::textChanged, this, &OperationCard::onTextChanged);
+    connect(conditionEdit, &QLineEdit::textChanged, this, &OperationCard::onTextChanged);
+    connect(browseButton, &QPushButton::clicked, this, &OperationCard::onBrowseValue);
     connect(removeButton, &QPushButton::clicked, this, &OperationCard::removeRequested);
     connect(moveUpButton, &QPushButton::clicked, this, &OperationCard::moveUpRequested);
     connect(moveDownButton, &QPushButton::clicked, this, &OperationCard::moveDownRequested);
@@ -105,14 +128,99 @@ void OperationCard::setupUI()
 
 void OperationCard::onTextChanged()
 {
-    // Restart the debounce timer on each keystroke
-    // This delays the operationChanged signal until user stops typing
-    debounceTimer->start();
+    rebuildOperation();
+}
+
+void OperationCard::rebuildOperation()
+{
+    // Patterns are compiled and validated (and files loaded) off the GUI thread; the
+    // previous operation stays in use until the new one is ready. Only the latest
+    // build is installed, so superseded keystrokes are never reported.
+    if (applyingSpec) {
+        return;
+    }
+    const int generation = ++buildGeneration;
+    const OperationSpec spec = getSpec();
+    auto *watcher = new QFutureWatcher<std::shared_ptr<Operation>>(this);
+    connect(watcher, &QFutureWatcher<std::shared_ptr<Operation>>::finished,
+            this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation != buildGeneration) {
+            return;
+        }
+        cachedOperation = watcher->result();
+        updateStatus();
+    
+        // Every edit is reported; PreviewScheduler decides how to coalesce them
+        emit operationChanged();
+    });
+    watcher->setFuture(QtConcurrent::run([spec]() {
+        return OperationFactory::create(spec);
+    }));
+}
+
+QString OperationCard::conditionToolTip()
+{
+    return tr("Files that do not match skip this operation. Separate globs with ';'; "
+              "text without wildcards matches names containing it; "
+              "\"re:\" starts a regular expression.");
+}
+
+void OperationCard::onBrowseValue()
+{
+    const bool mapping = getOperationType() == OperationType::MappingFile;
+    const QString filePath = QFileDialog::getOpenFileName(
+        this,
+        mapping ? tr("Choose Mapping File") : tr("Choose Dictionary"),
+        valueEdit->text(),
+        mapping ? tr("Mapping Files (*.csv *.tsv *.txt);;All Files (*)")
+                : tr("Dictionaries (*.tsv *.txt);;All Files (*)")
+    );
+    if (!filePath.isEmpty()) {
+        valueEdit->setText(filePath);
+    }
+}
+
+void OperationCard::updateStatus()
+{
+    QString text;
+    bool error = false;
+    // Reads the operation (and the table) the build just installed
+    const std::shared_ptr<Operation> op = cachedOperation;
+    const OperationType type = op->getType();
+    if (type == OperationType::DictionaryReplace && !valueEdit->text().isEmpty()) {
+        const auto dictionary = std::static_pointer_cast<DictionaryReplaceOperation>(op);
+        error = dictionary->pairCount() < 0;
+        text = error ? dictionary->errorString()
+                     : tr("%n pair(s) loaded", nullptr, dictionary->pairCount());
+    } else if (type == OperationType::MappingFile && !valueEdit->text().isEmpty()) {
+        const auto mapping = std::static_pointer_cast<MappingFileOperation>(op);
+        error = mapping->rowCount() < 0;
+        text = error ? mapping->errorString()
+                     : tr("%n name(s) mapped", nullptr, int(mapping->rowCount()));
+    } else if (type == OperationType::Replace) {
+        // A pattern that does not compile leaves every name unchanged; say why
+        const auto replace = std::static_pointer_cast<ReplaceOperation>(op);
+        error = !replace->isValid();
+        text = replace->errorString();
+    }
+    
+    // An invalid condition matches no file; say why next to the field
+    const OperationCondition &condition = op->condition();
+    conditionEdit->setToolTip(condition.isValid() ? conditionToolTip() : condition.errorString());
+    
+    statusLabel->setText(text);
+    statusLabel->setVisible(!text.isEmpty());
+    if (statusLabel->property("error").toBool() != error) {
+        statusLabel->setProperty("error", error);
+        statusLabel->style()->unpolish(statusLabel);
+        statusLabel->style()->polish(statusLabel);
+    }
 }
 
-QString OperationCard::getOperationType() const
+OperationType OperationCard::getOperationType() const
 {
-    return operationTypeCombo->currentData().toString();
+    return OperationType(operationTypeCombo->currentData().toInt());
 }
 
 QString OperationCard::getOperationValue() const
@@ -125,18 +233,16 @@ QString OperationCard::getReplacementValue() const
     return replacementEdit->text();
 }
 
-QString OperationCard::getCaseType() const
+ChangeCaseOperation::CaseType OperationCard::getCaseType() const
 {
-    return caseTypeCombo->currentData().toString();
+    return ChangeCaseOperation::CaseType(caseTypeCombo->currentData().toInt());
 }
 
-void OperationCard::setOperationType(const QString &type)
+void OperationCard::setOperationType(OperationType type)
 {
-    for (int i = 0; i < operationTypeCombo->count(); ++i) {
-        if (operationTypeCombo->itemData(i).toString() == type) {
-            operationTypeCombo->setCurrentIndex(i);
-            break;
-        }
+    int index = operationTypeCombo->findData(int(type));
+    if (index >= 0) {
+        operationTypeCombo->setCurrentIndex(index);
     }
 }
 
@@ -145,18 +251,74 @@ void OperationCard::setOperationValue(const QString &value)
     valueEdit->setText(value);
 }
 
+void OperationCard::setReplacementValue(const QString &value)
+{
+    replacementEdit->setText(value);
+}
+
+QString OperationCard::getCondition() const
+{
+    return conditionEdit->text();
+}
+
+void OperationCard::setCondition(const QString &condition)
+{
+    conditionEdit->setText(condition);
+}
+
+void OperationCard::setCaseType(ChangeCaseOperation::CaseType caseType)
+{
+    int index = caseTypeCombo->findData(int(caseType));
+    if (index >= 0) {
+        caseTypeCombo->setCurrentIndex(index);
+    }
+}
+
+OperationSpec OperationCard::getSpec() const
+{
+    OperationSpec spec;
+    spec.type = getOperationType();
+    spec.value = getOperationValue();
+    spec.replacement = getReplacementValue();
+    spec.caseType = getCaseType();
+    spec.condition = getCondition();
+    return spec;
+}
+
+void OperationCard::setSpec(const OperationSpec &spec)
+{
+    // Apply all fields, then build once in the background like any edit; until the
+    // build finishes the card is not ready, so no preview runs with the old operation
+    applyingSpec = true;
+    setOperationType(spec.type);
+    setOperationValue(spec.value);
+    setReplacementValue(spec.replacement);
+    setCaseType(spec.caseType);
+    setCondition(spec.condition);
+    applyingSpec = false;
+    cachedOperation.reset();
+    rebuildOperation();
+}
+
 void OperationCard::onOperationTypeChanged(int index)
 {
     Q_UNUSED(index);
     updateValueFieldVisibility();
-    emit operationChanged();
+    rebuildOperation();
+}
+
+void OperationCard::onCaseTypeChanged(int index)
+{
+    Q_UNUSED(index);
+    rebuildOperation();
 }
 
 void OperationCard::updateValueFieldVisibility()
 {
-    QString type = getOperationType();
+    OperationType type = getOperationType();
+    browseButton->setVisible(type == OperationType::DictionaryReplace || type == OperationType::MappingFile);
     
-    if (type == "replace") {
+    if (type == OperationType::Replace) {
         valueLabel->setText(tr("Pattern:"));
         valueLabel->show();
         valueEdit->show();
@@ -165,7 +327,7 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->show();
         caseTypeLabel->hide();
         caseTypeCombo->hide();
-    } else if (type == "prefix") {
+    } else if (type == OperationType::Prefix) {
         valueLabel->setText(tr("Prefix:"));
         valueLabel->show();
         valueEdit->show();
@@ -174,7 +336,7 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->hide();
         caseTypeLabel->hide();
         caseTypeCombo->hide();
-    } else if (type == "suffix") {
+    } else if (type == OperationType::Suffix) {
         valueLabel->setText(tr("Suffix:"));
         valueLabel->show();
         valueEdit->show();
@@ -183,7 +345,7 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->hide();
         caseTypeLabel->hide();
         caseTypeCombo->hide();
-    } else if (type == "insert") {
+    } else if (type == OperationType::Insert) {
         valueLabel->setText(tr("Position:"));
         valueLabel->show();
         valueEdit->show();
@@ -194,7 +356,7 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->setPlaceholderText(tr("Enter text to insert..."));
         caseTypeLabel->hide();
         caseTypeCombo->hide();
-    } else if (type == "change_ext") {
+    } else if (type == OperationType::ChangeExtension) {
         valueLabel->setText(tr("New Extension:"));
         valueLabel->show();
         valueEdit->show();
@@ -203,14 +365,14 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->hide();
         caseTypeLabel->hide();
         caseTypeCombo->hide();
-    } else if (type == "change_case") {
+    } else if (type == OperationType::ChangeCase) {
         valueLabel->hide();
         valueEdit->hide();
         replacementLabel->hide();
         replacementEdit->hide();
         caseTypeLabel->show();
         caseTypeCombo->show();
-    } else if (type == "new_name") {
+    } else if (type == OperationType::NewName) {
         valueLabel->setText(tr("New Name:"));
         valueLabel->show();
         valueEdit->show();
@@ -219,5 +381,23 @@ void OperationCard::updateValueFieldVisibility()
         replacementEdit->hide();
         caseTypeLabel->hide();
         caseTypeCombo->hide();
+    } else if (type == OperationType::DictionaryReplace) {
+        valueLabel->setText(tr("Dictionary:"));
+        valueLabel->show();
+        valueEdit->show();
+        valueEdit->setPlaceholderText(tr("File with one find<TAB>replacement pair per line..."));
+        replacementLabel->hide();
+        replacementEdit->hide();
+        caseTypeLabel->hide();
+        caseTypeCombo->hide();
+    } else if (type == OperationType::MappingFile) {
+        valueLabel->setText(tr("Mapping File:"));
+        valueLabel->show();
+        valueEdit->show();
+        valueEdit->setPlaceholderText(tr("CSV or TSV file with old name (or path) and new name..."));
+        replacementLabel->hide();
+        replacementEdit->hide();
+        caseTypeLabel->hide();
+        caseTypeCombo->hide();
     }
 }
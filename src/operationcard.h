@@ -9,7 +9,8 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFrame>
-#include <QTimer>
+#include <memory>
+#include "operationfactory.h"
 
 class OperationCard : public QFrame
 {
@@ -18,12 +19,26 @@ class OperationCard : public QFrame
 public:
     explicit OperationCard(QWidget *parent = nullptr);
     
-    QString getOperationType() const;
+    OperationType getOperationType() const;
     QString getOperationValue() const;
     QString getReplacementValue() const;  // New method for replacement text
-    QString getCaseType() const;  // Get selected case type
-    void setOperationType(const QString &type);
+    ChangeCaseOperation::CaseType getCaseType() const;  // Get selected case type
+    void setOperationType(OperationType type);
     void setOperationValue(const QString &value);
+    void setReplacementValue(const QString &value);
+    void setCaseType(ChangeCaseOperation::CaseType caseType);
+    QString getCondition() const;
+    void setCondition(const QString &condition);
+    
+    OperationSpec getSpec() const;
+    void setSpec(const OperationSpec &spec);
+    
+    // The operation for the current inputs; built in the background after this card's
+    // inputs change, so it is the previous one until the build finishes
+    std::shared_ptr<Operation> operation() const { return cachedOperation; }
+    
+    // Whether the first build (of a new card or after setSpec()) has finished
+    bool isReady() const { return cachedOperation != nullptr; }
 
 signals:
     void operationChanged();
@@ -33,23 +48,33 @@ signals:
 
 private slots:
     void onOperationTypeChanged(int index);
+    void onCaseTypeChanged(int index);
     void onTextChanged();
+    void onBrowseValue();
 
 private:
     void setupUI();
     void updateValueFieldVisibility();
+    void rebuildOperation();
+    void updateStatus();
+    static QString conditionToolTip();
 
     QComboBox *operationTypeCombo;
     QComboBox *caseTypeCombo;  // For change_case operation
     QLineEdit *valueEdit;
+    QPushButton *browseButton;  // Picks the dictionary or mapping file
     QLineEdit *replacementEdit;
     QLabel *valueLabel;
     QLabel *caseTypeLabel;  // Label for case type combo
     QLabel *replacementLabel;
+    QLineEdit *conditionEdit;  // Limits the operation to matching files
+    QLabel *statusLabel;       // What was loaded, or why the operation does nothing
     QPushButton *removeButton;
     QPushButton *moveUpButton;
     QPushButton *moveDownButton;
-    QTimer *debounceTimer;
+    std::shared_ptr<Operation> cachedOperation; // Replaced when a rebuild finishes
+    int buildGeneration = 0;   // Incremented per rebuild; only the latest one is installed
+    bool applyingSpec = false; // setSpec() starts one build after all fields are set
 };
 
 #endif // OPERATIONCARD_H
@@ -0,0 +1,94 @@
+#include "operationfactory.h"
+#include <iterator>
+
+namespace {
+
+using Creator = std::shared_ptr<Operation> (*)(const OperationSpec &spec);
+
+struct Registration {
+    OperationType type;
+    const char *id;
+    Creator create;
+};
+
+// Indexed by OperationType; identifiers are persisted in presets and must not change
+const Registration Registry[] = {
+    {OperationType::Replace, "replace", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<ReplaceOperation>(spec.value, spec.replacement);
+    }},
+    {OperationType::Prefix, "prefix", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<PrefixOperation>(spec.value);
+    }},
+    {OperationType::Suffix, "suffix", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<SuffixOperation>(spec.value);
+    }},
+    {OperationType::Insert, "insert", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<InsertOperation>(spec.value.toInt(), spec.replacement);
+    }},
+    {OperationType::ChangeExtension, "change_ext", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<ChangeExtensionOperation>(spec.value);
+    }},
+    {OperationType::ChangeCase, "change_case", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<ChangeCaseOperation>(spec.caseType);
+    }},
+    {OperationType::NewName, "new_name", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<NewNameOperation>(spec.value);
+    }},
+    {OperationType::DictionaryReplace, "dictionary_replace", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<DictionaryReplaceOperation>(spec.value);
+    }},
+    {OperationType::MappingFile, "mapping_file", [](const OperationSpec &spec) -> std::shared_ptr<Operation> {
+        return std::make_shared<MappingFileOperation>(spec.value);
+    }},
+};
+
+constexpr int RegistrySize = int(std::size(Registry));
+static_assert(RegistrySize == int(OperationType::MappingFile) + 1,
+              "Every OperationType needs a registry entry");
+
+const char *const CaseTypeIds[] = {"lowercase", "uppercase", "titlecase"};
+
+} // namespace
+
+std::shared_ptr<Operation> OperationFactory::create(const OperationSpec &spec)
+{
+    const Registration &registration = Registry[int(spec.type)];
+    Q_ASSERT(registration.type == spec.type);
+    std::shared_ptr<Operation> operation = registration.create(spec);
+    if (!spec.condition.isEmpty()) {
+        operation->setCondition(OperationCondition(spec.condition));
+    }
+    return operation;
+}
+
+QString OperationFactory::typeId(OperationType type)
+{
+    return QString::fromLatin1(Registry[int(type)].id);
+}
+
+bool OperationFactory::typeFromId(const QString &id, OperationType &type)
+{
+    for (const Registration &registration : Registry) {
+        if (id == QLatin1String(registration.id)) {
+            type = registration.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString OperationFactory::caseTypeId(ChangeCaseOperation::CaseType caseType)
+{
+    return QString::fromLatin1(CaseTypeIds[caseType]);
+}
+
+bool OperationFactory::caseTypeFromId(const QString &id, ChangeCaseOperation::CaseType &caseType)
+{
+    for (int i = 0; i < int(std::size(CaseTypeIds)); ++i) {
+        if (id == QLatin1String(CaseTypeIds[i])) {
+            caseType = ChangeCaseOperation::CaseType(i);
+            return true;
+        }
+    }
+    return false;
+}
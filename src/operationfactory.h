@@ -0,0 +1,57 @@
+#ifndef OPERATIONFACTORY_H
+#define OPERATIONFACTORY_H
+
+#include <QString>
+#include <memory>
+#include "operation.h"
+
+/**
+ * @brief Widget-independent description of one operation in a chain.
+ */
+struct OperationSpec {
+    OperationType type = OperationType::Replace;
+    QString value;        // Pattern, prefix, suffix, position, extension, new name, dictionary or mapping file
+    QString replacement;  // Replacement text (replace) or text to insert (insert)
+    ChangeCaseOperation::CaseType caseType = ChangeCaseOperation::Lowercase;  // change_case only
+    QString condition;    // OperationCondition text; empty applies to every file
+};
+
+/**
+ * @brief Creates operations from specs through a registry keyed by OperationType.
+ *
+ * Each registry entry holds the stable identifier used in presets and the
+ * function that builds the operation, so adding an operation type means adding
+ * one enum value and one registry entry.
+ */
+class OperationFactory
+{
+public:
+    /**
+     * @brief Build the operation described by a spec.
+     */
+    static std::shared_ptr<Operation> create(const OperationSpec &spec);
+    
+    /**
+     * @brief Get the stable identifier of an operation type (e.g. "replace", "change_ext").
+     */
+    static QString typeId(OperationType type);
+    
+    /**
+     * @brief Look up an operation type by its identifier.
+     * @return True if the identifier is known
+     */
+    static bool typeFromId(const QString &id, OperationType &type);
+    
+    /**
+     * @brief Get the stable identifier of a case type ("lowercase", "uppercase", "titlecase").
+     */
+    static QString caseTypeId(ChangeCaseOperation::CaseType caseType);
+    
+    /**
+     * @brief Look up a case type by its identifier.
+     * @return True if the identifier is known
+     */
+    static bool caseTypeFromId(const QString &id, ChangeCaseOperation::CaseType &caseType);
+};
+
+#endif // OPERATIONFACTORY_H
@@ -46,56 +46,66 @@ void OperationListWidget::setupUI()
 
 QList<std::shared_ptr<Operation>> OperationListWidget::getOperations() const
 {
+    // Cards keep their operation between calls, so only edited cards rebuild theirs
     QList<std::shared_ptr<Operation>> operations;
+    operations.reserve(operationCards.size());
     for (OperationCard *card : operationCards) {
-        QString type = card->getOperationType();
-        QString value = card->getOperationValue();
-        
-        std::shared_ptr<Operation> op = nullptr;
-        if (type == "replace") {
-            QString pattern = value;
-            QString replacement = card->getReplacementValue();
-            op = std::make_shared<ReplaceOperation>(pattern, replacement);
-        } else if (type == "prefix") {
-            op = std::make_shared<PrefixOperation>(value);
-        } else if (type == "suffix") {
-            op = std::make_shared<SuffixOperation>(value);
-        } else if (type == "insert") {
-            int position = value.toInt();
-            QString text = card->getReplacementValue();
-            op = std::make_shared<InsertOperation>(position, text);
-        } else if (type == "change_ext") {
-            op = std::make_shared<ChangeExtensionOperation>(value);
-        } else if (type == "change_case") {
-            QString caseType = card->getCaseType();
-            ChangeCaseOperation::CaseType ct;
-            if (caseType == "lowercase") {
-                ct = ChangeCaseOperation::Lowercase;
-            } else if (caseType == "uppercase") {
-                ct = ChangeCaseOperation::Uppercase;
-            } else if (caseType == "titlecase") {
-                ct = ChangeCaseOperation::TitleCase;
-            } else {
-                ct = ChangeCaseOperation::Lowercase;  // Default
-            }
-            op = std::make_shared<ChangeCaseOperation>(ct);
-        } else if (type == "new_name") {
-            op = std::make_shared<NewNameOperation>(value);
-        }
-        
-        if (op) {
-            operations.append(op);
-        }
+        operations.append(card->operation());
     }
     return operations;
 }
 
+bool OperationListWidget::isReady() const
+{
+    for (const OperationCard *card : operationCards) {
+        if (!card->isReady()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QList<OperationSpec> OperationListWidget::getOperationSpecs() const
+{
+    QList<OperationSpec> specs;
+    specs.reserve(operationCards.size());
+    for (OperationCard *card : operationCards) {
+        specs.append(card->getSpec());
+    }
+    return specs;
+}
+
+void OperationListWidget::setOperationSpecs(const QList<OperationSpec> &specs)
+{
+    // Replace all cards, then notify once
+    for (OperationCard *card : operationCards) {
+        operationsLayout->removeWidget(card);
+        card->deleteLater();
+    }
+    operationCards.clear();
+    
+    for (const OperationSpec &spec : specs) {
+        createCard()->setSpec(spec);
+    }
+    
+    updateOperationButtons();
+    emit operationsChanged();
+}
+
 void OperationListWidget::addOperation()
 {
     onAddOperation();
 }
 
 void OperationListWidget::onAddOperation()
+{
+    createCard();
+    
+    updateOperationButtons();
+    emit operationsChanged();
+}
+
+OperationCard *OperationListWidget::createCard()
 {
     OperationCard *card = new OperationCard(scrollWidget);
     
@@ -114,8 +124,7 @@ void OperationListWidget::onAddOperation()
     int index = operationsLayout->count() - 1;
     operationsLayout->insertWidget(index, card);
     
-    updateOperationButtons();
-    emit operationsChanged();
+    return card;
 }
 
 void OperationListWidget::onRemoveOperation()
@@ -7,6 +7,7 @@
 #include <QScrollArea>
 #include <QList>
 #include <memory>
+#include "operationfactory.h"
 
 class OperationCard;
 class Operation;
@@ -19,6 +20,9 @@ public:
     explicit OperationListWidget(QWidget *parent = nullptr);
     
     QList<std::shared_ptr<Operation>> getOperations() const;
+    bool isReady() const;  // Every card has built its operation (see OperationCard::isReady())
+    QList<OperationSpec> getOperationSpecs() const;
+    void setOperationSpecs(const QList<OperationSpec> &specs);
     void addOperation();
 
 signals:
@@ -34,6 +38,7 @@ private slots:
 private:
     void setupUI();
     void updateOperationButtons();
+    OperationCard *createCard();
 
     QVBoxLayout *operationsLayout;
     QScrollArea *scrollArea;
@@ -0,0 +1,138 @@
+#include "preset.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCborValue>
+#include <QObject>
+
+namespace {
+
+const char *const FormatName = "regex-rename-preset";
+constexpr int FormatVersion = 2;
+constexpr int ConditionVersion = 2; // First version with operation conditions
+
+QJsonObject toJson(const QList<OperationSpec> &operations)
+{
+    QJsonArray array;
+    int version = 1;
+    for (const OperationSpec &spec : operations) {
+        QJsonObject object;
+        object["type"] = OperationFactory::typeId(spec.type);
+        // Only store the fields that are set to keep presets readable
+        if (!spec.value.isEmpty()) {
+            object["value"] = spec.value;
+        }
+        if (!spec.replacement.isEmpty()) {
+            object["replacement"] = spec.replacement;
+        }
+        if (spec.type == OperationType::ChangeCase) {
+            object["caseType"] = OperationFactory::caseTypeId(spec.caseType);
+        }
+        if (!spec.condition.isEmpty()) {
+            object["condition"] = spec.condition;
+            version = ConditionVersion;
+        }
+        array.append(object);
+    }
+    
+    QJsonObject root;
+    root["format"] = FormatName;
+    // Older versions would ignore conditions and rename every file, so presets that
+    // use them are marked with the version that introduced them
+    root["version"] = version;
+    root["operations"] = array;
+    return root;
+}
+
+bool fromJson(const QJsonObject &root, QList<OperationSpec> &operations, QString &errorMessage)
+{
+    if (root.value("format").toString() != FormatName) {
+        errorMessage = QObject::tr("The file is not a Regex Rename preset.");
+        return false;
+    }
+    if (root.value("version").toInt() > FormatVersion) {
+        errorMessage = QObject::tr("The preset was created by a newer version of Regex Rename.");
+        return false;
+    }
+    
+    operations.clear();
+    const QJsonArray array = root.value("operations").toArray();
+    operations.reserve(array.size());
+    for (const QJsonValue &value : array) {
+        const QJsonObject object = value.toObject();
+        OperationSpec spec;
+        const QString type = object.value("type").toString();
+        if (!OperationFactory::typeFromId(type, spec.type)) {
+            errorMessage = QObject::tr("Unknown operation type '%1'.").arg(type);
+            return false;
+        }
+        spec.value = object.value("value").toString();
+        spec.replacement = object.value("replacement").toString();
+        spec.condition = object.value("condition").toString();
+        // Unknown or missing case types fall back to lowercase
+        OperationFactory::caseTypeFromId(object.value("caseType").toString(), spec.caseType);
+        operations.append(spec);
+    }
+    return true;
+}
+
+} // namespace
+
+bool Preset::load(const QString &filePath, QList<OperationSpec> &operations, QString &errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    return fromData(file.readAll(), operations, errorMessage);
+}
+
+bool Preset::fromData(const QByteArray &data, QList<OperationSpec> &operations, QString &errorMessage)
+{
+    // JSON presets start with '{' (possibly after whitespace), CBOR ones with a map header
+    const QByteArray trimmed = data.trimmed();
+    if (trimmed.startsWith('{')) {
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(data, &parseError);
+        if (parseError.error != QJsonParseError::NoError) {
+            errorMessage = parseError.errorString();
+            return false;
+        }
+        return fromJson(document.object(), operations, errorMessage);
+    }
+    
+    QCborParserError parseError;
+    const QCborValue value = QCborValue::fromCbor(data, &parseError);
+    if (parseError.error != QCborError::NoError) {
+        errorMessage = parseError.errorString();
+        return false;
+    }
+    return fromJson(value.toJsonValue().toObject(), operations, errorMessage);
+}
+
+QByteArray Preset::toCbor(const QList<OperationSpec> &operations)
+{
+    return QCborValue::fromJsonValue(toJson(operations)).toCbor();
+}
+
+bool Preset::save(const QString &filePath, const QList<OperationSpec> &operations, QString &errorMessage)
+{
+    const QByteArray data = filePath.endsWith(".cbor", Qt::CaseInsensitive)
+        ? toCbor(operations)
+        : QJsonDocument(toJson(operations)).toJson(QJsonDocument::Indented);
+    
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
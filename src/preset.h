@@ -0,0 +1,44 @@
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <QString>
+#include <QList>
+#include "operationfactory.h"
+
+/**
+ * @brief Saved operation chains.
+ *
+ * Presets are stored as JSON for sharing and editing, or as CBOR (same structure)
+ * as a compact binary form. Loading yields OperationSpecs that can be turned into
+ * operations with OperationFactory, without creating any widgets.
+ */
+class Preset
+{
+public:
+    /**
+     * @brief Load a preset file; the format (JSON or CBOR) is detected from the content.
+     * @param filePath The preset file
+     * @param operations Receives the operation chain
+     * @param errorMessage Receives a description of the problem on failure
+     * @return True on success
+     */
+    static bool load(const QString &filePath, QList<OperationSpec> &operations, QString &errorMessage);
+
+    /**
+     * @brief Save a preset file; files ending in .cbor use the binary form, others JSON.
+     * @return True on success
+     */
+    static bool save(const QString &filePath, const QList<OperationSpec> &operations, QString &errorMessage);
+    
+    /**
+     * @brief Parse preset data held in memory (JSON or CBOR).
+     */
+    static bool fromData(const QByteArray &data, QList<OperationSpec> &operations, QString &errorMessage);
+    
+    /**
+     * @brief Encode an operation chain in the binary (CBOR) form.
+     */
+    static QByteArray toCbor(const QList<OperationSpec> &operations);
+};
+
+#endif // PRESET_H
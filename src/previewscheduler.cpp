@@ -0,0 +1,49 @@
+#include "previewscheduler.h"
+#include <QtGlobal>
+
+namespace {
+
+constexpr double InitialCostPerFile = 2000.0;  // 2 µs, until the first measurement
+constexpr double CostSmoothing = 0.3;          // Weight of the newest measurement
+constexpr qint64 ImmediateBudgetNs = 8000000;  // Updates below 8 ms run without delay
+constexpr int MinDelayMs = 30;
+constexpr int MaxDelayMs = 300;
+
+} // namespace
+
+PreviewScheduler::PreviewScheduler(QObject *parent)
+    : QObject(parent), costPerFile(InitialCostPerFile)
+{
+    coalesceTimer = new QTimer(this);
+    coalesceTimer->setSingleShot(true);
+    connect(coalesceTimer, &QTimer::timeout, this, &PreviewScheduler::updateRequested);
+}
+
+void PreviewScheduler::schedule(int fileCount)
+{
+    const qint64 cost = expectedCost(fileCount);
+    if (cost < ImmediateBudgetNs) {
+        coalesceTimer->stop();
+        emit updateRequested();
+        return;
+    }
+    
+    // Wait about as long as the update itself would take, so fast typing
+    // coalesces into one update instead of queuing expensive recomputes
+    const int delayMs = int(qBound<qint64>(MinDelayMs, cost / 1000000, MaxDelayMs));
+    coalesceTimer->start(delayMs);
+}
+
+void PreviewScheduler::recordCost(qint64 elapsedNs, int fileCount)
+{
+    if (fileCount <= 0) {
+        return;
+    }
+    const double sample = double(elapsedNs) / fileCount;
+    costPerFile = CostSmoothing * sample + (1.0 - CostSmoothing) * costPerFile;
+}
+
+qint64 PreviewScheduler::expectedCost(int fileCount) const
+{
+    return qint64(costPerFile * fileCount);
+}
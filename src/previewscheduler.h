@@ -0,0 +1,47 @@
+#ifndef PREVIEWSCHEDULER_H
+#define PREVIEWSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+
+/**
+ * @brief Decides when an input change triggers a preview update.
+ *
+ * Keeps a moving average of the measured preview cost per file. When the
+ * expected cost of the next update is below a frame, updates run immediately;
+ * otherwise changes are coalesced for a delay that grows with the expected cost.
+ */
+class PreviewScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewScheduler(QObject *parent = nullptr);
+    
+    /**
+     * @brief Request a preview update after an input change.
+     * @param fileCount Number of files the update will process
+     */
+    void schedule(int fileCount);
+    
+    /**
+     * @brief Record the measured duration of a completed preview update.
+     * @param elapsedNs Wall-clock time of the update in nanoseconds
+     * @param fileCount Number of files it processed
+     */
+    void recordCost(qint64 elapsedNs, int fileCount);
+    
+    /**
+     * @brief Expected duration of an update over the given number of files, in nanoseconds.
+     */
+    qint64 expectedCost(int fileCount) const;
+
+signals:
+    void updateRequested();
+
+private:
+    QTimer *coalesceTimer;
+    double costPerFile; // Moving average in nanoseconds
+};
+
+#endif // PREVIEWSCHEDULER_H
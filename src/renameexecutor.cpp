@@ -0,0 +1,449 @@
+#include "renameexecutor.h"
+#include "iouring.h"
+#include "filemetadata.h"
+#include "filenamecodec.h"
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QThread>
+#include <QtConcurrent>
+#include <QSet>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+int renameNoReplace(const QByteArray &source, const QByteArray &target)
+{
+#ifdef Q_OS_LINUX
+    if (::renameat2(AT_FDCWD, source.constData(), AT_FDCWD, target.constData(), RENAME_NOREPLACE) == 0) {
+        return 0;
+    }
+    // Some file systems (e.g. older network file systems) do not implement the flag
+    if (errno != EINVAL && errno != ENOSYS) {
+        return errno;
+    }
+    struct stat info;
+    const bool exists = ::lstat(target.constData(), &info) == 0;
+#else
+    const bool exists = QFile::exists(FileNameCodec::decode(target));
+#endif
+    if (exists) {
+        return EEXIST;
+    }
+    return std::rename(source.constData(), target.constData()) == 0 ? 0 : errno;
+}
+
+// Move to another file system: copy into a new file, then unlink the source. On Linux
+// copy_file_range lets the kernel copy without a round trip through user space (or
+// share extents where the file systems support it); read/write is the last resort.
+int copyAndUnlink(const QByteArray &source, const QByteArray &target)
+{
+#ifdef Q_OS_LINUX
+    const int in = ::open(source.constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return errno;
+    }
+    struct stat info;
+    if (::fstat(in, &info) != 0) {
+        const int error = errno;
+        ::close(in);
+        return error;
+    }
+    // O_EXCL keeps the no-overwrite guarantee of the rename
+    const int out = ::open(target.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, info.st_mode & 07777);
+    if (out < 0) {
+        const int error = errno;
+        ::close(in);
+        return error;
+    }
+    
+    int error = 0;
+    bool useCopyRange = true;
+    QByteArray buffer;
+    while (true) {
+        ssize_t copied;
+        if (useCopyRange) {
+            copied = ::copy_file_range(in, nullptr, out, nullptr, size_t(1) << 30, 0);
+            if (copied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL
+                               || errno == EOPNOTSUPP)) {
+                // Both offsets have advanced by what was copied so far; continue from there
+                useCopyRange = false;
+                continue;
+            }
+        } else {
+            if (buffer.isEmpty()) {
+                buffer.resize(1 << 20);
+            }
+            copied = ::read(in, buffer.data(), size_t(buffer.size()));
+            for (ssize_t written = 0; copied > 0 && written < copied;) {
+                const ssize_t n = ::write(out, buffer.constData() + written, size_t(copied - written));
+                if (n < 0 && errno != EINTR) {
+                    copied = -1;
+                    break;
+                }
+                written += qMax<ssize_t>(n, 0);
+            }
+        }
+        if (copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        if (copied == 0) {
+            break;
+        }
+    }
+    
+    if (error == 0) {
+        const struct timespec times[2] = {info.st_atim, info.st_mtim};
+        ::futimens(out, times);
+    }
+    if (::close(out) != 0 && error == 0) {
+        error = errno;
+    }
+    ::close(in);
+    if (error == 0 && ::unlink(source.constData()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        // Leave the source as it was
+        ::unlink(target.constData());
+    }
+    return error;
+#else
+    const QString sourcePath = FileNameCodec::decode(source);
+    const QString targetPath = FileNameCodec::decode(target);
+    if (QFile::exists(targetPath)) {
+        return EEXIST;
+    }
+    if (!QFile::copy(sourcePath, targetPath)) {
+        return EIO;
+    }
+    if (!QFile::remove(sourcePath)) {
+        QFile::remove(targetPath);
+        return EIO;
+    }
+    return 0;
+#endif
+}
+
+int moveFile(const QByteArray &source, const QByteArray &target)
+{
+    const int error = renameNoReplace(source, target);
+    return error == EXDEV ? copyAndUnlink(source, target) : error;
+}
+
+// Create a folder and its missing parents; 0 or the errno value
+int makePath(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    const QByteArray encoded = FileNameCodec::encode(path);
+    if (::mkdir(encoded.constData(), 0777) == 0 || errno == EEXIST) {
+        return 0;
+    }
+    if (errno != ENOENT) {
+        return errno;
+    }
+    const QString parent = QFileInfo(path).path();
+    if (parent == path) {
+        return ENOENT;
+    }
+    const int error = makePath(parent);
+    if (error != 0) {
+        return error;
+    }
+    return ::mkdir(encoded.constData(), 0777) == 0 || errno == EEXIST ? 0 : errno;
+#else
+    return QDir().mkpath(path) ? 0 : EACCES;
+#endif
+}
+
+// Run the renames of a chain in order from position first; stop at the first failure
+void runChain(const QList<int> &chain, qsizetype first, const QList<QByteArray> &sources,
+              const QList<QByteArray> &targets, const int *blocked, int *results,
+              std::atomic<int> *completed)
+{
+    for (qsizetype k = first; k < chain.size(); ++k) {
+        const int task = chain[k];
+        results[task] = blocked[task] != 0 ? blocked[task] : moveFile(sources[task], targets[task]);
+        if (results[task] != 0) {
+            for (qsizetype rest = k + 1; rest < chain.size(); ++rest) {
+                results[chain[rest]] = ECANCELED;
+            }
+            if (completed) {
+                completed->fetch_add(int(chain.size() - k), std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (completed) {
+            completed->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace
+
+RenameExecutor::RenameExecutor(Backend backend)
+    : activeBackend(backend)
+{
+    if (activeBackend == AutomaticBackend) {
+        activeBackend = isIoUringAvailable() ? IoUringBackend : ThreadPoolBackend;
+    }
+    pool.setMaxThreadCount(qMax(8, QThread::idealThreadCount() * 2));
+}
+
+QString RenameExecutor::backendName(Backend backend)
+{
+    switch (backend) {
+        case AutomaticBackend: return QStringLiteral("automatic");
+        case ThreadPoolBackend: return QStringLiteral("thread pool");
+        case IoUringBackend: return QStringLiteral("io_uring");
+    }
+    return QString();
+}
+
+bool RenameExecutor::isIoUringAvailable()
+{
+#ifdef REGEX_RENAME_HAVE_IO_URING
+    static const bool available = IoUring(8).supports(IORING_OP_RENAMEAT);
+    return available;
+#else
+    return false;
+#endif
+}
+
+QString RenameExecutor::errorString(int error)
+{
+    return QString::fromLocal8Bit(std::strerror(error));
+}
+
+QList<QList<int>> RenameExecutor::buildChains(const QList<RenameTask> &tasks)
+{
+    const qsizetype count = tasks.size();
+    QHash<QString, int> taskBySource;
+    taskBySource.reserve(count);
+    for (int t = 0; t < count; ++t) {
+        taskBySource.insert(tasks[t].source, t);
+    }
+    
+    // A rename onto the source of another rename has to wait for that one
+    QList<int> next(count, -1);
+    QList<char> waits(count, 0);
+    for (int t = 0; t < count; ++t) {
+        const int before = taskBySource.value(tasks[t].target, -1);
+        if (before >= 0 && before != t && next[before] < 0) {
+            next[before] = t;
+            waits[t] = 1;
+        }
+    }
+    
+    QList<QList<int>> chains;
+    QList<char> visited(count, 0);
+    auto follow = [&](int start) {
+        QList<int> chain;
+        for (int t = start; t >= 0 && !visited[t]; t = next[t]) {
+            visited[t] = 1;
+            chain.append(t);
+        }
+        chains.append(chain);
+    };
+    for (int t = 0; t < count; ++t) {
+        if (!waits[t]) {
+            follow(t);
+        }
+    }
+    // What is left are cycles (a -> b -> a); their first rename fails with EEXIST
+    for (int t = 0; t < count; ++t) {
+        if (!visited[t]) {
+            follow(t);
+        }
+    }
+    return chains;
+}
+
+QList<int> RenameExecutor::run(const QList<RenameTask> &tasks, std::atomic<int> *completed)
+{
+    QList<int> results(tasks.size(), 0);
+    if (tasks.isEmpty()) {
+        return results;
+    }
+    progress = completed;
+    
+    // Encode every path once up front; the io_uring entries point into these buffers
+    QList<QByteArray> sources;
+    QList<QByteArray> targets;
+    sources.reserve(tasks.size());
+    targets.reserve(tasks.size());
+    for (const RenameTask &task : tasks) {
+        sources.append(FileNameCodec::encode(task.source));
+        targets.append(FileNameCodec::encode(task.target));
+    }
+    
+    // Renames into a folder that could not be created fail with that folder's error
+    const QHash<QString, int> directoryErrors = createTargetDirectories(tasks);
+    QList<int> blocked(tasks.size(), 0);
+    if (!directoryErrors.isEmpty()) {
+        for (qsizetype t = 0; t < tasks.size(); ++t) {
+            blocked[t] = directoryErrors.value(QFileInfo(tasks[t].target).path(), 0);
+        }
+    }
+    
+    const QList<QList<int>> chains = buildChains(tasks);
+    if (activeBackend != IoUringBackend || !runOnIoUring(chains, sources, targets, blocked, results)) {
+        runOnThreadPool(chains, sources, targets, blocked, results);
+    }
+    progress = nullptr;
+    return results;
+}
+
+QStringList RenameExecutor::targetDirectories(const QList<RenameTask> &tasks)
+{
+    QSet<QString> directories;
+    for (const RenameTask &task : tasks) {
+        const QString directory = QFileInfo(task.target).path();
+        if (directory != QFileInfo(task.source).path()) {
+            directories.insert(directory);
+        }
+    }
+    QStringList sorted(directories.cbegin(), directories.cend());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+QHash<QString, int> RenameExecutor::createTargetDirectories(const QList<RenameTask> &tasks)
+{
+    // Each target folder once per batch, however many files move into it; existing ones
+    // are found with one batched stat pass, and sorting creates parents first
+    QHash<QString, int> errors;
+    const QStringList directories = targetDirectories(tasks);
+    const QList<FileMetadata> metadata = FileMetadata::readAll(directories);
+    for (qsizetype i = 0; i < directories.size(); ++i) {
+        if (metadata[i].type == FileMetadata::Directory) {
+            continue;
+        }
+        const int error = metadata[i].isValid() ? ENOTDIR : makePath(directories[i]);
+        if (error != 0) {
+            errors.insert(directories[i], error);
+        }
+    }
+    return errors;
+}
+
+void RenameExecutor::runOnThreadPool(const QList<QList<int>> &chains, const QList<QByteArray> &sources,
+                                     const QList<QByteArray> &targets, const QList<int> &blocked,
+                                     QList<int> &results)
+{
+    // Every chain writes only the results of its own tasks
+    int *data = results.data();
+    QtConcurrent::blockingMap(&pool, chains, [&](const QList<int> &chain) {
+        runChain(chain, 0, sources, targets, blocked.constData(), data, progress);
+    });
+}
+
+bool RenameExecutor::runOnIoUring(const QList<QList<int>> &chains, const QList<QByteArray> &sources,
+                                  const QList<QByteArray> &targets, const QList<int> &blocked,
+                                  QList<int> &results)
+{
+#ifdef REGEX_RENAME_HAVE_IO_URING
+    IoUring ring(RingEntries);
+    if (!ring.supports(IORING_OP_RENAMEAT)) {
+        return false;
+    }
+    
+    // Results of tasks that have not completed yet
+    constexpr int Pending = -1;
+    std::fill(results.begin(), results.end(), Pending);
+    
+    qsizetype nextChain = 0;
+    unsigned inFlight = 0;
+    int submitError = 0;
+    while (nextChain < chains.size() || inFlight > 0) {
+        // Queue whole chains while they fit; in-flight entries never exceed the
+        // submission queue size, so the (twice as large) completion queue cannot overflow
+        while (nextChain < chains.size() && submitError == 0) {
+            const QList<int> &chain = chains[nextChain];
+            const bool isBlocked = std::any_of(chain.cbegin(), chain.cend(),
+                                               [&blocked](int task) { return blocked[task] != 0; });
+            if (chain.size() > qsizetype(ring.capacity()) || isBlocked) {
+                // Too long to link in one submission, or bound to fail at a missing folder;
+                // keep its order by running it directly
+                runChain(chain, 0, sources, targets, blocked.constData(), results.data(), progress);
+                ++nextChain;
+                continue;
+            }
+            if (chain.size() > qsizetype(ring.freeEntries())
+                || inFlight + chain.size() > ring.capacity()) {
+                break;
+            }
+            for (qsizetype k = 0; k < chain.size(); ++k) {
+                const int task = chain[k];
+                ring.prepareRename(sources[task].constData(), targets[task].constData(),
+                                   RENAME_NOREPLACE, quint64(task), k + 1 < chain.size());
+            }
+            inFlight += unsigned(chain.size());
+            ++nextChain;
+        }
+        if (inFlight == 0) {
+            break;
+        }
+        
+        if (!ring.submit(1)) {
+            // Entries that were never accepted stay Pending and are reported with this error
+            submitError = errno;
+            break;
+        }
+        quint64 task = 0;
+        int result = 0;
+        while (ring.nextCompletion(task, result)) {
+            results[int(task)] = result < 0 ? -result : 0;
+            --inFlight;
+            // Renames that need a second pass are counted there
+            if (progress && result != -EINVAL && result != -EXDEV) {
+                progress->fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    for (int &result : results) {
+        if (result == Pending) {
+            result = submitError != 0 ? submitError : ECANCELED;
+        }
+    }
+    
+    // File systems without RENAME_NOREPLACE fail with EINVAL and moves to another file
+    // system with EXDEV; redo those chains from the failed rename, which falls back to
+    // check-then-rename or copy and unlink. The linked renames after it were cancelled.
+    for (const QList<int> &chain : chains) {
+        for (qsizetype k = 0; k < chain.size(); ++k) {
+            const int result = results[chain[k]];
+            if (result == EINVAL || result == EXDEV) {
+                if (progress) {
+                    progress->fetch_sub(int(chain.size() - k - 1), std::memory_order_relaxed);
+                }
+                runChain(chain, k, sources, targets, blocked.constData(), results.data(), progress);
+                break;
+            }
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(chains);
+    Q_UNUSED(sources);
+    Q_UNUSED(targets);
+    Q_UNUSED(blocked);
+    Q_UNUSED(results);
+    return false;
+#endif
+}
@@ -0,0 +1,101 @@
+#ifndef RENAMEEXECUTOR_H
+#define RENAMEEXECUTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QThreadPool>
+#include <atomic>
+
+/**
+ * @brief One rename of a batch.
+ */
+struct RenameTask {
+    QString source;
+    QString target;
+};
+
+/**
+ * @brief Runs a batch of renames in parallel.
+ *
+ * Targets are never overwritten (renameat2 with RENAME_NOREPLACE where
+ * available). Renames whose target is the source of another rename in the
+ * batch are put into a chain behind it, so "a -> b, b -> c" works in either
+ * order; a chain stops at its first failure. Independent chains run on a
+ * thread pool or, on Linux, are submitted in large batches through io_uring
+ * (IORING_OP_RENAMEAT, chains as linked entries).
+ *
+ * Targets may be in other folders: missing target folders are created once per
+ * batch before any file moves, and moves to another file system fall back to
+ * copy_file_range plus unlink.
+ */
+class RenameExecutor
+{
+public:
+    enum Backend {
+        AutomaticBackend,   // io_uring when the kernel supports it, otherwise the thread pool
+        ThreadPoolBackend,
+        IoUringBackend
+    };
+    
+    static constexpr unsigned RingEntries = 1024; // io_uring queue size; longer chains run directly
+    
+    explicit RenameExecutor(Backend backend = AutomaticBackend);
+    
+    /**
+     * @brief The backend that run() uses.
+     */
+    Backend backend() const { return activeBackend; }
+    
+    static QString backendName(Backend backend);
+    
+    /**
+     * @brief Check whether the io_uring backend can be used on this system.
+     */
+    static bool isIoUringAvailable();
+    
+    /**
+     * @brief Execute a batch; blocks until every rename finished.
+     * @param tasks The renames
+     * @param completed Incremented (from worker threads) for every finished rename, so
+     *                  another thread can show progress; may be null
+     * @return Per task 0 on success, otherwise the errno value; EEXIST if the target
+     *         exists, ECANCELED if an earlier rename of its chain failed
+     */
+    QList<int> run(const QList<RenameTask> &tasks, std::atomic<int> *completed = nullptr);
+    
+    /**
+     * @brief Group a batch into chains as run() executes them.
+     *
+     * A rename whose target is the source of another rename follows it in the same
+     * chain. Cycles end up as chains whose last target is their first source.
+     * @return Task indices per chain, in execution order
+     */
+    static QList<QList<int>> buildChains(const QList<RenameTask> &tasks);
+    
+    /**
+     * @brief Folders that files move into (other than their own), sorted so parents come first.
+     */
+    static QStringList targetDirectories(const QList<RenameTask> &tasks);
+    
+    /**
+     * @brief Describe an error returned by run().
+     */
+    static QString errorString(int error);
+    
+private:
+    QHash<QString, int> createTargetDirectories(const QList<RenameTask> &tasks);
+    void runOnThreadPool(const QList<QList<int>> &chains, const QList<QByteArray> &sources,
+                         const QList<QByteArray> &targets, const QList<int> &blocked,
+                         QList<int> &results);
+    bool runOnIoUring(const QList<QList<int>> &chains, const QList<QByteArray> &sources,
+                      const QList<QByteArray> &targets, const QList<int> &blocked,
+                      QList<int> &results);
+    
+    Backend activeBackend;
+    std::atomic<int> *progress = nullptr; // Counter of the running batch
+    QThreadPool pool; // Renames block on I/O, so more threads than cores pay off
+};
+
+#endif // RENAMEEXECUTOR_H
@@ -0,0 +1,264 @@
+#include "renamemapping.h"
+#include "filenamecodec.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QThread>
+#include <QtConcurrent>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// Bytes below which the file is parsed as one range
+constexpr qint64 MinimumRangeSize = 1 << 20;
+
+struct Row {
+    QString key;
+    QString value;
+    size_t hash;
+};
+
+// Rows of one range of lines
+struct ParsedRange {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    QList<Row> rows;
+    int lines = 0;       // Lines in the range
+    int errorLine = -1;  // Line within the range of the first malformed row
+    bool hasNameKeys = false;
+    bool hasPathKeys = false;
+};
+
+struct CachedMapping {
+    qint64 size = -1;
+    qint64 modified = 0;
+    std::weak_ptr<const RenameMapping> mapping;
+};
+
+QMutex cacheMutex;
+QHash<QString, CachedMapping> cache;
+
+// Read one field and advance past its delimiter; quotes are only special in CSV
+QByteArray readField(const char *&p, const char *end, char delimiter)
+{
+    if (delimiter == ',' && p < end && *p == '"') {
+        QByteArray field;
+        ++p;
+        while (p < end) {
+            if (*p == '"') {
+                if (p + 1 < end && p[1] == '"') {
+                    field += '"';
+                    p += 2;
+                    continue;
+                }
+                ++p;
+                break;
+            }
+            field += *p++;
+        }
+        // Anything between the closing quote and the delimiter is dropped
+        while (p < end && *p != delimiter) {
+            ++p;
+        }
+        if (p < end) {
+            ++p;
+        }
+        return field;
+    }
+    
+    const char *fieldEnd = static_cast<const char *>(std::memchr(p, delimiter, end - p));
+    if (!fieldEnd) {
+        fieldEnd = end;
+    }
+    QByteArray field(p, fieldEnd - p);
+    p = fieldEnd < end ? fieldEnd + 1 : end;
+    return field;
+}
+
+void parseRange(ParsedRange &range, char delimiter)
+{
+    const char *p = range.begin;
+    while (p < range.end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', range.end - p));
+        const char *next = lineEnd ? lineEnd + 1 : range.end;
+        if (!lineEnd) {
+            lineEnd = range.end;
+        }
+        if (lineEnd > p && lineEnd[-1] == '\r') {
+            --lineEnd;
+        }
+        
+        const int line = range.lines++;
+        if (lineEnd > p) {
+            const QByteArray oldName = readField(p, lineEnd, delimiter);
+            const QByteArray newName = readField(p, lineEnd, delimiter);
+            if (oldName.isEmpty() || newName.isEmpty()) {
+                if (range.errorLine < 0) {
+                    range.errorLine = line;
+                }
+            } else {
+                Row row;
+                row.key = FileNameCodec::decode(oldName);
+                const bool isPath = row.key.contains(QLatin1Char('/'));
+                if (isPath) {
+                    row.key = QDir::cleanPath(row.key);
+                }
+                range.hasPathKeys = range.hasPathKeys || isPath;
+                range.hasNameKeys = range.hasNameKeys || !isPath;
+                row.value = FileNameCodec::decode(newName);
+                row.hash = qHash(row.key);
+                range.rows.append(row);
+            }
+        }
+        p = next;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const RenameMapping> RenameMapping::load(const QString &filePath, QString &errorMessage)
+{
+    const QFileInfo info(filePath);
+    if (!info.isFile()) {
+        errorMessage = QObject::tr("Mapping file '%1' not found.").arg(filePath);
+        return nullptr;
+    }
+    const qint64 fileSize = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const QString key = info.absoluteFilePath();
+    
+    {
+        QMutexLocker locker(&cacheMutex);
+        const CachedMapping cached = cache.value(key);
+        if (cached.size == fileSize && cached.modified == modified) {
+            if (std::shared_ptr<const RenameMapping> mapping = cached.mapping.lock()) {
+                return mapping;
+            }
+        }
+    }
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return nullptr;
+    }
+    if (fileSize == 0) {
+        errorMessage = QObject::tr("Mapping file '%1' is empty.").arg(filePath);
+        return nullptr;
+    }
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        errorMessage = file.errorString();
+        return nullptr;
+    }
+    
+    const char *begin = reinterpret_cast<const char *>(data);
+    const char *end = begin + fileSize;
+    if (fileSize >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) {
+        begin += 3;
+    }
+    const char *firstLineEnd = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+    const char delimiter = std::memchr(begin, '\t', (firstLineEnd ? firstLineEnd : end) - begin) ? '\t' : ',';
+    
+    // Ranges start right after a line break, so every line belongs to exactly one
+    const int threads = qMax(QThread::idealThreadCount(), 1);
+    const int rangeCount = int(qBound<qint64>(1, fileSize / MinimumRangeSize, threads * 4));
+    QList<ParsedRange> ranges(rangeCount);
+    const char *rangeBegin = begin;
+    for (int r = 0; r < rangeCount; ++r) {
+        const char *rangeEnd = end;
+        if (r + 1 < rangeCount) {
+            rangeEnd = qMax(rangeBegin, begin + (end - begin) * (r + 1) / rangeCount);
+            const char *lineBreak = static_cast<const char *>(std::memchr(rangeEnd, '\n', end - rangeEnd));
+            rangeEnd = lineBreak ? lineBreak + 1 : end;
+        }
+        ranges[r].begin = rangeBegin;
+        ranges[r].end = rangeEnd;
+        rangeBegin = rangeEnd;
+    }
+    QtConcurrent::blockingMap(ranges, [delimiter](ParsedRange &range) {
+        parseRange(range, delimiter);
+    });
+    
+    qsizetype rowCount = 0;
+    int lineOffset = 0;
+    for (const ParsedRange &range : std::as_const(ranges)) {
+        if (range.errorLine >= 0) {
+            errorMessage = QObject::tr("Line %1 of '%2' does not have an old and a new name.")
+                               .arg(lineOffset + range.errorLine + 1).arg(filePath);
+            return nullptr;
+        }
+        lineOffset += range.lines;
+        rowCount += range.rows.size();
+    }
+    
+    auto mapping = std::make_shared<RenameMapping>();
+    for (const ParsedRange &range : std::as_const(ranges)) {
+        mapping->hasPathKeys = mapping->hasPathKeys || range.hasPathKeys;
+        mapping->hasNameKeys = mapping->hasNameKeys || range.hasNameKeys;
+    }
+    
+    // Each partition is built by one thread from the rows in file order, so the last
+    // row for a key wins without any locking
+    const int partitionCount = rowCount < MinimumRangeSize / 64 ? 1 : threads;
+    mapping->partitions.resize(partitionCount);
+    QList<int> partitionIndices(partitionCount);
+    std::iota(partitionIndices.begin(), partitionIndices.end(), 0);
+    QtConcurrent::blockingMap(partitionIndices, [&](int partition) {
+        QHash<QString, QString> &table = mapping->partitions[partition];
+        table.reserve(rowCount / partitionCount + 1);
+        for (const ParsedRange &range : std::as_const(ranges)) {
+            for (const Row &row : range.rows) {
+                if (int(row.hash % partitionCount) == partition) {
+                    table.insert(row.key, row.value);
+                }
+            }
+        }
+    });
+    
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(key, {fileSize, modified, mapping});
+    return mapping;
+}
+
+qsizetype RenameMapping::size() const
+{
+    qsizetype count = 0;
+    for (const QHash<QString, QString> &partition : partitions) {
+        count += partition.size();
+    }
+    return count;
+}
+
+const QString *RenameMapping::lookup(const QString &key) const
+{
+    const QHash<QString, QString> &partition = partitions[qHash(key) % partitions.size()];
+    const auto it = partition.constFind(key);
+    return it != partition.constEnd() ? &it.value() : nullptr;
+}
+
+const QString *RenameMapping::find(QStringView name, QStringView directory) const
+{
+    if (hasPathKeys && !directory.isEmpty()) {
+        QString path;
+        path.reserve(directory.size() + 1 + name.size());
+        path.append(directory);
+        if (!directory.endsWith(QLatin1Char('/'))) {
+            path.append(QLatin1Char('/'));
+        }
+        path.append(name);
+        if (const QString *newName = lookup(path)) {
+            return newName;
+        }
+    }
+    if (!hasNameKeys) {
+        return nullptr;
+    }
+    // Raw data: the name is not copied for the lookup
+    return lookup(QString::fromRawData(name.data(), name.size()));
+}
@@ -0,0 +1,59 @@
+#ifndef RENAMEMAPPING_H
+#define RENAMEMAPPING_H
+
+#include <QString>
+#include <QStringView>
+#include <QList>
+#include <QHash>
+#include <memory>
+
+/**
+ * @brief Old -> new name table read from a CSV or TSV mapping file.
+ *
+ * Each row holds the old name (or absolute path) and the new name of one file; the
+ * delimiter is a tab if the first line contains one, a comma otherwise. Comma-separated
+ * fields may be quoted ("a, b.jpg", with "" for a quote) but cannot span lines. Names
+ * are taken byte-exact (see FileNameCodec), an optional UTF-8 BOM and empty lines are
+ * skipped, and a later row with the same old name overrides an earlier one.
+ *
+ * The file is memory-mapped and split at line boundaries into ranges that are parsed
+ * in parallel; the rows are then spread over hash partitions, each built by one
+ * thread, so loading scales with the cores. Lookups hash the key once to find its
+ * partition and once inside it, without copying the name, so joining the table against
+ * the file list is one lookup per entry in the parallel preview pass.
+ */
+class RenameMapping
+{
+public:
+    /**
+     * @brief Load a mapping file.
+     *
+     * Mappings are cached by path, size and modification time, so operations rebuilt
+     * while editing share one table.
+     * @return The mapping, or null with errorMessage set if the file is unusable
+     */
+    static std::shared_ptr<const RenameMapping> load(const QString &filePath, QString &errorMessage);
+    
+    /**
+     * @brief Number of distinct old names and paths.
+     */
+    qsizetype size() const;
+    
+    /**
+     * @brief The new name of a file, or null if the mapping has none.
+     *
+     * An entry for the file's path takes precedence over one for its name.
+     * @param name Name of the file
+     * @param directory Absolute folder of the file
+     */
+    const QString *find(QStringView name, QStringView directory) const;
+
+private:
+    const QString *lookup(const QString &key) const;
+    
+    QList<QHash<QString, QString>> partitions; // Selected by qHash(key) modulo their number
+    bool hasNameKeys = false;
+    bool hasPathKeys = false;                   // Keys containing '/'
+};
+
+#endif // RENAMEMAPPING_H
@@ -0,0 +1,331 @@
+#include "renamesimulator.h"
+#include "filemetadata.h"
+#include "filenamecodec.h"
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QLocale>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <algorithm>
+
+namespace {
+
+// Scratch files renamed by the latency probe
+constexpr int ProbeFiles = 256;
+constexpr int ProbeFolders = 16;
+
+// copy_file_range copies at most this much per call (see RenameExecutor)
+constexpr qint64 CopyChunk = qint64(1) << 30;
+
+// Calls of one copy and unlink besides copy_file_range: open, fstat, open, futimens,
+// close, close, unlink
+constexpr int CopyFixedCalls = 7;
+
+QString formatDuration(qint64 ns)
+{
+    if (ns < 1000000000) {
+        return QObject::tr("%1 ms").arg(ns / 1e6, 0, 'f', 1);
+    }
+    return QObject::tr("%1 s").arg(ns / 1e9, 0, 'f', 1);
+}
+
+} // namespace
+
+DryRunReport RenameSimulator::simulate(const QList<RenameTask> &tasks, RenameExecutor::Backend backend,
+                                       bool probe)
+{
+    DryRunReport report;
+    if (tasks.isEmpty()) {
+        return report;
+    }
+    const RenameExecutor::Backend activeBackend = RenameExecutor(backend).backend();
+    const bool useRing = activeBackend == RenameExecutor::IoUringBackend;
+    
+    // Sources and target folders are stat'ed in one batch, so their device ids come
+    // from the same call (statx on the ring or stat()) and compare as they will on disk
+    const QStringList directories = RenameExecutor::targetDirectories(tasks);
+    QStringList paths;
+    paths.reserve(tasks.size() + directories.size());
+    for (const RenameTask &task : tasks) {
+        paths.append(task.source);
+    }
+    paths.append(directories);
+    const QList<FileMetadata> metadata = FileMetadata::readAll(paths);
+    const QList<FileMetadata> sourceMetadata = metadata.first(tasks.size());
+    const QList<FileMetadata> directoryMetadata = metadata.sliced(tasks.size());
+    
+    // The namespace: names per folder, listed from disk the first time a folder is
+    // touched; folders the run would create start out empty
+    QHash<QString, QSet<QString>> namespaceFolders;
+    auto folder = [&namespaceFolders](const QString &path) -> QSet<QString> & {
+        auto it = namespaceFolders.find(path);
+        if (it == namespaceFolders.end()) {
+            QSet<QString> names;
+            for (const FileNameCodec::DirectoryEntry &entry : FileNameCodec::list(path)) {
+                names.insert(entry.name);
+            }
+            it = namespaceFolders.insert(path, names);
+        }
+        return it.value();
+    };
+    
+    // Folder creation as in RenameExecutor: one statx per target folder, then makePath()
+    // for the missing ones, parents first
+    report.statCalls = int(directories.size());
+    QHash<QString, quint64> folderDevice; // Existing or created folder -> device
+    QSet<QString> failedFolders;
+    for (qsizetype i = 0; i < directories.size(); ++i) {
+        const QString &directory = directories[i];
+        if (folderDevice.contains(directory)) {
+            continue; // Created as the parent of an earlier folder
+        }
+        if (directoryMetadata[i].type == FileMetadata::Directory) {
+            folderDevice.insert(directory, directoryMetadata[i].device);
+            continue;
+        }
+        if (directoryMetadata[i].isValid()) {
+            failedFolders.insert(directory);
+            continue;
+        }
+        
+        // Find the deepest existing ancestor; every level below it is missing
+        QStringList missing{directory};
+        quint64 device = 0;
+        bool blocked = false;
+        while (true) {
+            const QString parent = QFileInfo(missing.last()).path();
+            if (parent == missing.last()) {
+                blocked = true;
+                break;
+            }
+            if (folderDevice.contains(parent)) {
+                device = folderDevice.value(parent);
+                break;
+            }
+            // stat() encodes the device like the batch above
+            const FileMetadata parentMetadata = FileMetadata::read(parent);
+            if (parentMetadata.type == FileMetadata::Directory) {
+                device = parentMetadata.device;
+                folderDevice.insert(parent, device);
+                break;
+            }
+            if (parentMetadata.isValid()) {
+                blocked = true; // A file where a folder should be: mkdir fails with ENOTDIR
+                break;
+            }
+            missing.append(parent);
+        }
+        if (blocked) {
+            report.mkdirCalls += 1;
+            failedFolders.insert(directory);
+            continue;
+        }
+        
+        // makePath() fails with ENOENT once per missing level except the top one, then
+        // creates every level on the way back
+        report.mkdirCalls += 2 * int(missing.size()) - 1;
+        for (auto it = missing.crbegin(); it != missing.crend(); ++it) {
+            const QFileInfo level(*it);
+            folder(level.path()).insert(level.fileName());
+            namespaceFolders.insert(*it, QSet<QString>());
+            folderDevice.insert(*it, device);
+        }
+    }
+    
+    // Renames in chain order; chains run concurrently in the real run, so when two of
+    // them compete for a name the winner may differ, but the conflict is the same
+    QSet<QString> movedInto;
+    const QList<QList<int>> chains = RenameExecutor::buildChains(tasks);
+    for (const QList<int> &chain : chains) {
+        auto fail = [&](qsizetype k, DryRunReport::Conflict::Kind kind) {
+            report.conflicts.append({kind, chain[k]});
+            report.cancelled += int(chain.size() - k - 1);
+        };
+        
+        // The first rename of a cycle finds its target still in place
+        if (tasks[chain.last()].target == tasks[chain.first()].source) {
+            report.cycles.append(chain);
+            report.renameCalls += 1;
+            fail(0, DryRunReport::Conflict::Cycle);
+            continue;
+        }
+        
+        const bool chainBlocked = std::any_of(chain.cbegin(), chain.cend(), [&](int task) {
+            return failedFolders.contains(QFileInfo(tasks[task].target).path());
+        });
+        bool onRing = useRing && !chainBlocked && chain.size() <= qsizetype(RenameExecutor::RingEntries);
+        for (qsizetype k = 0; k < chain.size(); ++k) {
+            const int task = chain[k];
+            const QFileInfo source(tasks[task].source);
+            const QFileInfo target(tasks[task].target);
+            if (failedFolders.contains(target.path())) {
+                fail(k, DryRunReport::Conflict::FolderNotCreatable);
+                break;
+            }
+            
+            report.renameCalls += 1;
+            // Load both folders before taking references; loading may rehash the table
+            folder(source.path());
+            folder(target.path());
+            QSet<QString> &sourceFolder = folder(source.path());
+            QSet<QString> &targetFolder = folder(target.path());
+            if (sourceMetadata[task].type != FileMetadata::RegularFile
+                || !sourceFolder.contains(source.fileName())) {
+                fail(k, DryRunReport::Conflict::SourceMissing);
+                break;
+            }
+            if (targetFolder.contains(target.fileName())) {
+                fail(k, movedInto.contains(tasks[task].target) ? DryRunReport::Conflict::DuplicateTarget
+                                                               : DryRunReport::Conflict::TargetExists);
+                break;
+            }
+            
+            const quint64 sourceDevice = sourceMetadata[task].device;
+            if (folderDevice.value(target.path(), sourceDevice) != sourceDevice) {
+                // EXDEV: on the ring the rest of the chain is cancelled and rerun
+                // directly from here, which tries the rename once more
+                if (onRing) {
+                    report.renameCalls += 1;
+                    onRing = false;
+                }
+                const qint64 size = qMax<qint64>(sourceMetadata[task].size, 0);
+                report.copyCalls += CopyFixedCalls + int((size + CopyChunk - 1) / CopyChunk) + 1;
+                report.copyBytes += size;
+                report.crossDevice += 1;
+            }
+            
+            sourceFolder.remove(source.fileName());
+            targetFolder.insert(target.fileName());
+            movedInto.insert(tasks[task].target);
+            report.succeeding += 1;
+        }
+    }
+    
+    if (probe) {
+        // Measure where most of the batch lands: the first target's folder or its
+        // nearest existing ancestor
+        QString directory = QFileInfo(tasks.first().target).path();
+        while (FileMetadata::read(directory).type != FileMetadata::Directory) {
+            const QString parent = QFileInfo(directory).path();
+            if (parent == directory) {
+                break;
+            }
+            directory = parent;
+        }
+        if (probeLatency(directory, activeBackend, report)) {
+            report.estimatedNs = report.statCalls * report.statNs + report.mkdirCalls * report.mkdirNs
+                               + report.renameCalls * report.renameNs;
+        }
+    }
+    return report;
+}
+
+bool RenameSimulator::probeLatency(const QString &directory, RenameExecutor::Backend backend,
+                                   DryRunReport &report)
+{
+    const QString scratch = QDir(directory).absoluteFilePath(
+        QStringLiteral("regex-rename-probe-%1").arg(QCoreApplication::applicationPid()));
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ProbeFolders; ++i) {
+        if (!QDir().mkdir(i == 0 ? scratch : scratch + QStringLiteral("/folder_%1").arg(i))) {
+            QDir(scratch).removeRecursively();
+            return false;
+        }
+    }
+    report.mkdirNs = timer.nsecsElapsed() / ProbeFolders;
+    
+    QList<RenameTask> tasks;
+    QStringList paths;
+    tasks.reserve(ProbeFiles);
+    for (int i = 0; i < ProbeFiles; ++i) {
+        const QString source = scratch + QStringLiteral("/file_%1").arg(i);
+        QFile file(source);
+        if (!file.open(QIODevice::WriteOnly)) {
+            QDir(scratch).removeRecursively();
+            return false;
+        }
+        paths.append(source);
+        tasks.append({source, scratch + QStringLiteral("/renamed_%1").arg(i)});
+    }
+    
+    // Batches like the real run, so the numbers include the backend's parallelism
+    timer.restart();
+    FileMetadata::readAll(paths);
+    report.statNs = timer.nsecsElapsed() / ProbeFiles;
+    
+    RenameExecutor executor(backend);
+    timer.restart();
+    const QList<int> results = executor.run(tasks);
+    report.renameNs = timer.nsecsElapsed() / ProbeFiles;
+    
+    QDir(scratch).removeRecursively();
+    return std::all_of(results.cbegin(), results.cend(), [](int error) { return error == 0; });
+}
+
+QString DryRunReport::summary() const
+{
+    const int total = succeeding + int(conflicts.size()) + cancelled;
+    QString text = QObject::tr("%1 of %2 renames would succeed; %3 conflict(s), %4 cycle(s), "
+                               "%5 skipped after an earlier failure in their chain.")
+                       .arg(succeeding).arg(total).arg(conflicts.size() - cycles.size())
+                       .arg(cycles.size()).arg(cancelled);
+    text += QLatin1Char('\n');
+    text += QObject::tr("%1 file system calls: %2 statx, %3 mkdir, %4 rename, %5 for copies.")
+                .arg(totalCalls()).arg(statCalls).arg(mkdirCalls).arg(renameCalls).arg(copyCalls);
+    if (crossDevice > 0) {
+        text += QLatin1Char('\n');
+        text += QObject::tr("%1 file(s) move to another file system and are copied (%2).")
+                    .arg(crossDevice).arg(QLocale().formattedDataSize(copyBytes));
+    }
+    text += QLatin1Char('\n');
+    if (estimatedNs >= 0) {
+        text += QObject::tr("Estimated time: %1 (measured %2 per rename, %3 per mkdir)")
+                    .arg(formatDuration(estimatedNs), formatDuration(renameNs), formatDuration(mkdirNs));
+        if (crossDevice > 0) {
+            text += QObject::tr(", plus the copies");
+        }
+        text += QLatin1Char('.');
+    } else {
+        text += QObject::tr("No time estimate: the latency probe could not run in the target folder.");
+    }
+    return text;
+}
+
+QString DryRunReport::details(const QList<RenameTask> &tasks) const
+{
+    QStringList lines;
+    for (const Conflict &conflict : conflicts) {
+        const RenameTask &task = tasks[conflict.task];
+        switch (conflict.kind) {
+            case Conflict::TargetExists:
+                lines.append(QObject::tr("'%1': target '%2' already exists").arg(task.source, task.target));
+                break;
+            case Conflict::DuplicateTarget:
+                lines.append(QObject::tr("'%1': another file is renamed to '%2' as well").arg(task.source, task.target));
+                break;
+            case Conflict::SourceMissing:
+                lines.append(QObject::tr("'%1': file no longer exists").arg(task.source));
+                break;
+            case Conflict::FolderNotCreatable:
+                lines.append(QObject::tr("'%1': folder '%2' cannot be created")
+                                 .arg(task.source, QFileInfo(task.target).path()));
+                break;
+            case Conflict::Cycle:
+                break; // Listed with the cycles below
+        }
+    }
+    for (const QList<int> &cycle : cycles) {
+        QStringList names;
+        for (int task : cycle) {
+            names.append(QFileInfo(tasks[task].source).fileName());
+        }
+        names.append(names.first());
+        lines.append(QObject::tr("Cycle: %1").arg(names.join(QStringLiteral(" -> "))));
+    }
+    return lines.join(QLatin1Char('\n'));
+}
@@ -0,0 +1,83 @@
+#ifndef RENAMESIMULATOR_H
+#define RENAMESIMULATOR_H
+
+#include "renameexecutor.h"
+#include <QString>
+#include <QList>
+
+/**
+ * @brief Outcome of a dry run: what RenameExecutor::run() would do with a batch.
+ */
+struct DryRunReport {
+    struct Conflict {
+        enum Kind {
+            TargetExists,       // Another file already has the target name
+            DuplicateTarget,    // Several renames have the same target; only one can win
+            SourceMissing,      // The file is gone since it was added
+            FolderNotCreatable, // A path of the target folder exists and is not a folder
+            Cycle               // Renames that form a cycle (a -> b -> a)
+        };
+        Kind kind;
+        int task;
+    };
+    
+    QList<Conflict> conflicts;
+    QList<QList<int>> cycles;   // Task indices per cycle, in chain order
+    int succeeding = 0;         // Renames that would succeed
+    int cancelled = 0;          // Renames skipped because an earlier one of their chain failed
+    int crossDevice = 0;        // Moves done as copy and unlink
+    qint64 copyBytes = 0;       // Bytes copied by cross-device moves
+    
+    // File system operations of the run (system calls on the thread pool backend,
+    // queue entries for statx and renames on the io_uring backend)
+    int statCalls = 0;
+    int mkdirCalls = 0;
+    int renameCalls = 0;
+    int copyCalls = 0;          // open, fstat, copy_file_range, futimens, close, unlink
+    qint64 totalCalls() const { return qint64(statCalls) + mkdirCalls + renameCalls + copyCalls; }
+    
+    // Probe results; negative when no probe ran
+    qint64 statNs = -1;         // Per statx in a batch
+    qint64 mkdirNs = -1;        // Per mkdir
+    qint64 renameNs = -1;       // Per rename in a batch on the chosen backend
+    qint64 estimatedNs = -1;    // Estimated run time without the copies
+    
+    /**
+     * @brief One-paragraph summary for a message box.
+     */
+    QString summary() const;
+    
+    /**
+     * @brief One line per conflict and cycle.
+     */
+    QString details(const QList<RenameTask> &tasks) const;
+};
+
+/**
+ * @brief Dry run of a rename batch against an in-memory copy of the affected folders.
+ *
+ * The folders of all sources and existing targets are listed once; the plan is then
+ * applied to that namespace in the order RenameExecutor would run it (same chains,
+ * same folder creation), so nothing on disk changes. Optionally a short probe in the
+ * target file system measures statx, mkdir and rename latency in a scratch folder to
+ * estimate the wall-clock time of the real run.
+ */
+class RenameSimulator
+{
+public:
+    /**
+     * @brief Simulate a batch.
+     * @param tasks The renames, as they would be passed to RenameExecutor::run()
+     * @param backend Backend whose behaviour (and probe timing) to model
+     * @param probe Measure latencies in the target file system for a time estimate
+     */
+    static DryRunReport simulate(const QList<RenameTask> &tasks,
+                                 RenameExecutor::Backend backend = RenameExecutor::AutomaticBackend,
+                                 bool probe = true);
+                                 
+private:
+    static bool probeLatency(const QString &directory, RenameExecutor::Backend backend,
+                             DryRunReport &report);
+};
+
+#endif // RENAMESIMULATOR_H
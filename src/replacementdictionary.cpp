@@ -0,0 +1,211 @@
+#include "replacementdictionary.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+struct CachedDictionary {
+    qint64 size = -1;
+    qint64 modified = 0;
+    std::weak_ptr<const ReplacementDictionary> dictionary;
+};
+
+QMutex cacheMutex;
+QHash<QString, CachedDictionary> cache;
+
+} // namespace
+
+ReplacementDictionary::ReplacementDictionary(const QList<Pair> &pairs)
+{
+    // Build the trie of reversed finds; children are collected in a hash first and
+    // laid out as sorted edge ranges afterwards
+    QHash<quint64, int> children;
+    QList<int> terminal{-1};
+    QHash<QString, int> findIndex;
+    for (const Pair &pair : pairs) {
+        const QString &find = pair.first;
+        if (find.isEmpty()) {
+            continue;
+        }
+        const auto existing = findIndex.constFind(find);
+        if (existing != findIndex.constEnd()) {
+            replacements[*existing] = pair.second;
+            continue;
+        }
+        
+        const int id = int(replacements.size());
+        findIndex.insert(find, id);
+        replacements.append(pair.second);
+        findLengths.append(int(find.size()));
+        
+        int node = 0;
+        for (qsizetype i = find.size() - 1; i >= 0; --i) {
+            const quint64 key = (quint64(node) << 16) | find.at(i).unicode();
+            auto it = children.constFind(key);
+            if (it == children.constEnd()) {
+                it = children.insert(key, int(terminal.size()));
+                terminal.append(-1);
+            }
+            node = *it;
+        }
+        terminal[node] = id;
+    }
+    
+    // Keys sort by parent, then character, which is the edge layout
+    nodes.resize(terminal.size());
+    edges.resize(children.size());
+    QList<quint64> keys = children.keys();
+    std::sort(keys.begin(), keys.end());
+    for (qsizetype i = 0; i < keys.size(); ++i) {
+        edges[i] = {char16_t(keys[i] & 0xFFFF), children.value(keys[i])};
+        Node &parent = nodes[int(keys[i] >> 16)];
+        if (parent.edgeCount == 0) {
+            parent.firstEdge = int(i);
+        }
+        ++parent.edgeCount;
+    }
+    
+    // Failure links in breadth-first order, so a node's failure target (which is
+    // shallower) is complete before the node itself
+    QList<int> queue;
+    queue.reserve(nodes.size());
+    queue.append(0);
+    nodes[0].match = terminal[0];
+    for (qsizetype head = 0; head < queue.size(); ++head) {
+        const int node = queue[head];
+        const Node current = nodes[node];
+        for (int e = current.firstEdge; e < current.firstEdge + current.edgeCount; ++e) {
+            const char16_t c = edges[e].c;
+            const int target = edges[e].target;
+            int fail = 0;
+            if (node != 0) {
+                int candidate = current.fail;
+                while (candidate != 0 && child(candidate, c) < 0) {
+                    candidate = nodes[candidate].fail;
+                }
+                fail = qMax(child(candidate, c), 0);
+            }
+            nodes[target].fail = fail;
+            nodes[target].match = terminal[target] >= 0 ? terminal[target] : nodes[fail].match;
+            queue.append(target);
+        }
+    }
+}
+
+int ReplacementDictionary::child(int node, char16_t c) const
+{
+    const Node &current = nodes[node];
+    const Edge *begin = edges.constData() + current.firstEdge;
+    const Edge *end = begin + current.edgeCount;
+    const Edge *edge = std::lower_bound(begin, end, c, [](const Edge &edge, char16_t value) {
+        return edge.c < value;
+    });
+    return edge != end && edge->c == c ? edge->target : -1;
+}
+
+bool ReplacementDictionary::replace(QStringView text, QString &result) const
+{
+    if (replacements.isEmpty() || text.isEmpty()) {
+        return false;
+    }
+    
+    // Backward scan: the state after reading text[i..] reversed ends in the longest
+    // find that starts at i
+    QVarLengthArray<int, 256> matchAt(text.size());
+    bool anyMatch = false;
+    int state = 0;
+    for (qsizetype i = text.size() - 1; i >= 0; --i) {
+        const char16_t c = text[i].unicode();
+        int next = child(state, c);
+        while (next < 0 && state != 0) {
+            state = nodes[state].fail;
+            next = child(state, c);
+        }
+        state = qMax(next, 0);
+        matchAt[i] = nodes[state].match;
+        anyMatch = anyMatch || matchAt[i] >= 0;
+    }
+    if (!anyMatch) {
+        return false;
+    }
+    
+    // Forward pass: leftmost-longest, non-overlapping
+    result.clear();
+    result.reserve(text.size());
+    qsizetype copyStart = 0;
+    qsizetype i = 0;
+    while (i < text.size()) {
+        const int find = matchAt[i];
+        if (find < 0) {
+            ++i;
+            continue;
+        }
+        result.append(text.mid(copyStart, i - copyStart));
+        result.append(replacements[find]);
+        i += findLengths[find];
+        copyStart = i;
+    }
+    result.append(text.mid(copyStart));
+    return true;
+}
+
+std::shared_ptr<const ReplacementDictionary> ReplacementDictionary::load(const QString &filePath,
+                                                                         QString &errorMessage)
+{
+    const QFileInfo info(filePath);
+    if (!info.isFile()) {
+        errorMessage = QObject::tr("Dictionary '%1' not found.").arg(filePath);
+        return nullptr;
+    }
+    const qint64 size = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const QString key = info.absoluteFilePath();
+    
+    {
+        QMutexLocker locker(&cacheMutex);
+        const CachedDictionary cached = cache.value(key);
+        if (cached.size == size && cached.modified == modified) {
+            if (std::shared_ptr<const ReplacementDictionary> dictionary = cached.dictionary.lock()) {
+                return dictionary;
+            }
+        }
+    }
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return nullptr;
+    }
+    const QString text = QString::fromUtf8(file.readAll());
+    
+    QList<Pair> pairs;
+    int lineNumber = 0;
+    for (QStringView line : QStringView(text).split(QLatin1Char('\n'))) {
+        ++lineNumber;
+        if (line.endsWith(QLatin1Char('\r'))) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        const qsizetype tab = line.indexOf(QLatin1Char('\t'));
+        if (tab <= 0) {
+            errorMessage = QObject::tr("Line %1 of '%2' is not a find<TAB>replacement pair.")
+                               .arg(lineNumber).arg(filePath);
+            return nullptr;
+        }
+        pairs.append({line.left(tab).toString(), line.mid(tab + 1).toString()});
+    }
+    
+    auto dictionary = std::make_shared<const ReplacementDictionary>(pairs);
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(key, {size, modified, dictionary});
+    return dictionary;
+}
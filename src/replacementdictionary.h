@@ -0,0 +1,74 @@
+#ifndef REPLACEMENTDICTIONARY_H
+#define REPLACEMENTDICTIONARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QList>
+#include <QPair>
+#include <memory>
+
+/**
+ * @brief Set of find -> replacement pairs applied in one pass with an Aho–Corasick automaton.
+ *
+ * All occurrences are replaced left to right; where several finds start at the same
+ * position the longest wins, and replaced text is not searched again. The automaton
+ * is built over the reversed finds and run over the reversed text, which yields the
+ * longest find starting at every position in one linear scan; a forward pass then
+ * picks the matches. The cost per name therefore depends on its length, not on the
+ * number of pairs.
+ *
+ * Dictionary files are UTF-8 text with one "find<TAB>replacement" pair per line;
+ * empty lines and lines starting with '#' are skipped, and a later pair with the same
+ * find overrides an earlier one.
+ */
+class ReplacementDictionary
+{
+public:
+    using Pair = QPair<QString, QString>;
+    
+    explicit ReplacementDictionary(const QList<Pair> &pairs);
+    
+    /**
+     * @brief Load a dictionary file.
+     *
+     * Dictionaries are cached by path, size and modification time, so operations
+     * rebuilt while editing share one automaton.
+     * @return The dictionary, or null with errorMessage set if the file is unusable
+     */
+    static std::shared_ptr<const ReplacementDictionary> load(const QString &filePath, QString &errorMessage);
+    
+    /**
+     * @brief Number of distinct finds.
+     */
+    int size() const { return int(replacements.size()); }
+    
+    /**
+     * @brief Replace all occurrences in a text.
+     * @param result Receives the new text; untouched if nothing matched
+     * @return True if anything was replaced
+     */
+    bool replace(QStringView text, QString &result) const;
+
+private:
+    struct Node {
+        int fail = 0;         // Longest proper suffix that is also in the trie
+        int match = -1;       // Longest find that is a suffix of this node, or -1
+        int firstEdge = 0;
+        int edgeCount = 0;
+    };
+    
+    struct Edge {
+        char16_t c;
+        int target;
+    };
+    
+    int child(int node, char16_t c) const;
+    
+    QList<Node> nodes;          // Node 0 is the root
+    QList<Edge> edges;          // Per node, sorted by character
+    QStringList replacements;   // Per find
+    QList<int> findLengths;     // Per find
+};
+
+#endif // REPLACEMENTDICTIONARY_H
@@ -0,0 +1,83 @@
+#include "scanoptionsdialog.h"
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QMessageBox>
+
+namespace {
+
+QStringList splitPatterns(const QString &text)
+{
+    QStringList patterns;
+    for (const QString &part : text.split(QLatin1Char(';'), Qt::SkipEmptyParts)) {
+        const QString pattern = part.trimmed();
+        if (!pattern.isEmpty()) {
+            patterns.append(pattern);
+        }
+    }
+    return patterns;
+}
+
+} // namespace
+
+ScanOptionsDialog::ScanOptionsDialog(const ScanOptions &options, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Folder Options"));
+    
+    QFormLayout *layout = new QFormLayout(this);
+    
+    includeEdit = new QLineEdit(options.include.join(QLatin1String("; ")), this);
+    includeEdit->setPlaceholderText(tr("All files, e.g. *.jpg; *.png"));
+    layout->addRow(tr("Include:"), includeEdit);
+    
+    excludeEdit = new QLineEdit(options.exclude.join(QLatin1String("; ")), this);
+    excludeEdit->setPlaceholderText(tr("e.g. node_modules; *.tmp; build/cache"));
+    excludeEdit->setToolTip(tr("Matching folders are skipped with everything below them"));
+    layout->addRow(tr("Exclude:"), excludeEdit);
+    
+    syntaxCombo = new QComboBox(this);
+    syntaxCombo->addItem(tr("Wildcards"), int(ScanOptions::Glob));
+    syntaxCombo->addItem(tr("Regular Expressions"), int(ScanOptions::Regex));
+    syntaxCombo->setCurrentIndex(syntaxCombo->findData(int(options.syntax)));
+    layout->addRow(tr("Patterns:"), syntaxCombo);
+    
+    // -1 is shown as "Unlimited"
+    maxDepthSpinBox = new QSpinBox(this);
+    maxDepthSpinBox->setRange(-1, 999);
+    maxDepthSpinBox->setSpecialValueText(tr("Unlimited"));
+    maxDepthSpinBox->setValue(options.maxDepth);
+    maxDepthSpinBox->setToolTip(tr("Subfolder levels to enter; 0 takes only the files "
+                                   "directly in the dropped folder"));
+    layout->addRow(tr("Folder depth:"), maxDepthSpinBox);
+    
+    hiddenCheckBox = new QCheckBox(tr("Include hidden files and folders"), this);
+    hiddenCheckBox->setChecked(options.includeHidden);
+    layout->addRow(hiddenCheckBox);
+    
+    QDialogButtonBox *buttons = new QDialogButtonBox(
+        QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttons, &QDialogButtonBox::accepted, this, &ScanOptionsDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &ScanOptionsDialog::reject);
+    layout->addRow(buttons);
+}
+
+ScanOptions ScanOptionsDialog::options() const
+{
+    ScanOptions options;
+    options.syntax = ScanOptions::PatternSyntax(syntaxCombo->currentData().toInt());
+    options.include = splitPatterns(includeEdit->text());
+    options.exclude = splitPatterns(excludeEdit->text());
+    options.maxDepth = maxDepthSpinBox->value();
+    options.includeHidden = hiddenCheckBox->isChecked();
+    return options;
+}
+
+void ScanOptionsDialog::accept()
+{
+    QString errorMessage;
+    if (!DirectoryScanner(options()).isValid(&errorMessage)) {
+        QMessageBox::warning(this, tr("Folder Options"), errorMessage);
+        return;
+    }
+    QDialog::accept();
+}
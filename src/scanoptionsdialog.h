@@ -0,0 +1,37 @@
+#ifndef SCANOPTIONSDIALOG_H
+#define SCANOPTIONSDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QCheckBox>
+#include "directoryscanner.h"
+
+/**
+ * @brief Dialog for the rules applied when folders are dropped onto the file list.
+ *
+ * Patterns are entered as one ';'-separated list per kind. The dialog only
+ * closes with OK once all patterns compile.
+ */
+class ScanOptionsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ScanOptionsDialog(const ScanOptions &options, QWidget *parent = nullptr);
+    
+    ScanOptions options() const;
+
+public slots:
+    void accept() override;
+
+private:
+    QLineEdit *includeEdit;
+    QLineEdit *excludeEdit;
+    QComboBox *syntaxCombo;
+    QSpinBox *maxDepthSpinBox;
+    QCheckBox *hiddenCheckBox;
+};
+
+#endif // SCANOPTIONSDIALOG_H
@@ -0,0 +1,385 @@
+#include "session.h"
+#include "preset.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QHash>
+#include <QObject>
+#include <QtConcurrent>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+constexpr char Magic[4] = {'R', 'R', 'S', 'S'};
+constexpr quint32 FormatVersion = 1;
+constexpr quint32 ByteOrderMark = 0x01020304;
+constexpr int ChunkSize = 16384;
+
+struct Header {
+    char magic[4];
+    quint32 version;
+    quint32 byteOrder;          // ByteOrderMark in the writer's byte order
+    qint32 numberingOrder;
+    qint32 numberingDirection;
+    quint32 reserved;
+    quint64 entryCount;
+    quint64 entriesOffset;      // EntryRecord[entryCount]
+    quint64 directoryCount;
+    quint64 directoriesOffset;  // StringRef[directoryCount]
+    quint64 rootCount;
+    quint64 rootsOffset;        // StringRef[rootCount]
+    quint64 stringsOffset;      // UTF-16 pool
+    quint64 stringsLength;      // In code units
+    quint64 presetOffset;       // Operation chain as CBOR preset
+    quint64 presetSize;
+};
+
+// Position of a string in the pool, in UTF-16 code units
+struct StringRef {
+    quint64 offset;
+    quint64 length;
+};
+
+struct EntryRecord {
+    quint32 directory;  // Index into the directory table
+    quint32 reserved;
+    StringRef name;
+    qint64 size;
+    qint64 modified;
+};
+
+static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) % 8 == 0, "Header layout");
+static_assert(std::is_trivially_copyable_v<EntryRecord> && sizeof(EntryRecord) % 8 == 0,
+              "EntryRecord layout");
+
+// Run fn(begin, end) over [0, count) in parallel chunks of ChunkSize
+template <typename Fn>
+void forEachChunk(qsizetype count, Fn fn)
+{
+    QList<qsizetype> chunkStarts;
+    for (qsizetype begin = 0; begin < count; begin += ChunkSize) {
+        chunkStarts.append(begin);
+    }
+    QtConcurrent::blockingMap(chunkStarts, [count, &fn](const qsizetype &begin) {
+        fn(begin, qMin<qsizetype>(begin + ChunkSize, count));
+    });
+}
+
+FileStamp stampOf(const FileMetadata &metadata)
+{
+    FileStamp stamp;
+    if (metadata.isValid()) {
+        stamp.size = metadata.size;
+        stamp.modified = metadata.modified;
+    }
+    return stamp;
+}
+
+StringRef addString(QString &pool, QStringView text)
+{
+    StringRef ref{quint64(pool.size()), quint64(text.size())};
+    pool.append(text);
+    return ref;
+}
+
+quint64 alignUp(quint64 offset)
+{
+    return (offset + 7) & ~quint64(7);
+}
+
+template <typename T>
+void appendRaw(QByteArray &out, const T *data, qsizetype count)
+{
+    out.append(reinterpret_cast<const char *>(data), qsizetype(sizeof(T)) * count);
+    out.append(QByteArray(qsizetype(alignUp(quint64(out.size())) - quint64(out.size())), '\0'));
+}
+
+// True if [offset, offset + count * elementSize) lies within a file of the given size
+bool inRange(quint64 offset, quint64 count, quint64 elementSize, quint64 fileSize)
+{
+    if (offset > fileSize || (elementSize != 0 && count > (fileSize - offset) / elementSize)) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool Session::save(const QString &filePath, const SessionData &data, QString &errorMessage)
+{
+    const QList<FileStamp> stamps = data.stamps.size() == data.files.size()
+        ? data.stamps : stampFiles(data.files);
+    
+    // Collect records; directories are stored once and referenced by index (the
+    // store's directory ids map to the directories written so far)
+    QString pool;
+    QList<int> directoryIndex;
+    QList<StringRef> directories;
+    QList<EntryRecord> records;
+    records.reserve(data.files.size());
+    for (qsizetype i = 0; i < data.files.size(); ++i) {
+        const int directoryId = data.files.directoryId(i);
+        if (directoryId >= directoryIndex.size()) {
+            directoryIndex.resize(directoryId + 1, -1);
+        }
+        if (directoryIndex[directoryId] < 0) {
+            directoryIndex[directoryId] = int(directories.size());
+            directories.append(addString(pool, data.files.directory(i)));
+        }
+        
+        EntryRecord record = {};
+        record.directory = quint32(directoryIndex[directoryId]);
+        record.name = addString(pool, data.files.originalNameColumn().at(i));
+        record.size = stamps[i].size;
+        record.modified = stamps[i].modified;
+        records.append(record);
+    }
+    
+    QList<StringRef> roots;
+    for (const QString &root : data.watchedRoots) {
+        roots.append(addString(pool, root));
+    }
+    
+    const QByteArray preset = Preset::toCbor(data.operations);
+    
+    // Lay out the sections after the header, each 8-byte aligned
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.byteOrder = ByteOrderMark;
+    header.numberingOrder = qint32(data.numberingOrder);
+    header.numberingDirection = qint32(data.numberingDirection);
+    header.entryCount = quint64(records.size());
+    header.entriesOffset = sizeof(Header);
+    header.directoryCount = quint64(directories.size());
+    header.directoriesOffset = alignUp(header.entriesOffset + sizeof(EntryRecord) * records.size());
+    header.rootCount = quint64(roots.size());
+    header.rootsOffset = alignUp(header.directoriesOffset + sizeof(StringRef) * directories.size());
+    header.stringsOffset = alignUp(header.rootsOffset + sizeof(StringRef) * roots.size());
+    header.stringsLength = quint64(pool.size());
+    header.presetOffset = alignUp(header.stringsOffset + sizeof(char16_t) * pool.size());
+    header.presetSize = quint64(preset.size());
+    
+    QByteArray out;
+    out.reserve(qsizetype(header.presetOffset + header.presetSize));
+    appendRaw(out, &header, 1);
+    appendRaw(out, records.constData(), records.size());
+    appendRaw(out, directories.constData(), directories.size());
+    appendRaw(out, roots.constData(), roots.size());
+    appendRaw(out, pool.utf16(), pool.size());
+    out.append(preset);
+    
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    file.write(out);
+    if (!file.commit()) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool Session::load(const QString &filePath, SessionData &data, QString &errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    
+    const quint64 fileSize = quint64(file.size());
+    if (fileSize < sizeof(Header)) {
+        errorMessage = QObject::tr("The file is not a Regex Rename session.");
+        return false;
+    }
+    
+    // Map the whole snapshot; fall back to reading it if mapping is not possible
+    QByteArray buffer;
+    const uchar *base = file.map(0, qint64(fileSize));
+    if (!base) {
+        buffer = file.readAll();
+        base = reinterpret_cast<const uchar *>(buffer.constData());
+    }
+    
+    Header header;
+    std::memcpy(&header, base, sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+        errorMessage = QObject::tr("The file is not a Regex Rename session.");
+        return false;
+    }
+    if (header.version != FormatVersion || header.byteOrder != ByteOrderMark) {
+        errorMessage = QObject::tr("The session was saved by an incompatible version or platform.");
+        return false;
+    }
+    
+    const bool layoutValid =
+        header.entriesOffset % 8 == 0 && header.directoriesOffset % 8 == 0
+        && header.rootsOffset % 8 == 0 && header.stringsOffset % 8 == 0
+        && inRange(header.entriesOffset, header.entryCount, sizeof(EntryRecord), fileSize)
+        && inRange(header.directoriesOffset, header.directoryCount, sizeof(StringRef), fileSize)
+        && inRange(header.rootsOffset, header.rootCount, sizeof(StringRef), fileSize)
+        && inRange(header.stringsOffset, header.stringsLength, sizeof(char16_t), fileSize)
+        && inRange(header.presetOffset, header.presetSize, 1, fileSize)
+        && header.entryCount < quint64(std::numeric_limits<int>::max());
+    if (!layoutValid) {
+        errorMessage = QObject::tr("The session file is damaged.");
+        return false;
+    }
+    
+    // The numbering settings are cast to their enums once the entries are loaded
+    const bool settingsValid =
+        header.numberingOrder >= qint32(NumberingOrder::Added)
+        && header.numberingOrder <= qint32(NumberingOrder::Size)
+        && (header.numberingDirection == qint32(Qt::AscendingOrder)
+            || header.numberingDirection == qint32(Qt::DescendingOrder));
+    if (!settingsValid) {
+        errorMessage = QObject::tr("The session file is damaged.");
+        return false;
+    }
+
+    const QChar *pool = reinterpret_cast<const QChar *>(base + header.stringsOffset);
+    auto stringAt = [&](const StringRef &ref, QString &text) {
+        if (ref.offset > header.stringsLength || ref.length > header.stringsLength - ref.offset) {
+            return false;
+        }
+        text = QString(pool + ref.offset, qsizetype(ref.length));
+        return true;
+    };
+    
+    QStringList directories;
+    directories.reserve(qsizetype(header.directoryCount));
+    for (quint64 i = 0; i < header.directoryCount; ++i) {
+        StringRef ref;
+        std::memcpy(&ref, base + header.directoriesOffset + i * sizeof(StringRef), sizeof(StringRef));
+        QString directory;
+        if (!stringAt(ref, directory)) {
+            errorMessage = QObject::tr("The session file is damaged.");
+            return false;
+        }
+        directories.append(directory);
+    }
+    
+    data.watchedRoots.clear();
+    for (quint64 i = 0; i < header.rootCount; ++i) {
+        StringRef ref;
+        std::memcpy(&ref, base + header.rootsOffset + i * sizeof(StringRef), sizeof(StringRef));
+        QString root;
+        if (!stringAt(ref, root)) {
+            errorMessage = QObject::tr("The session file is damaged.");
+            return false;
+        }
+        data.watchedRoots.append(root);
+    }
+    
+    // Check the records in parallel, then append the names straight from the mapped
+    // pool; directories are interned once, and the store spills full chunks as it grows
+    const qsizetype count = qsizetype(header.entryCount);
+    const uchar *recordBase = base + header.entriesOffset;
+    std::atomic<bool> damaged(false);
+    forEachChunk(count, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            EntryRecord record;
+            std::memcpy(&record, recordBase + i * sizeof(EntryRecord), sizeof(EntryRecord));
+            if (record.directory >= quint32(directories.size())
+                || record.name.offset > header.stringsLength
+                || record.name.length > header.stringsLength - record.name.offset) {
+                damaged = true;
+                return;
+            }
+        }
+    });
+    if (damaged) {
+        errorMessage = QObject::tr("The session file is damaged.");
+        return false;
+    }
+    
+    data.files.clear();
+    data.files.reserve(count);
+    data.stamps.resize(count);
+    QList<int> directoryIds;
+    directoryIds.reserve(directories.size());
+    for (const QString &directory : std::as_const(directories)) {
+        directoryIds.append(data.files.directoryIdOf(directory));
+    }
+    for (qsizetype i = 0; i < count; ++i) {
+        EntryRecord record;
+        std::memcpy(&record, recordBase + i * sizeof(EntryRecord), sizeof(EntryRecord));
+        
+        // Until the background check says otherwise, the snapshot metadata stands in
+        FileMetadata metadata;
+        if (record.size >= 0) {
+            metadata.type = FileMetadata::RegularFile;
+            metadata.size = record.size;
+            metadata.modified = record.modified;
+        }
+        data.files.append(directoryIds[record.directory],
+                          QStringView(pool + record.name.offset, qsizetype(record.name.length)), metadata);
+        data.stamps[i].size = record.size;
+        data.stamps[i].modified = record.modified;
+        if ((i + 1) % StringColumn::ChunkSize == 0) {
+            data.files.trimToBudget();
+        }
+    }
+    data.files.trimToBudget();
+    
+    const QByteArray preset = QByteArray::fromRawData(
+        reinterpret_cast<const char *>(base + header.presetOffset), qsizetype(header.presetSize));
+    if (!Preset::fromData(preset, data.operations, errorMessage)) {
+        return false;
+    }
+    
+    data.numberingOrder = NumberingOrder(header.numberingOrder);
+    data.numberingDirection = Qt::SortOrder(header.numberingDirection);
+    return true;
+}
+
+QList<FileStamp> Session::stampFiles(const EntryStore &files)
+{
+    // Entries carry the metadata taken when they were added; stat only the rest
+    QList<FileStamp> stamps(files.size());
+    QStringList missingPaths;
+    QList<qsizetype> missing;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        if (files.metadata(i).isValid()) {
+            stamps[i] = stampOf(files.metadata(i));
+        } else {
+            missingPaths.append(files.fullPath(i));
+            missing.append(i);
+        }
+    }
+    
+    const QList<FileMetadata> metadata = FileMetadata::readAll(missingPaths);
+    for (qsizetype k = 0; k < missing.size(); ++k) {
+        stamps[missing[k]] = stampOf(metadata[k]);
+    }
+    return stamps;
+}
+
+QStringList Session::findStale(const EntryStore &files, const QList<FileStamp> &stamps)
+{
+    if (stamps.size() != files.size()) {
+        return QStringList();
+    }
+    
+    // One batched stat pass over all files, then compare
+    QStringList paths;
+    paths.reserve(files.size());
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        paths.append(files.fullPath(i));
+    }
+    const QList<FileMetadata> current = FileMetadata::readAll(paths);
+    
+    QStringList stalePaths;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        const FileStamp stamp = stampOf(current[i]);
+        if (stamp.size < 0 || stamp.size != stamps[i].size || stamp.modified != stamps[i].modified) {
+            stalePaths.append(paths[i]);
+        }
+    }
+    return stalePaths;
+}
@@ -0,0 +1,69 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include "filelistwidget.h"
+#include "fileordering.h"
+#include "operationfactory.h"
+
+/**
+ * @brief Size and modification time of a file when a session was saved.
+ */
+struct FileStamp {
+    qint64 size = -1;     // -1 if the file could not be stat'ed
+    qint64 modified = 0;  // Nanoseconds since epoch
+};
+
+/**
+ * @brief Everything a session snapshot restores.
+ */
+struct SessionData {
+    EntryStore files;         // Set its memory budget before load() to bound memory while loading
+    QList<FileStamp> stamps;  // Per file; filled by load(), computed by save() if empty
+    QStringList watchedRoots;
+    QList<OperationSpec> operations;
+    NumberingOrder numberingOrder = NumberingOrder::Added;
+    Qt::SortOrder numberingDirection = Qt::AscendingOrder;
+};
+
+/**
+ * @brief Session snapshots for reopening large file lists without rescanning.
+ *
+ * A snapshot is a single binary file in native byte order: a fixed header,
+ * fixed-size entry records, a table of distinct directories and one UTF-16
+ * string pool, followed by the operation chain in preset (CBOR) form. Loading
+ * maps the file, checks the records in parallel chunks and streams the names
+ * from the mapped pool into the entry store, which spills them chunk by chunk
+ * once they exceed its memory budget. The file system is not touched while loading;
+ * use findStale() afterwards to revalidate in the background.
+ */
+class Session
+{
+public:
+    /**
+     * @brief Write a snapshot.
+     * @return True on success
+     */
+    static bool save(const QString &filePath, const SessionData &data, QString &errorMessage);
+    
+    /**
+     * @brief Read a snapshot.
+     * @return True on success
+     */
+    static bool load(const QString &filePath, SessionData &data, QString &errorMessage);
+    
+    /**
+     * @brief Stat all files in parallel.
+     */
+    static QList<FileStamp> stampFiles(const EntryStore &files);
+    
+    /**
+     * @brief Find files that are missing or changed since their stamps were taken.
+     * @return Full paths of the stale files
+     */
+    static QStringList findStale(const EntryStore &files, const QList<FileStamp> &stamps);
+};
+
+#endif // SESSION_H
@@ -0,0 +1,49 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include "engineverifier.h"
+
+int main(int argc, char *argv[])
+{
+    // The preview benchmark drives the file list's preview pass, which needs a widget application
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("regex-rename-verify");
+    QApplication::setApplicationVersion("1.0.0");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks the rename engine against its reference implementation");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption seedOption("seed", "Seed for the input generator (random by default).", "n");
+    parser.addOption(seedOption);
+    QCommandLineOption iterationsOption("iterations", "Operation chains checked.", "n", "100000");
+    parser.addOption(iterationsOption);
+    QCommandLineOption benchmarkOption("benchmark-rename",
+                                       "Measure renames per second of every rename backend in a "
+                                       "scratch folder below the directory instead.", "directory");
+    parser.addOption(benchmarkOption);
+    QCommandLineOption previewBenchmarkOption("benchmark-preview",
+                                              "Measure preview throughput of the entry store layout "
+                                              "on synthetic entries instead.");
+    parser.addOption(previewBenchmarkOption);
+    QCommandLineOption countOption("count", "Files renamed by --benchmark-rename (default 100000) or "
+                                   "previewed by --benchmark-preview (default 1000000).", "n");
+    parser.addOption(countOption);
+    parser.process(app);
+    
+    QTextStream out(stdout);
+    if (parser.isSet(benchmarkOption)) {
+        return EngineVerifier::benchmarkRename(parser.value(benchmarkOption),
+                                               parser.isSet(countOption) ? parser.value(countOption).toInt()
+                                                                         : 100000, out);
+    }
+    if (parser.isSet(previewBenchmarkOption)) {
+        return EngineVerifier::benchmarkPreview(parser.isSet(countOption) ? parser.value(countOption).toInt()
+                                                                          : 1000000, out);
+    }
+    
+    const quint32 seed = parser.isSet(seedOption) ? parser.value(seedOption).toUInt()
+                                                  : QRandomGenerator::global()->generate();
+    return EngineVerifier::run(parser.value(iterationsOption).toInt(), seed, out) == 0 ? 0 : 1;
+}